@@ -31,14 +31,21 @@ Application::Application() :
     light_field_renderer->set_visible(true);
 
     b = new nanogui::Button(window->button_panel(), "", FA_CAMERA);
-    b->set_tooltip("Save Screenshot");
+    b->set_tooltip("Save Screenshot. PFM (linear float), PNG and PPM (16-bit) are written from the linear accumulation.");
     b->set_callback([this]
     {
-        std::string path = nanogui::file_dialog({{"tga", ""}}, true);
+        std::string path = nanogui::file_dialog({ {"tga", ""}, {"pfm", ""}, {"png", ""}, {"ppm", ""} }, true);
         if (path.empty()) return;
         light_field_renderer->saveNextRender(path);
     });
 
+    b = new nanogui::Button(window->button_panel(), "", FA_TACHOMETER_ALT);
+    b->set_tooltip("Benchmark (results are printed to the console)");
+    b->set_callback([this]
+    {
+        light_field_renderer->benchmark();
+    });
+
     window = new nanogui::Window(this, "Menu");
     window->set_position({ 10, 10 });
     window->set_layout(new nanogui::GroupLayout(15, 6, 15, 0));
@@ -119,6 +126,52 @@ Application::Application() :
     });
 
 
+    panel = new nanogui::Widget(window);
+    panel->set_layout(new nanogui::GridLayout(nanogui::Orientation::Horizontal, 3, nanogui::Alignment::Fill, 0, 5));
+
+    label = new nanogui::Label(panel, "Textures", "sans-bold");
+    label->set_fixed_width(86);
+
+    nanogui::ComboBox* storage = new nanogui::ComboBox(panel, { "sRGB (Shader)", "sRGB (Hardware)", "Linear Half Float", "BC1 (S3TC)", "BC7 (BPTC)", "YCbCr 4:2:0" });
+    storage->set_fixed_size({ 180, 20 });
+    storage->set_font_size(16);
+    storage->set_tooltip("Texture storage of camera images. Applied when opening a light field. Block compressed formats are encoded on the first load and cached in the light field folder. YCbCr 4:2:0 stores half resolution chroma like JPEG files, at half the memory of sRGB.");
+    storage->set_selected_index((int)light_field_renderer->texture_storage);
+    storage->set_callback([this](int index)
+    {
+        light_field_renderer->texture_storage = (CameraArray::Storage)index;
+    });
+
+    nanogui::Button* mipmaps = new nanogui::Button(panel, "Mipmaps");
+    mipmaps->set_fixed_size({ 85, 20 });
+    mipmaps->set_font_size(14);
+    mipmaps->set_tooltip("Sample minified views from mipmaps. Disabling saves texture memory and load time. Applied when opening a light field.");
+    mipmaps->set_flags(nanogui::Button::Flags::ToggleButton);
+    mipmaps->set_pushed(light_field_renderer->texture_mipmaps);
+    mipmaps->set_change_callback([this](bool state)
+    {
+        light_field_renderer->texture_mipmaps = state;
+    });
+
+    panel = new nanogui::Widget(window);
+    panel->set_layout(new nanogui::GridLayout(nanogui::Orientation::Horizontal, 2, nanogui::Alignment::Fill, 0, 5));
+
+    label = new nanogui::Label(panel, "Video", "sans-bold");
+    label->set_fixed_width(86);
+
+    nanogui::Button* play = new nanogui::Button(panel, "Play", FA_PLAY);
+    play->set_fixed_size({ 270, 20 });
+    play->set_font_size(14);
+    play->set_tooltip("Play light field videos, folders with one light field folder per frame. Frames are dropped when decoding can't keep up.");
+    play->set_flags(nanogui::Button::Flags::ToggleButton);
+    play->set_pushed(light_field_renderer->video_playback);
+    play->set_change_callback([this](bool state)
+    {
+        light_field_renderer->video_playback = state;
+    });
+
+    sliders.emplace_back(window, &cfg->video_frame_rate, "Video Rate", "fps", 0);
+
     panel = new nanogui::Widget(window);
     panel->set_layout(new nanogui::GridLayout(nanogui::Orientation::Horizontal, 4, nanogui::Alignment::Fill));
     label = new nanogui::Label(panel, "Render Size", "sans-bold");
@@ -136,6 +189,56 @@ Application::Application() :
         }
     );
 
+    panel = new nanogui::Widget(window);
+    panel->set_layout(new nanogui::GridLayout(nanogui::Orientation::Horizontal, 4, nanogui::Alignment::Fill));
+    label = new nanogui::Label(panel, "Output Size", "sans-bold");
+    label->set_fixed_width(86);
+
+    float_box_rows.push_back(PropertyBoxRow(panel, { &cfg->output_width, &cfg->output_height }, "", "px", 0, 1.0f, "", 180));
+
+    b = new nanogui::Button(panel, "Render");
+    b->set_font_size(16);
+    b->set_fixed_size({ 90, 20 });
+    b->set_tooltip("Render the current view at the output size in tiles that are streamed to a TGA file.");
+    b->set_callback([this]
+        { 
+            std::string path = nanogui::file_dialog({ {"tga", ""} }, true);
+            if (path.empty()) return;
+            path = std::filesystem::path(path).replace_extension(".tga").string();
+            light_field_renderer->renderTiled(path, { (int)cfg->output_width, (int)cfg->output_height });
+        }
+    );
+
+    panel = new nanogui::Widget(window);
+    panel->set_layout(new nanogui::GridLayout(nanogui::Orientation::Horizontal, 3, nanogui::Alignment::Fill, 0, 5));
+
+    label = new nanogui::Label(panel, "Option", "sans-bold");
+    label->set_fixed_width(86);
+
+    nanogui::Button* adaptive = new nanogui::Button(panel, "Adaptive Resolution");
+    adaptive->set_fixed_size({ 125, 20 });
+    adaptive->set_font_size(14);
+    adaptive->set_tooltip("Lower the render resolution while the view changes to hold the target frame rate. Renders at full resolution once the view is idle.");
+    adaptive->set_flags(nanogui::Button::Flags::ToggleButton);
+    adaptive->set_pushed(light_field_renderer->adaptive_resolution);
+    adaptive->set_change_callback([this](bool state)
+    {
+        light_field_renderer->adaptive_resolution = state;
+    });
+
+    nanogui::Button* temporal = new nanogui::Button(panel, "Temporal Reuse");
+    temporal->set_fixed_size({ 125, 20 });
+    temporal->set_font_size(14);
+    temporal->set_tooltip("Reproject the previous frame through the focal plane while the view moves and only render a rotating quarter of the cameras each frame.");
+    temporal->set_flags(nanogui::Button::Flags::ToggleButton);
+    temporal->set_pushed(light_field_renderer->temporal_reprojection);
+    temporal->set_change_callback([this](bool state)
+    {
+        light_field_renderer->temporal_reprojection = state;
+    });
+
+    sliders.emplace_back(window, &cfg->target_frame_rate, "Target Rate", "fps", 0);
+
     sliders.emplace_back(window, &cfg->exposure, "Exposure", "EV", 1);
 
     new nanogui::Label(window, "Optics", "sans-bold", 20);
@@ -174,6 +277,44 @@ Application::Application() :
         light_field_renderer->focus_breathing = state;
     });
 
+    panel = new nanogui::Widget(window);
+    panel->set_layout(new nanogui::GridLayout(nanogui::Orientation::Horizontal, 2, nanogui::Alignment::Fill, 0, 5));
+
+    label = new nanogui::Label(panel, "Option", "sans-bold");
+    label->set_fixed_width(86);
+
+    nanogui::Button* stereo = new nanogui::Button(panel, "Stereo Preview");
+    stereo->set_fixed_size({ 255, 20 });
+    stereo->set_font_size(14);
+    stereo->set_tooltip("Render a side by side stereo pair in a single multi-view pass, converged at the focus distance.");
+    stereo->set_flags(nanogui::Button::Flags::ToggleButton);
+    stereo->set_pushed(light_field_renderer->stereo_preview);
+    stereo->set_change_callback([this](bool state)
+    {
+        light_field_renderer->stereo_preview = state;
+    });
+
+    sliders.emplace_back(window, &cfg->stereo_base, "Stereo Base", "m", 3);
+
+    panel = new nanogui::Widget(window);
+    panel->set_layout(new nanogui::GridLayout(nanogui::Orientation::Horizontal, 2, nanogui::Alignment::Fill, 0, 5));
+
+    label = new nanogui::Label(panel, "Option", "sans-bold");
+    label->set_fixed_width(86);
+
+    nanogui::Button* focal_stack = new nanogui::Button(panel, "Focal Stack");
+    focal_stack->set_fixed_size({ 255, 20 });
+    focal_stack->set_font_size(14);
+    focal_stack->set_tooltip("Render a focal stack of the current view in the background, refocusing then interpolates between its slices.");
+    focal_stack->set_flags(nanogui::Button::Flags::ToggleButton);
+    focal_stack->set_pushed(light_field_renderer->focal_stack_preview);
+    focal_stack->set_change_callback([this](bool state)
+    {
+        light_field_renderer->focal_stack_preview = state;
+    });
+
+    sliders.emplace_back(window, &cfg->focal_stack_slices, "Stack Slices", "", 0);
+
     new nanogui::Label(window, "Navigation", "sans-bold", 20);
 
     panel = new nanogui::Widget(window);
@@ -306,12 +447,33 @@ Application::Application() :
         window, { &cfg->search_scale }, "Search Scale", "", 1, 0.1f, 
         "Scale of search region relative to the focus region")
     );
+    float_box_rows.push_back(PropertyBoxRow(
+        window, { &cfg->autofocus_rate }, "Rate", "Hz", 0, 1.0f, 
+        "Measurements per second of continuous autofocus")
+    );
 
     label = new nanogui::Label(window, "Light Slab", "sans-bold", 20);
     label->set_tooltip("Scale of rectified light fields. Has no effect on unrectified light fields.");
     sliders.emplace_back(window, &cfg->st_width, "ST Width", "m", 1);
     sliders.emplace_back(window, &cfg->st_distance, "ST Distance", "m", 1);
 
+    panel = new nanogui::Widget(window);
+    panel->set_layout(new nanogui::GridLayout(nanogui::Orientation::Horizontal, 2, nanogui::Alignment::Fill, 0, 5));
+
+    label = new nanogui::Label(panel, "Option", "sans-bold");
+    label->set_fixed_width(86);
+
+    nanogui::Button* pinhole = new nanogui::Button(panel, "Pinhole Fast Path");
+    pinhole->set_fixed_size({ 270, 20 });
+    pinhole->set_font_size(14);
+    pinhole->set_tooltip("Interpolate the four nearest cameras in a single pass when the aperture is smaller than the camera spacing of a regular grid.");
+    pinhole->set_flags(nanogui::Button::Flags::ToggleButton);
+    pinhole->set_pushed(light_field_renderer->pinhole_fast_path);
+    pinhole->set_change_callback([this](bool state)
+    {
+        light_field_renderer->pinhole_fast_path = state;
+    });
+
     perform_layout();
 }
 
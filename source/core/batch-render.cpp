@@ -0,0 +1,97 @@
+#include "light-field-renderer.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+
+#include <nanogui/opengl.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "config.hpp"
+#include "camera-array.hpp"
+#include "../gl-util/layered-fbo.hpp"
+#include "util.hpp"
+
+LightFieldRenderer::ViewBlock LightFieldRenderer::viewBlock(const View &view, const glm::ivec2 &size) const
+{
+    glm::vec3 view_forward = glm::normalize(view.target - view.eye);
+    auto V = glm::lookAt(view.eye, view.eye + view_forward, Y_AXIS);
+
+    float view_image_distance = focus_breathing ? imageDistance(cfg->focal_length, view.focus_distance) : cfg->focal_length;
+
+    ViewBlock block{};
+    if (view.frame_size.x > 0 && view.frame_size.y > 0)
+    {
+        auto P = perspectiveProjection(view_image_distance, cfg->sensor_width, view.frame_size);
+        block.VP = tileProjection(P, view.frame_size, view.offset, size) * V;
+    }
+    else
+    {
+        block.VP = perspectiveProjection(view_image_distance, cfg->sensor_width, size) * V;
+    }
+    block.eye = view.eye;
+    block.focus_distance = view.focus_distance;
+    block.forward = view_forward;
+    block.aperture_diameter = cfg->focal_length / view.f_stop;
+
+    // Same as the interactive view while a progressive open is still coarse
+    if (camera_array) block.aperture_diameter = std::max(block.aperture_diameter, camera_array->minimumAperture());
+    block.right = glm::vec3(V[0][0], V[1][0], V[2][0]);
+    block.up = glm::vec3(V[0][1], V[1][1], V[2][1]);
+    return block;
+}
+
+std::vector<std::vector<glm::vec3>> LightFieldRenderer::renderBatch(const std::vector<View> &views, const glm::ivec2 &size)
+{
+    if (!loaded()) throw std::runtime_error("No light field loaded");
+
+    camera_array->finishLoading();
+
+    const float exposure = std::pow(2.0f, (float)cfg->exposure);
+
+    std::vector<std::vector<glm::vec3>> images;
+    images.reserve(views.size());
+
+    std::vector<glm::vec4> pixels;
+
+    for (size_t first = 0; first < views.size(); first += MAX_VIEWS)
+    {
+        const int count = (int)std::min(views.size() - first, (size_t)MAX_VIEWS);
+
+        if (!batch_fbo || batch_fbo->size != size || batch_fbo->layers < count)
+        {
+            batch_fbo = std::make_unique<LayeredFBO>(size, batch_fbo && batch_fbo->size == size ? MAX_VIEWS : count);
+        }
+
+        std::vector<ViewBlock> blocks(count);
+        for (int v = 0; v < count; v++)
+        {
+            blocks[v] = viewBlock(views[first + v], size);
+        }
+
+        accumulateViews(blocks, *batch_fbo, size);
+
+        for (int v = 0; v < count; v++)
+        {
+            batch_fbo->read(v, pixels);
+
+            float max_weight_sum = 0.0f;
+            if (!normalize_aperture)
+            {
+                for (const auto &p : pixels) max_weight_sum = std::max(max_weight_sum, p.a);
+            }
+
+            auto &image = images.emplace_back(pixels.size());
+            for (size_t i = 0; i < pixels.size(); i++)
+            {
+                const auto &c = pixels[i];
+                float weight_sum = std::max(max_weight_sum, c.a);
+                image[i] = weight_sum > 0.0f ? exposure * glm::vec3(c) / weight_sum : glm::vec3(0.0f);
+            }
+        }
+
+        batch_fbo->unBind();
+    }
+
+    return images;
+}
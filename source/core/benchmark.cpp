@@ -0,0 +1,381 @@
+#include "light-field-renderer.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <limits>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+
+#include <nanogui/opengl.h>
+
+#include "config.hpp"
+#include "camera-array.hpp"
+#include "../gl-util/fbo.hpp"
+#include "../gl-util/timer-query.hpp"
+#include "fourier-refocus.hpp"
+#include "light-field-store.hpp"
+#include "util.hpp"
+
+// Normalized and gamma compressed image from the accumulation buffer, which must be bound
+std::vector<glm::vec3> normalizedImage(FBO &fbo)
+{
+    fbo.read();
+
+    std::vector<glm::vec3> image(fbo.data.size(), glm::vec3(-1.0f));
+    for (size_t i = 0; i < fbo.data.size(); i++)
+    {
+        const auto &c = fbo.data[i];
+        if (c.a <= 0.0f) continue;
+        for (int j = 0; j < 3; j++)
+        {
+            image[i][j] = glm::clamp(srgbGammaCompress(c[j] / c.a), 0.0f, 1.0f);
+        }
+    }
+    return image;
+}
+
+// Peak signal-to-noise ratio over pixels covered in both images
+double psnr(const std::vector<glm::vec3> &a, const std::vector<glm::vec3> &b)
+{
+    double sum = 0.0;
+    size_t n = 0;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (a[i].x < 0.0f || b[i].x < 0.0f) continue;
+        glm::vec3 d = a[i] - b[i];
+        sum += glm::dot(d, d);
+        n += 3;
+    }
+    if (n == 0 || sum == 0.0) return std::numeric_limits<double>::infinity();
+    return 10.0 * std::log10(n / sum);
+}
+
+void LightFieldRenderer::benchmark()
+{
+    if (!camera_array) return;
+
+    constexpr int NUM_FRAMES = 20;
+
+    const std::vector<std::pair<CameraArray::Storage, std::string>> storages = {
+        { CameraArray::Storage::SRGB_SHADER, "sRGB shader" },
+        { CameraArray::Storage::SRGB_HARDWARE, "sRGB hardware" },
+        { CameraArray::Storage::LINEAR_HALF, "Linear half" },
+        { CameraArray::Storage::BC1, "BC1" },
+        { CameraArray::Storage::BC7, "BC7" },
+        { CameraArray::Storage::YCBCR_420, "YCbCr 4:2:0" }
+    };
+
+    const CameraArray::Storage user_storage = texture_storage;
+
+    move();
+    uploadView();
+
+    // Always at full resolution
+    render_size = fb_size;
+
+    // Quality is measured against the first storage
+    std::vector<glm::vec3> reference;
+
+    std::stringstream table;
+    table << std::fixed << std::setprecision(2);
+    table << std::left << std::setw(16) << "Storage" << std::right 
+          << std::setw(12) << "Load [s]" << std::setw(12) << "VRAM [MB]" 
+          << std::setw(12) << "Frame [ms]" << std::setw(12) << "PSNR [dB]" << "\n";
+
+    for (const auto &[storage, name] : storages)
+    {
+        if (!CameraArray::supported(storage)) continue;
+
+        texture_storage = storage;
+
+        double start = glfwGetTime();
+        open();
+        if (camera_array) camera_array->finishLoading();
+        glFinish();
+        double load_time = glfwGetTime() - start;
+
+        if (!camera_array) break;
+
+        // Warm up
+        accumulate();
+        fbo0->unBind();
+
+        TimerQuery timer;
+        timer.begin();
+        for (int i = 0; i < NUM_FRAMES; i++)
+        {
+            accumulate();
+            fbo0->unBind();
+        }
+        timer.end();
+        double frame_time = timer.elapsed() / NUM_FRAMES;
+
+        accumulate();
+        auto image = normalizedImage(*fbo0);
+        fbo0->unBind();
+
+        if (reference.empty()) reference = image;
+
+        table << std::left << std::setw(16) << name << std::right
+              << std::setw(12) << load_time << std::setw(12) << camera_array->texture_bytes / 1e6
+              << std::setw(12) << frame_time << std::setw(12) << psnr(reference, image) << "\n";
+    }
+
+    std::cout << "\nTexture storage, " << camera_array->cameras.size() << " cameras, " 
+              << fb_size.x << "x" << fb_size.y << " px, " << NUM_FRAMES << " frames\n"
+              << "BC1 and BC7 loads include encoding unless the images are already in the texture cache\n";
+    std::cout << table.str() << std::endl;
+
+    texture_storage = user_storage;
+    open();
+    if (camera_array) camera_array->finishLoading();
+
+    if (camera_array && camera_array->light_slab && camera_array->grid.regular) benchmarkFocalSweep();
+    if (camera_array && camera_array->grid.regular) benchmarkHostStore();
+}
+
+void LightFieldRenderer::benchmarkFocalSweep()
+{
+    constexpr int SWEEP_IMAGES = 100;
+
+    const float user_focus = cfg->focus_distance;
+    const float min_distance = cfg->focus_distance.getMin();
+    const float max_distance = cfg->focus_distance.getMax();
+
+    std::vector<float> distances(SWEEP_IMAGES);
+    for (int i = 0; i < SWEEP_IMAGES; i++)
+    {
+        distances[i] = min_distance + (max_distance - min_distance) * i / (SWEEP_IMAGES - 1);
+    }
+
+    std::stringstream table;
+    table << std::fixed << std::setprecision(2);
+    table << std::left << std::setw(16) << "Method" << std::right
+          << std::setw(12) << "Size [px]" << std::setw(12) << "Setup [s]" 
+          << std::setw(12) << "Sweep [s]" << std::setw(12) << "Image [ms]" << "\n";
+
+    auto row = [&](const std::string &name, const glm::ivec2 &size, double setup, double sweep)
+    {
+        std::string size_text = std::to_string(size.x) + "x" + std::to_string(size.y);
+        table << std::left << std::setw(16) << name << std::right
+              << std::setw(12) << size_text << std::setw(12) << setup
+              << std::setw(12) << sweep << std::setw(12) << sweep * 1000.0 / SWEEP_IMAGES << "\n";
+    };
+
+    // Shift and add of all cameras on the GPU, one accumulation pass per image
+    render_size = fb_size;
+    glFinish();
+    double start = glfwGetTime();
+    for (float distance : distances)
+    {
+        cfg->focus_distance = distance;
+        move();
+        uploadView();
+        accumulate();
+        fbo0->unBind();
+    }
+    glFinish();
+    row("Shift and add", fb_size, 0.0, glfwGetTime() - start);
+
+    cfg->focus_distance = user_focus;
+    move();
+    uploadView();
+
+    // Fourier slice photography on the CPU, a 4D FFT once and a 2D slice per image
+    try
+    {
+        start = glfwGetTime();
+        FourierRefocus fourier(*camera_array, cfg->st_width, cfg->st_distance);
+        double setup = glfwGetTime() - start;
+
+        start = glfwGetTime();
+        for (float distance : distances) fourier.refocus(distance);
+        row("Fourier slice", fourier.size, setup, glfwGetTime() - start);
+
+        std::cout << "\nFocal sweep, " << SWEEP_IMAGES << " images, " << camera_array->cameras.size() << " cameras, "
+                  << fourier.spectrumBytes() / 1e6 << " MB spectrum\n";
+        std::cout << table.str() << std::endl;
+    }
+    catch (const std::exception &ex)
+    {
+        std::cout << ex.what() << std::endl;
+    }
+}
+
+void LightFieldRenderer::benchmarkHostStore()
+{
+    using clock = std::chrono::steady_clock;
+
+    // Refocus gathers a tile of output pixels from every camera, disparity search gathers one pixel
+    // from the cameras around a center camera at several disparities
+    constexpr int REFOCUS_WINDOW = 256;
+    constexpr int REFOCUS_TILE = 8;
+    constexpr float REFOCUS_DISPARITY = 2.0f;
+    constexpr int SEARCH_BUNDLES = 20000;
+    constexpr int SEARCH_RADIUS = 2;
+    constexpr int SEARCH_DISPARITIES = 16;
+
+    try
+    {
+        double start = glfwGetTime();
+        LightFieldStore store(*camera_array);
+        double load_time = glfwGetTime() - start;
+
+        const glm::ivec2 size = store.size;
+        const glm::ivec2 grid_size = store.grid_size;
+        const int cells = grid_size.x * grid_size.y;
+
+        // The layout it is compared with, one row-major allocation per camera
+        std::vector<std::vector<glm::u8vec4>> images(cells);
+        for (int cell = 0; cell < cells; cell++)
+        {
+            images[cell].resize((size_t)size.x * size.y);
+            for (int y = 0; y < size.y; y++)
+            {
+                for (int x = 0; x < size.x; x++) images[cell][(size_t)y * size.x + x] = store.texel(cell, x, y);
+            }
+        }
+
+        // Bundles as lists of (cell, st) samples, generated up front so that only the sampling is timed
+        using Bundle = std::vector<std::pair<int, glm::vec2>>;
+
+        std::vector<Bundle> refocus;
+        const glm::ivec2 window = glm::min(size, glm::ivec2(REFOCUS_WINDOW));
+        const glm::ivec2 window_min = (size - window) / 2;
+        const glm::vec2 center = glm::vec2(grid_size - 1) * 0.5f;
+        for (int ty = 0; ty < window.y; ty += REFOCUS_TILE)
+        {
+            for (int tx = 0; tx < window.x; tx += REFOCUS_TILE)
+            {
+                auto &bundle = refocus.emplace_back();
+                for (int cell = 0; cell < cells; cell++)
+                {
+                    glm::vec2 shift = (glm::vec2(cell % grid_size.x, cell / grid_size.x) - center) * REFOCUS_DISPARITY;
+                    for (int y = ty; y < std::min(ty + REFOCUS_TILE, window.y); y++)
+                    {
+                        for (int x = tx; x < std::min(tx + REFOCUS_TILE, window.x); x++)
+                        {
+                            glm::vec2 p = glm::vec2(window_min + glm::ivec2(x, y)) + 0.5f + shift;
+                            bundle.emplace_back(cell, p / glm::vec2(size));
+                        }
+                    }
+                }
+            }
+        }
+
+        std::vector<Bundle> search(SEARCH_BUNDLES);
+        std::mt19937 random(1);
+        for (auto &bundle : search)
+        {
+            glm::ivec2 c(random() % grid_size.x, random() % grid_size.y);
+            glm::vec2 p(random() % size.x + 0.5f, random() % size.y + 0.5f);
+            for (int j = std::max(0, c.y - SEARCH_RADIUS); j <= std::min(grid_size.y - 1, c.y + SEARCH_RADIUS); j++)
+            {
+                for (int i = std::max(0, c.x - SEARCH_RADIUS); i <= std::min(grid_size.x - 1, c.x + SEARCH_RADIUS); i++)
+                {
+                    for (int d = 0; d < SEARCH_DISPARITIES; d++)
+                    {
+                        bundle.emplace_back(i + j * grid_size.x, (p + glm::vec2(i - c.x, j - c.y) * (float)d) / glm::vec2(size));
+                    }
+                }
+            }
+        }
+
+        auto fetchImage = [&](int cell)
+        {
+            const glm::u8vec4* data = images[cell].data();
+            return [data, &size](int x, int y) -> const glm::u8vec4& { return data[(size_t)y * size.x + x]; };
+        };
+
+        auto fetchStore = [&](int cell)
+        {
+            return [&store, cell](int x, int y) -> const glm::u8vec4& { return store.texel(cell, x, y); };
+        };
+
+        // Samples per second, single threaded so that the memory access pattern isn't shared
+        auto throughput = [&](const std::vector<Bundle> &bundles, const auto &fetch)
+        {
+            glm::vec4 sum(0.0f);
+            size_t samples = 0;
+            auto begin = clock::now();
+            for (const auto &bundle : bundles)
+            {
+                for (const auto &[cell, st] : bundle) sum += LightFieldStore::bilinear(fetch(cell), size, st);
+                samples += bundle.size();
+            }
+            double seconds = std::chrono::duration<double>(clock::now() - begin).count();
+
+            // Keeps the sum alive
+            if (sum.x < 0.0f) std::cout << sum.x;
+            return samples / seconds;
+        };
+
+        // Distinct 64 byte cache lines and 4 kB pages touched per bundle, a layout property that
+        // bounds the misses of a bundle from cold caches
+        auto footprint = [&](const std::vector<Bundle> &bundles, const auto &fetch)
+        {
+            std::vector<uintptr_t> lines, pages;
+            double line_sum = 0.0, page_sum = 0.0;
+            for (const auto &bundle : bundles)
+            {
+                lines.clear();
+                for (const auto &[cell, st] : bundle)
+                {
+                    auto f = fetch(cell);
+                    LightFieldStore::bilinear([&](int x, int y)
+                    {
+                        lines.push_back(reinterpret_cast<uintptr_t>(&f(x, y)) >> 6);
+                        return f(x, y);
+                    }, size, st);
+                }
+                std::sort(lines.begin(), lines.end());
+                lines.erase(std::unique(lines.begin(), lines.end()), lines.end());
+
+                pages.clear();
+                for (auto line : lines) pages.push_back(line >> 6);
+                pages.erase(std::unique(pages.begin(), pages.end()), pages.end());
+
+                line_sum += lines.size();
+                page_sum += pages.size();
+            }
+            return std::make_pair(line_sum / bundles.size(), page_sum / bundles.size());
+        };
+
+        std::stringstream table;
+        table << std::fixed << std::setprecision(2);
+        table << std::left << std::setw(20) << "Bundles" << std::setw(12) << "Layout" << std::right
+              << std::setw(14) << "Samples [M/s]" << std::setw(12) << "Lines" << std::setw(12) << "Pages" << "\n";
+
+        auto row = [&](const std::string &bundle_name, const std::vector<Bundle> &bundles)
+        {
+            auto image_footprint = footprint(bundles, fetchImage);
+            auto store_footprint = footprint(bundles, fetchStore);
+
+            // Warm up
+            throughput(bundles, fetchImage);
+            throughput(bundles, fetchStore);
+
+            table << std::left << std::setw(20) << bundle_name << std::setw(12) << "Per image" << std::right
+                  << std::setw(14) << throughput(bundles, fetchImage) / 1e6 
+                  << std::setw(12) << image_footprint.first << std::setw(12) << image_footprint.second << "\n";
+            table << std::left << std::setw(20) << "" << std::setw(12) << "Z-order" << std::right
+                  << std::setw(14) << throughput(bundles, fetchStore) / 1e6
+                  << std::setw(12) << store_footprint.first << std::setw(12) << store_footprint.second << "\n";
+        };
+
+        row("Refocus " + std::to_string(REFOCUS_TILE) + "x" + std::to_string(REFOCUS_TILE), refocus);
+        row("Disparity search", search);
+
+        std::cout << "\nHost light field store, " << cells << " cameras of " << size.x << "x" << size.y << " px, "
+                  << store.bytes() / 1e6 << " MB arena, loaded in " << load_time << " s\n"
+                  << "Lines and pages are distinct cache lines and 4 kB pages per bundle\n";
+        std::cout << table.str() << std::endl;
+    }
+    catch (const std::exception &ex)
+    {
+        std::cout << ex.what() << std::endl;
+    }
+}
@@ -0,0 +1,439 @@
+#include "block-compression.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+#include "util.hpp"
+
+namespace
+{
+    struct Block
+    {
+        // Channels of the 16 pixels in raster order, alpha is only used by BC7
+        float c[4][16];
+    };
+
+    // Mean and principal axis of the block colors over the first channels
+    template<int CHANNELS>
+    void principalAxis(const Block &block, float mean[CHANNELS], float axis[CHANNELS])
+    {
+        for (int k = 0; k < CHANNELS; k++)
+        {
+            float sum = 0.0f;
+            for (int i = 0; i < 16; i++) sum += block.c[k][i];
+            mean[k] = sum / 16.0f;
+        }
+
+        float covariance[CHANNELS][CHANNELS];
+        for (int a = 0; a < CHANNELS; a++)
+        {
+            for (int b = a; b < CHANNELS; b++)
+            {
+                float sum = 0.0f;
+                for (int i = 0; i < 16; i++) sum += (block.c[a][i] - mean[a]) * (block.c[b][i] - mean[b]);
+                covariance[a][b] = covariance[b][a] = sum;
+            }
+        }
+
+        // Power iteration from the channel with the largest variance
+        int largest = 0;
+        for (int k = 1; k < CHANNELS; k++) if (covariance[k][k] > covariance[largest][largest]) largest = k;
+        for (int k = 0; k < CHANNELS; k++) axis[k] = covariance[largest][k];
+
+        for (int iteration = 0; iteration < 8; iteration++)
+        {
+            float next[CHANNELS], length = 0.0f;
+            for (int a = 0; a < CHANNELS; a++)
+            {
+                next[a] = 0.0f;
+                for (int b = 0; b < CHANNELS; b++) next[a] += covariance[a][b] * axis[b];
+                length = std::max(length, std::abs(next[a]));
+            }
+            if (length < 1e-12f) break;
+            for (int k = 0; k < CHANNELS; k++) axis[k] = next[k] / length;
+        }
+    }
+
+    // Endpoints at the extreme projections of the block onto its principal axis
+    template<int CHANNELS>
+    void initialEndpoints(const Block &block, float e0[CHANNELS], float e1[CHANNELS])
+    {
+        float mean[CHANNELS], axis[CHANNELS];
+        principalAxis<CHANNELS>(block, mean, axis);
+
+        float min = 0.0f, max = 0.0f;
+        for (int i = 0; i < 16; i++)
+        {
+            float t = 0.0f;
+            for (int k = 0; k < CHANNELS; k++) t += (block.c[k][i] - mean[k]) * axis[k];
+            min = std::min(min, t);
+            max = std::max(max, t);
+        }
+
+        float length = 0.0f;
+        for (int k = 0; k < CHANNELS; k++) length += axis[k] * axis[k];
+        length = std::max(length, 1e-12f);
+
+        for (int k = 0; k < CHANNELS; k++)
+        {
+            e0[k] = glm::clamp(mean[k] + axis[k] * min / length, 0.0f, 255.0f);
+            e1[k] = glm::clamp(mean[k] + axis[k] * max / length, 0.0f, 255.0f);
+        }
+    }
+
+    // Picks the closest palette entry for every pixel, returns the total squared error
+    template<int CHANNELS, int ENTRIES>
+    float assignIndices(const Block &block, const float palette[ENTRIES][CHANNELS], uint8_t indices[16])
+    {
+        float best[16];
+        std::fill(best, best + 16, std::numeric_limits<float>::max());
+
+        for (int e = 0; e < ENTRIES; e++)
+        {
+            float distance[16] = {};
+            for (int k = 0; k < CHANNELS; k++)
+            {
+                for (int i = 0; i < 16; i++)
+                {
+                    float d = block.c[k][i] - palette[e][k];
+                    distance[i] += d * d;
+                }
+            }
+            for (int i = 0; i < 16; i++)
+            {
+                if (distance[i] < best[i])
+                {
+                    best[i] = distance[i];
+                    indices[i] = (uint8_t)e;
+                }
+            }
+        }
+
+        float error = 0.0f;
+        for (int i = 0; i < 16; i++) error += best[i];
+        return error;
+    }
+
+    // Endpoints that minimize the squared error when pixel i is e0 * (1 - w[i]) + e1 * w[i]
+    template<int CHANNELS>
+    bool leastSquares(const Block &block, const float w[16], float e0[CHANNELS], float e1[CHANNELS])
+    {
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        float ax[CHANNELS] = {}, bx[CHANNELS] = {};
+        for (int i = 0; i < 16; i++)
+        {
+            float a = 1.0f - w[i], b = w[i];
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            for (int k = 0; k < CHANNELS; k++)
+            {
+                ax[k] += a * block.c[k][i];
+                bx[k] += b * block.c[k][i];
+            }
+        }
+
+        float determinant = aa * bb - ab * ab;
+        if (std::abs(determinant) < 1e-6f) return false;
+
+        for (int k = 0; k < CHANNELS; k++)
+        {
+            e0[k] = glm::clamp((ax[k] * bb - bx[k] * ab) / determinant, 0.0f, 255.0f);
+            e1[k] = glm::clamp((bx[k] * aa - ax[k] * ab) / determinant, 0.0f, 255.0f);
+        }
+        return true;
+    }
+
+    uint16_t pack565(const float c[3])
+    {
+        int r = (int)std::round(c[0] * 31.0f / 255.0f);
+        int g = (int)std::round(c[1] * 63.0f / 255.0f);
+        int b = (int)std::round(c[2] * 31.0f / 255.0f);
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    void unpack565(uint16_t v, float c[3])
+    {
+        int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+        c[0] = (float)((r << 3) | (r >> 2));
+        c[1] = (float)((g << 2) | (g >> 4));
+        c[2] = (float)((b << 3) | (b >> 2));
+    }
+
+    void encodeBC1(const Block &block, uint8_t* out)
+    {
+        // Palette weights of the endpoint e1 for indices 0 to 3 in four color mode
+        constexpr float WEIGHTS[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+        float e0[3], e1[3];
+        initialEndpoints<3>(block, e0, e1);
+
+        uint16_t best_c0 = 0, best_c1 = 0;
+        uint8_t best_indices[16] = {};
+        float best_error = std::numeric_limits<float>::max();
+
+        for (int iteration = 0; iteration < 2; iteration++)
+        {
+            uint16_t c0 = pack565(e0), c1 = pack565(e1);
+
+            // Four color mode needs c0 > c1, swapping the endpoints mirrors the palette
+            if (c0 < c1) std::swap(c0, c1);
+
+            float q0[3], q1[3], palette[4][3];
+            unpack565(c0, q0);
+            unpack565(c1, q1);
+            for (int e = 0; e < 4; e++)
+            {
+                for (int k = 0; k < 3; k++) palette[e][k] = q0[k] + (q1[k] - q0[k]) * WEIGHTS[e];
+            }
+
+            uint8_t indices[16];
+            float error = assignIndices<3, 4>(block, palette, indices);
+            if (error < best_error)
+            {
+                best_error = error;
+                best_c0 = c0;
+                best_c1 = c1;
+                std::copy(indices, indices + 16, best_indices);
+            }
+
+            if (c0 == c1) break;
+
+            float w[16];
+            for (int i = 0; i < 16; i++) w[i] = WEIGHTS[indices[i]];
+            if (!leastSquares<3>(block, w, e0, e1)) break;
+        }
+
+        // Equal endpoints select three color mode, where index 0 is still the endpoint
+        if (best_c0 == best_c1) std::fill(best_indices, best_indices + 16, 0);
+
+        uint32_t bits = 0;
+        for (int i = 0; i < 16; i++) bits |= (uint32_t)best_indices[i] << (2 * i);
+
+        out[0] = (uint8_t)best_c0;
+        out[1] = (uint8_t)(best_c0 >> 8);
+        out[2] = (uint8_t)best_c1;
+        out[3] = (uint8_t)(best_c1 >> 8);
+        for (int b = 0; b < 4; b++) out[4 + b] = (uint8_t)(bits >> (8 * b));
+    }
+
+    // 7-bit endpoint and p-bit closest to an RGBA color, the 8-bit value is (q << 1) | p
+    void quantizeBC7(const float e[4], uint8_t q[4], int &p)
+    {
+        float best = std::numeric_limits<float>::max();
+        for (int pbit = 0; pbit < 2; pbit++)
+        {
+            uint8_t candidate[4];
+            float error = 0.0f;
+            for (int k = 0; k < 4; k++)
+            {
+                candidate[k] = (uint8_t)glm::clamp((int)std::round((e[k] - pbit) / 2.0f), 0, 127);
+                float d = (float)((candidate[k] << 1) | pbit) - e[k];
+                error += d * d;
+            }
+            if (error < best)
+            {
+                best = error;
+                p = pbit;
+                std::copy(candidate, candidate + 4, q);
+            }
+        }
+    }
+
+    class BitPacker
+    {
+    public:
+        void put(uint32_t value, int count)
+        {
+            for (int b = 0; b < count; b++, position++)
+            {
+                if ((value >> b) & 1) bits[position / 64] |= 1ull << (position % 64);
+            }
+        }
+
+        void write(uint8_t* out) const
+        {
+            for (int b = 0; b < 16; b++) out[b] = (uint8_t)(bits[b / 8] >> (8 * (b % 8)));
+        }
+
+    private:
+        uint64_t bits[2] = { 0, 0 };
+        int position = 0;
+    };
+
+    void encodeBC7(const Block &block, uint8_t* out)
+    {
+        constexpr int WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+        float e0[4], e1[4];
+        initialEndpoints<4>(block, e0, e1);
+
+        uint8_t best_q[2][4] = {}, best_indices[16] = {};
+        int best_p[2] = { 0, 0 };
+        float best_error = std::numeric_limits<float>::max();
+
+        for (int iteration = 0; iteration < 2; iteration++)
+        {
+            uint8_t q[2][4];
+            int p[2];
+            quantizeBC7(e0, q[0], p[0]);
+            quantizeBC7(e1, q[1], p[1]);
+
+            float palette[16][4];
+            for (int e = 0; e < 16; e++)
+            {
+                for (int k = 0; k < 4; k++)
+                {
+                    int a = (q[0][k] << 1) | p[0], b = (q[1][k] << 1) | p[1];
+                    palette[e][k] = (float)(((64 - WEIGHTS[e]) * a + WEIGHTS[e] * b + 32) >> 6);
+                }
+            }
+
+            uint8_t indices[16];
+            float error = assignIndices<4, 16>(block, palette, indices);
+            if (error < best_error)
+            {
+                best_error = error;
+                std::copy(&q[0][0], &q[0][0] + 8, &best_q[0][0]);
+                best_p[0] = p[0];
+                best_p[1] = p[1];
+                std::copy(indices, indices + 16, best_indices);
+            }
+
+            float w[16];
+            for (int i = 0; i < 16; i++) w[i] = WEIGHTS[indices[i]] / 64.0f;
+            if (!leastSquares<4>(block, w, e0, e1)) break;
+        }
+
+        // The most significant index bit of the first pixel is implied zero
+        if (best_indices[0] & 8)
+        {
+            std::swap(best_q[0], best_q[1]);
+            std::swap(best_p[0], best_p[1]);
+            for (auto &index : best_indices) index = (uint8_t)(15 - index);
+        }
+
+        BitPacker bits;
+        bits.put(1 << 6, 7);
+        for (int k = 0; k < 4; k++)
+        {
+            bits.put(best_q[0][k], 7);
+            bits.put(best_q[1][k], 7);
+        }
+        bits.put(best_p[0], 1);
+        bits.put(best_p[1], 1);
+        bits.put(best_indices[0], 3);
+        for (int i = 1; i < 16; i++) bits.put(best_indices[i], 4);
+        bits.write(out);
+    }
+
+    std::vector<glm::u8vec4> downsample(const std::vector<glm::u8vec4> &image, const glm::ivec2 &size, const glm::ivec2 &half)
+    {
+        static const auto lut = []
+        {
+            std::array<float, 256> lut;
+            for (int i = 0; i < 256; i++) lut[i] = srgbGammaExpand(i / 255.0f);
+            return lut;
+        }();
+
+        std::vector<glm::u8vec4> result((size_t)half.x * half.y);
+        for (int y = 0; y < half.y; y++)
+        {
+            int y0 = std::min(2 * y, size.y - 1), y1 = std::min(2 * y + 1, size.y - 1);
+            for (int x = 0; x < half.x; x++)
+            {
+                int x0 = std::min(2 * x, size.x - 1), x1 = std::min(2 * x + 1, size.x - 1);
+                const glm::u8vec4* p[4] = {
+                    &image[(size_t)y0 * size.x + x0], &image[(size_t)y0 * size.x + x1],
+                    &image[(size_t)y1 * size.x + x0], &image[(size_t)y1 * size.x + x1]
+                };
+
+                glm::vec4 sum(0.0f);
+                for (auto c : p) sum += glm::vec4(lut[c->r], lut[c->g], lut[c->b], c->a / 255.0f);
+                sum *= 0.25f;
+
+                glm::vec4 srgb(srgbGammaCompress(sum.r), srgbGammaCompress(sum.g), srgbGammaCompress(sum.b), sum.a);
+                result[(size_t)y * half.x + x] = glm::u8vec4(glm::clamp(srgb, 0.0f, 1.0f) * 255.0f + 0.5f);
+            }
+        }
+        return result;
+    }
+
+    void compressLevel(const std::vector<glm::u8vec4> &image, const glm::ivec2 &size, BlockFormat format, uint8_t* out, unsigned threads)
+    {
+        const glm::ivec2 blocks = (size + 3) / 4;
+        const size_t bytes = blockBytes(format);
+
+        parallelFor(blocks.y, [&](size_t by)
+        {
+            for (int bx = 0; bx < blocks.x; bx++)
+            {
+                // Edge blocks repeat the last row and column
+                Block block;
+                for (int i = 0; i < 16; i++)
+                {
+                    int x = std::min(bx * 4 + i % 4, size.x - 1);
+                    int y = std::min((int)by * 4 + i / 4, size.y - 1);
+                    const glm::u8vec4 &c = image[(size_t)y * size.x + x];
+                    for (int k = 0; k < 4; k++) block.c[k][i] = c[k];
+                }
+
+                uint8_t* block_out = out + ((size_t)by * blocks.x + bx) * bytes;
+                if (format == BlockFormat::BC1) encodeBC1(block, block_out);
+                else encodeBC7(block, block_out);
+            }
+        }, threads);
+    }
+}
+
+size_t blockBytes(BlockFormat format)
+{
+    return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+int mipLevels(const glm::ivec2 &size)
+{
+    int levels = 1;
+    for (int s = std::max(size.x, size.y); s > 1; s /= 2) levels++;
+    return levels;
+}
+
+size_t compressedBytes(BlockFormat format, const glm::ivec2 &size)
+{
+    glm::ivec2 blocks = (size + 3) / 4;
+    return (size_t)blocks.x * blocks.y * blockBytes(format);
+}
+
+std::vector<uint8_t> compressImage(const std::vector<glm::u8vec4> &rgba, const glm::ivec2 &size, BlockFormat format,
+                                   int levels, std::vector<size_t> &offsets, unsigned threads)
+{
+    offsets.clear();
+    size_t total = 0;
+    glm::ivec2 level_size = size;
+    for (int level = 0; level < levels; level++)
+    {
+        offsets.push_back(total);
+        total += compressedBytes(format, level_size);
+        level_size = glm::max(level_size / 2, glm::ivec2(1));
+    }
+
+    std::vector<uint8_t> data(total);
+
+    std::vector<glm::u8vec4> image = rgba;
+    level_size = size;
+    for (int level = 0; level < levels; level++)
+    {
+        compressLevel(image, level_size, format, data.data() + offsets[level], threads);
+
+        if (level + 1 < levels)
+        {
+            glm::ivec2 half = glm::max(level_size / 2, glm::ivec2(1));
+            image = downsample(image, level_size, half);
+            level_size = half;
+        }
+    }
+
+    return data;
+}
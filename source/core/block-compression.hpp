@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+/*************************************************************************
+CPU encoders for the block compressed texture formats of camera images.
+Both formats code 4x4 pixel blocks:
+
+  BC1  8 bytes per block, two RGB565 endpoints and 2-bit indices, opaque
+  BC7  16 bytes per block in mode 6 only, two RGBA endpoints of 7 bits
+       plus a p-bit each and 4-bit indices
+
+Endpoints start from the principal axis of the block colors and are
+refined by least squares for the chosen indices. The per pixel palette
+search is written over plain arrays so that the compiler vectorizes it.
+Images are encoded one block row per task on all cores.
+*************************************************************************/
+enum class BlockFormat { BC1, BC7 };
+
+size_t blockBytes(BlockFormat format);
+
+// Levels of a full mipmap chain down to 1x1
+int mipLevels(const glm::ivec2 &size);
+
+// Bytes of one compressed level
+size_t compressedBytes(BlockFormat format, const glm::ivec2 &size);
+
+// Compresses an sRGB RGBA image, rows from the bottom. Mipmaps are box filtered in linear light and
+// stored after the base level when levels > 1, offsets[level] is where each level starts. Block rows
+// are spread over all cores unless threads is set, callers that already run one image per core pass 1.
+std::vector<uint8_t> compressImage(const std::vector<glm::u8vec4> &rgba, const glm::ivec2 &size, BlockFormat format,
+                                   int levels, std::vector<size_t> &offsets, unsigned threads = 0);
@@ -1,207 +1,1260 @@
 #include "camera-array.hpp"
 
 #include <sstream>
+#include <fstream>
 #include <iostream>
+#include <iomanip>
 #include <vector>
 #include <algorithm>
+#include <array>
+#include <chrono>
 
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 
 #include <nanogui/opengl.h>
 
 #include "util.hpp"
+#include "block-compression.hpp"
+
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+
+#ifndef GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#endif
 
 #define STB_IMAGE_STATIC
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
-CameraArray::CameraArray(const std::filesystem::path& path)
+CameraArray::CameraArray(const std::filesystem::path& path, Storage storage, bool mipmaps, bool progressive) 
+    : folder(path), storage(storage), mipmaps(mipmaps), progressive(progressive)
 {
-    stbi_set_flip_vertically_on_load(true);
+    if (!supported(storage)) throw std::runtime_error("Block compressed texture storage isn't supported by the OpenGL driver");
+    load();
+}
 
-    const std::vector<std::string> extensions = {
-        "JPEG", "JPG", "PNG", "TGA", "BMP", "PSD", "GIF", "HDR", "PIC", "PNM"
+bool CameraArray::reload()
+{
+    // Cameras that were still pending are decoded by the full load
+    stopLoading();
+    return load();
+}
+
+namespace
+{
+    // FNV-1a of the file contents
+    uint64_t hashFile(const std::filesystem::path &file)
+    {
+        uint64_t hash = 14695981039346656037ull;
+
+        std::ifstream in(file, std::ios::binary);
+        std::vector<char> buffer(1 << 20);
+        while (in)
+        {
+            in.read(buffer.data(), buffer.size());
+            for (std::streamsize i = 0; i < in.gcount(); i++)
+            {
+                hash = (hash ^ (uint8_t)buffer[i]) * 1099511628211ull;
+            }
+        }
+
+        return hash;
+    }
+
+    // Block format of a compressed internal format, false if the format is uncompressed
+    bool blockFormat(int internal_format, BlockFormat &format)
+    {
+        if (internal_format == GL_COMPRESSED_SRGB_S3TC_DXT1_EXT) format = BlockFormat::BC1;
+        else if (internal_format == GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM) format = BlockFormat::BC7;
+        else return false;
+        return true;
+    }
+
+    bool blockFormat(CameraArray::Storage storage, BlockFormat &format)
+    {
+        if (storage == CameraArray::Storage::BC1) format = BlockFormat::BC1;
+        else if (storage == CameraArray::Storage::BC7) format = BlockFormat::BC7;
+        else return false;
+        return true;
+    }
+
+    // Uncompressed texture of GL_TEXTURE_2D, only allocated if there is no data
+    void texImage(const glm::ivec2 &size, int internal_format, int pixel_format, int pixel_type, const std::vector<uint8_t> &data, bool mipmaps)
+    {
+        // Rows of single channel and RGB images are tightly packed
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, internal_format, size.x, size.y, 0, pixel_format, pixel_type, data.empty() ? NULL : data.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        if (mipmaps)
+        {
+            glGenerateMipmap(GL_TEXTURE_2D);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        }
+        else
+        {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    }
+
+    void texSubImage(const glm::ivec2 &size, int pixel_format, int pixel_type, const std::vector<uint8_t> &data, bool mipmaps)
+    {
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size.x, size.y, pixel_format, pixel_type, data.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        if (mipmaps) glGenerateMipmap(GL_TEXTURE_2D);
+    }
+
+    // Y and 2x2 averaged CbCr planes of an RGB image, full range BT.601 as in JPEG files
+    void splitYCbCr(const uint8_t* rgb, CameraArray::Image &image)
+    {
+        const glm::ivec2 size = image.size;
+        const glm::ivec2 chroma_size = CameraArray::chromaSize(size);
+
+        image.data.resize((size_t)size.x * size.y);
+        image.chroma.resize((size_t)chroma_size.x * chroma_size.y * 2);
+
+        auto pixel = [&](int x, int y)
+        {
+            const uint8_t* p = rgb + ((size_t)y * size.x + x) * 3;
+            return glm::vec3(p[0], p[1], p[2]);
+        };
+
+        for (int y = 0; y < size.y; y++)
+        {
+            for (int x = 0; x < size.x; x++)
+            {
+                image.data[(size_t)y * size.x + x] = (uint8_t)(glm::dot(pixel(x, y), glm::vec3(0.299f, 0.587f, 0.114f)) + 0.5f);
+            }
+        }
+
+        for (int y = 0; y < chroma_size.y; y++)
+        {
+            for (int x = 0; x < chroma_size.x; x++)
+            {
+                // The last row and column of odd sizes cover a single pixel
+                int x1 = std::min(2 * x + 1, size.x - 1), y1 = std::min(2 * y + 1, size.y - 1);
+                glm::vec3 c = 0.25f * (pixel(2 * x, 2 * y) + pixel(x1, 2 * y) + pixel(2 * x, y1) + pixel(x1, y1));
+
+                float cb = 128.0f + glm::dot(c, glm::vec3(-0.168736f, -0.331264f, 0.5f));
+                float cr = 128.0f + glm::dot(c, glm::vec3(0.5f, -0.418688f, -0.081312f));
+
+                uint8_t* out = &image.chroma[((size_t)y * chroma_size.x + x) * 2];
+                out[0] = (uint8_t)glm::clamp(cb + 0.5f, 0.0f, 255.0f);
+                out[1] = (uint8_t)glm::clamp(cr + 0.5f, 0.0f, 255.0f);
+            }
+        }
+    }
+
+    constexpr char TEXTURE_CACHE_MAGIC[4] = { 'L', 'F', 'T', 'C' };
+
+    // Larger than any texture OpenGL accepts, only bounds what a corrupt entry can ask for
+    constexpr int MAX_TEXTURE_CACHE_SIZE = 65536;
+
+    std::filesystem::path textureCachePath(const std::filesystem::path &file, BlockFormat format)
+    {
+        std::string name = file.filename().string() + (format == BlockFormat::BC1 ? ".bc1" : ".bc7");
+        return file.parent_path() / CameraArray::TEXTURE_CACHE_FOLDER / name;
+    }
+
+    // Cache entries are valid for the size and modification time of the image file they were encoded from
+    struct TextureCacheKey
+    {
+        uint64_t file_size;
+        int64_t mtime;
     };
 
+    bool textureCacheKey(const std::filesystem::path &file, TextureCacheKey &key)
+    {
+        std::error_code error;
+        key.file_size = std::filesystem::file_size(file, error);
+        if (error) return false;
+        key.mtime = (int64_t)std::filesystem::last_write_time(file, error).time_since_epoch().count();
+        return !error;
+    }
+
+    // Header of magic, key, width, height and level count, followed by the level offsets and the data
+    bool readTextureCache(const std::filesystem::path &file, BlockFormat format, CameraArray::Image &image)
+    {
+        TextureCacheKey key;
+        if (!textureCacheKey(file, key)) return false;
+
+        std::ifstream in(textureCachePath(file, format), std::ios::binary);
+        if (!in) return false;
+
+        char magic[4];
+        TextureCacheKey cached;
+        int32_t size[2], levels;
+        in.read(magic, 4);
+        in.read(reinterpret_cast<char*>(&cached), sizeof(cached));
+        in.read(reinterpret_cast<char*>(size), sizeof(size));
+        in.read(reinterpret_cast<char*>(&levels), sizeof(levels));
+
+        if (!in || !std::equal(magic, magic + 4, TEXTURE_CACHE_MAGIC) || cached.file_size != key.file_size || 
+            cached.mtime != key.mtime || size[0] < 1 || size[1] < 1 || size[0] > MAX_TEXTURE_CACHE_SIZE || 
+            size[1] > MAX_TEXTURE_CACHE_SIZE || levels != mipLevels({ size[0], size[1] }))
+        {
+            return false;
+        }
+
+        std::vector<uint64_t> offsets(levels);
+        in.read(reinterpret_cast<char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+        if (!in) return false;
+
+        // The levels are packed in order, any other layout or length is a corrupt entry and a cache miss
+        size_t bytes = 0;
+        for (int level = 0; level < levels; level++)
+        {
+            if (offsets[level] != bytes) return false;
+            bytes += compressedBytes(format, glm::max(glm::ivec2(size[0], size[1]) >> level, glm::ivec2(1)));
+        }
+
+        const auto data_start = in.tellg();
+        in.seekg(0, std::ios::end);
+        if (!in || (uint64_t)(in.tellg() - data_start) != bytes) return false;
+        in.seekg(data_start);
+
+        std::vector<uint8_t> data(bytes);
+        in.read(reinterpret_cast<char*>(data.data()), bytes);
+        if (!in) return false;
+
+        image.data = std::move(data);
+        image.size = { size[0], size[1] };
+        image.levels.assign(offsets.begin(), offsets.end());
+        return true;
+    }
+
+    void writeTextureCache(const std::filesystem::path &file, BlockFormat format, const CameraArray::Image &image)
+    {
+        TextureCacheKey key;
+        if (!textureCacheKey(file, key)) return;
+
+        // The cache is only an optimization, a read-only folder just means encoding on every load
+        auto path = textureCachePath(file, format);
+        std::error_code error;
+        std::filesystem::create_directories(path.parent_path(), error);
+
+        std::ofstream out(path, std::ios::binary);
+        if (!out) return;
+
+        int32_t size[2] = { image.size.x, image.size.y };
+        int32_t levels = (int32_t)image.levels.size();
+        std::vector<uint64_t> offsets(image.levels.begin(), image.levels.end());
+
+        out.write(TEXTURE_CACHE_MAGIC, 4);
+        out.write(reinterpret_cast<const char*>(&key), sizeof(key));
+        out.write(reinterpret_cast<const char*>(size), sizeof(size));
+        out.write(reinterpret_cast<const char*>(&levels), sizeof(levels));
+        out.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+        out.write(reinterpret_cast<const char*>(image.data.data()), image.data.size());
+    }
+}
+
+bool CameraArray::supported(Storage storage)
+{
+    BlockFormat format;
+    if (!blockFormat(storage, format)) return true;
+
+    // BPTC is core since OpenGL 4.2
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (format == BlockFormat::BC7 && major * 10 + minor >= 42) return true;
+
+    const char* required = format == BlockFormat::BC1 ? "GL_EXT_texture_compression_s3tc" : "GL_ARB_texture_compression_bptc";
+
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++)
+    {
+        const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        if (extension && std::string(extension) == required) return true;
+    }
+    return false;
+}
+
+bool CameraArray::load()
+{
+    auto manifest = readManifest();
+    std::map<std::string, ManifestEntry> updated_manifest;
+
+    std::map<std::string, size_t> loaded;
+    for (size_t i = 0; i < cameras.size(); i++)
+    {
+        loaded[cameras[i].file] = i;
+    }
+    std::vector<bool> reused(cameras.size(), false);
+
+    // Image files that follow the naming scheme, all light slab views or all perspective cameras like the first
+    struct Candidate
+    {
+        std::filesystem::path path;
+        ManifestEntry entry;
+        bool unchanged;
+        int stride = 1;
+    };
+    std::vector<Candidate> candidates;
+    bool manifest_changed = false;
+
+    for (const auto& file : std::filesystem::directory_iterator(folder))
+    {
+        if (!file.is_regular_file()) continue;
+
+        std::string name = file.path().filename().string();
+
+        ManifestEntry entry{};
+        entry.file_size = file.file_size();
+        entry.mtime = (int64_t)file.last_write_time().time_since_epoch().count();
+
+        // File names are only parsed and hashed again if the file has changed
+        auto cached = manifest.find(name);
+        bool unchanged = cached != manifest.end() && cached->second.file_size == entry.file_size && cached->second.mtime == entry.mtime;
+        if (unchanged)
+        {
+            entry = cached->second;
+        }
+        else
+        {
+            if (!parseFilename(file.path(), entry.info)) continue;
+
+            manifest_changed = true;
+
+            entry.hash = hashFile(file.path());
+
+            // Same contents with a new modification time, e.g. after a copy
+            unchanged = cached != manifest.end() && cached->second.file_size == entry.file_size && cached->second.hash == entry.hash;
+            if (unchanged) entry.size = cached->second.size;
+        }
+
+        if (!candidates.empty() && entry.info.light_slab != candidates[0].entry.info.light_slab) continue;
+
+        candidates.push_back({ file.path(), entry, unchanged });
+    }
+
     glm::vec2 max_xy(std::numeric_limits<float>::lowest());
     glm::vec2 min_xy(std::numeric_limits<float>::max());
 
     glm::uvec2 max_ij(0);
 
-    light_slab = true;
+    for (const auto &c : candidates)
+    {
+        max_xy = glm::max(max_xy, c.entry.info.xy);
+        min_xy = glm::min(min_xy, c.entry.info.xy);
+        max_ij = glm::max(max_ij, c.entry.info.ij);
+    }
+
+    const glm::ivec2 mid_ij = max_ij / 2u;
 
-    for (const auto& file : std::filesystem::directory_iterator(path))
+    // Only the coarsest level present is loaded up front, every stride-th camera from the middle one.
+    // Later loads decode everything, pending cameras were discarded when they began.
+    size_t loaded_now = candidates.size();
+    if (progressive && cameras.empty() && !candidates.empty())
     {
-        if (!file.path().has_extension())
+        for (auto &c : candidates)
         {
-            continue;
+            glm::ivec2 d = glm::abs(glm::ivec2(c.entry.info.ij) - mid_ij);
+            c.stride = PROGRESSIVE_STRIDE;
+            while (c.stride > 1 && (d.x % c.stride || d.y % c.stride)) c.stride /= 2;
+        }
+        std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b) { return a.stride > b.stride; });
+
+        loaded_now = 0;
+        while (loaded_now < candidates.size() && candidates[loaded_now].stride == candidates[0].stride) loaded_now++;
+    }
+
+    std::vector<Camera> scanned;
+    size_t decoded = 0;
+
+    for (size_t i = 0; i < loaded_now; i++)
+    {
+        const auto &file = candidates[i].path;
+        const std::string name = file.filename().string();
+        ManifestEntry entry = candidates[i].entry;
+
+        auto existing = loaded.find(name);
+        bool in_memory = existing != loaded.end() && !reused[existing->second];
+
+        Camera dc;
+        if (candidates[i].unchanged && in_memory)
+        {
+            dc = cameras[existing->second];
+            reused[existing->second] = true;
         }
         else
         {
-            std::string ext = file.path().extension().string();
-            std::transform(ext.begin(), ext.end(), ext.begin(), toupper);
-            bool is_valid = false;
-            for (const auto& valid : extensions)
+            std::cout << "\r" << std::string(96, ' ');
+            std::cout << "\rLoading " << file.filename();
+
+            Image image = decode(file, storage);
+
+            if (image.data.empty()) continue;
+
+            entry.size = image.size;
+
+            // Changed images of the same format are uploaded to the existing texture
+            const Camera* old = in_memory ? &cameras[existing->second] : nullptr;
+            if (old && old->size == image.size && old->pixel_type == image.pixel_type && old->internal_format == image.internal_format)
             {
-                if (ext == std::string("." + valid))
-                {
-                    is_valid = true;
-                    break;
-                }
+                dc = *old;
+                reused[existing->second] = true;
+                updateTexture(dc.texture, dc.chroma_texture, image);
+                releaseLuminanceTexture(dc);
             }
-            if (!is_valid)
+            else
             {
-                continue;
+                dc.size = image.size;
+                dc.pixel_format = image.pixel_format;
+                dc.pixel_type = image.pixel_type;
+                dc.internal_format = image.internal_format;
+                dc.texture = createTexture(image, dc.chroma_texture);
             }
+
+            decoded++;
         }
 
-        std::filesystem::path extensionless = file.path();
-        extensionless.replace_extension("");
-        std::stringstream ss(extensionless.filename().string());
+        dc.file = name;
+        dc.xy = entry.info.xy;
+        dc.ij = entry.info.ij;
+        dc.focal_length = entry.info.focal_length;
+        dc.sensor_width = entry.info.sensor_width;
+
+        scanned.push_back(dc);
+        updated_manifest[name] = entry;
+    }
+
+    if (decoded) std::cout << std::endl;
 
-        std::vector<std::string> properties;
-        while (ss.good())
+    size_t removed = 0;
+    for (size_t i = 0; i < cameras.size(); i++)
+    {
+        if (reused[i]) continue;
+        glDeleteTextures(1, &cameras[i].texture);
+        glDeleteTextures(1, &cameras[i].chroma_texture);
+        releaseLuminanceTexture(cameras[i]);
+        removed++;
+    }
+
+    bool changed = decoded || removed || scanned.size() != cameras.size();
+
+    if (!manifest.empty() || decoded) 
+    {
+        std::cout << "Reused " << scanned.size() - decoded << " and decoded " << decoded << " of " << scanned.size() << " cameras" << std::endl;
+    }
+
+    cameras = std::move(scanned);
+    if (!candidates.empty()) light_slab = candidates[0].entry.info.light_slab;
+
+    if (changed) releaseGridTextures();
+
+    texture_bytes = 0;
+    for (const auto &c : cameras) texture_bytes += textureBytes(c);
+    if (grid_texture_array) texture_bytes += grid_texture_bytes;
+
+    if (cameras.empty())
+    {
+        throw std::runtime_error("Invalid light field folder, no images were loaded.");
+    }
+
+    // Ranges include the pending cameras so that positions don't change while they load
+    xy_size = max_xy - min_xy;
+    mid_xy = min_xy + xy_size / 2.0f;
+    camera_spacing = xy_size / glm::vec2(glm::max(max_ij, glm::uvec2(1)));
+
+    if (light_slab)
+    {
+        for (const auto& c : candidates)
         {
-            std::string p;
-            std::getline(ss, p, '_');
-            if(!p.empty()) properties.push_back(p);
+            if (glm::ivec2(c.entry.info.ij) == mid_ij)
+            {
+                mid_xy = c.entry.info.xy;
+                break;
+            }
         }
+    }
+
+    for (auto &c : cameras) place(c);
 
-        // name_i_j_-y_x, with extension _focal-length_sensor-width
+    grid = Grid();
 
-        if (properties.size() != 5 && properties.size() != 7) continue;
+    if (loaded_now == candidates.size())
+    {
+        if (manifest_changed || updated_manifest.size() != manifest.size()) writeManifest(updated_manifest);
+        if (light_slab) findGrid();
+        return changed;
+    }
 
-        if (!cameras.empty())
+    // The remaining levels are decoded on all cores but one, which is left to the render thread
+    for (size_t i = loaded_now; i < candidates.size(); i++)
+    {
+        pending.push_back({ candidates[i].path, candidates[i].entry, candidates[i].stride });
+    }
+    pending_images.assign(pending.size(), Image());
+    pending_decoded.assign(pending.size(), false);
+    pending_uploaded = 0;
+    resident_stride = candidates[0].stride;
+
+    loading_manifest = std::move(updated_manifest);
+    loading_manifest_changed = manifest_changed || candidates.size() != manifest.size();
+    loading_start = std::chrono::steady_clock::now();
+
+    next_pending = 0;
+    stop_loading = false;
+    unsigned cores = std::thread::hardware_concurrency();
+    unsigned workers = cores > 1 ? cores - 1 : 1;
+    for (unsigned i = 0; i < workers; i++)
+    {
+        loaders.emplace_back([this] { decodePending(); });
+    }
+
+    std::cout << "Loaded cameras at a stride of " << resident_stride << ", " << pending.size() 
+              << " more are loading in the background" << std::endl;
+
+    return changed;
+}
+
+void CameraArray::place(Camera &c) const
+{
+    c.xy -= mid_xy;
+
+    if (!light_slab)
+    {
+        auto view = glm::lookAt(
+            glm::vec3(c.xy.x, c.xy.y, 0),
+            glm::vec3(c.xy.x, c.xy.y, -1),
+            glm::vec3(0, 1, 0)
+        );
+
+        auto projection = perspectiveProjection(c.focal_length, c.sensor_width, c.size);
+
+        c.VP = projection * view;
+    }
+}
+
+void CameraArray::decodePending()
+{
+    while (!stop_loading)
+    {
+        size_t i = next_pending++;
+        if (i >= pending.size()) return;
+
+        // Each loader thread already has a core
+        Image image = decode(pending[i].path, storage, 1);
+
+        std::lock_guard<std::mutex> lock(loading_mutex);
+        pending_images[i] = std::move(image);
+        pending_decoded[i] = true;
+    }
+}
+
+bool CameraArray::uploadPending(size_t max_bytes)
+{
+    size_t bytes = 0;
+    size_t added = 0;
+    while (pending_uploaded < pending.size() && bytes < max_bytes)
+    {
+        Image image;
         {
-            if (properties.size() == 5 && !light_slab) continue;
-            if (properties.size() == 7 &&  light_slab) continue;
+            std::lock_guard<std::mutex> lock(loading_mutex);
+            if (!pending_decoded[pending_uploaded]) break;
+            image = std::move(pending_images[pending_uploaded]);
         }
 
-        unsigned i = std::stoi(properties[1]);
-        unsigned j = std::stoi(properties[2]);
-            
-        float y = -std::stof(properties[3]) * 1e-3f;
-        float x =  std::stof(properties[4]) * 1e-3f;
+        const auto &p = pending[pending_uploaded++];
 
-        float focal_length = -1.0f, sensor_width = -1.0f;
-        if (properties.size() == 7)
-        {
-            focal_length = std::stof(properties[5]);
-            sensor_width = std::stof(properties[6]);
+        // A level is complete once the next camera belongs to a finer level
+        if (pending_uploaded == pending.size() || pending[pending_uploaded].stride < p.stride) resident_stride = p.stride;
 
-            light_slab = false;
+        if (image.data.empty()) 
+        {
+            loading_manifest_changed = true;
+            continue;
         }
 
-        std::cout << "\r" << std::string(96, ' ');
-        std::cout << "\rLoading " << file.path().filename();
+        Camera c;
+        c.size = image.size;
+        c.pixel_format = image.pixel_format;
+        c.pixel_type = image.pixel_type;
+        c.internal_format = image.internal_format;
+        c.texture = createTexture(image, c.chroma_texture);
+        c.file = p.path.filename().string();
+        c.xy = p.entry.info.xy;
+        c.ij = p.entry.info.ij;
+        c.focal_length = p.entry.info.focal_length;
+        c.sensor_width = p.entry.info.sensor_width;
+        place(c);
+
+        cameras.push_back(c);
+        texture_bytes += textureBytes(c);
+
+        ManifestEntry entry = p.entry;
+        entry.size = image.size;
+        loading_manifest[c.file] = entry;
 
+        bytes += image.data.size() + image.chroma.size();
+        added++;
+    }
+
+    if (pending_uploaded < pending.size()) return added > 0;
+
+    for (auto &t : loaders) t.join();
+    loaders.clear();
+    pending.clear();
+    pending_images.clear();
+    pending_decoded.clear();
+    resident_stride = 1;
+
+    if (loading_manifest_changed) writeManifest(loading_manifest);
+    loading_manifest.clear();
+
+    if (light_slab) findGrid();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loading_start).count();
+    std::cout << "Loaded all " << cameras.size() << " cameras after " << std::fixed << std::setprecision(2) << seconds 
+              << " s" << std::defaultfloat << std::endl;
+
+    return true;
+}
+
+bool CameraArray::updateLoading()
+{
+    return loading() && uploadPending(MAX_UPLOAD_BYTES);
+}
+
+bool CameraArray::finishLoading()
+{
+    if (!loading()) return false;
+
+    for (auto &t : loaders) t.join();
+    loaders.clear();
+
+    uploadPending(std::numeric_limits<size_t>::max());
+    return true;
+}
+
+void CameraArray::stopLoading()
+{
+    stop_loading = true;
+    for (auto &t : loaders) t.join();
+    loaders.clear();
+
+    pending.clear();
+    pending_images.clear();
+    pending_decoded.clear();
+    loading_manifest.clear();
+    resident_stride = 1;
+}
+
+float CameraArray::minimumAperture() const
+{
+    if (!loading()) return 0.0f;
+
+    // The aperture filter of each camera reaches one step of the resident level, 
+    // which covers the middle between four resident cameras
+    return 2.0f * resident_stride * std::max(camera_spacing.x, camera_spacing.y);
+}
+
+std::map<std::string, CameraArray::ManifestEntry> CameraArray::readManifest() const
+{
+    std::map<std::string, ManifestEntry> manifest;
+
+    std::ifstream file(folder / MANIFEST_FILE);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#') continue;
+
+        // size mtime i j x y focal-length sensor-width width height hash name
+        std::istringstream in(line);
+        ManifestEntry e;
+        std::string name;
+        in >> e.file_size >> e.mtime >> e.info.ij.x >> e.info.ij.y >> e.info.xy.x >> e.info.xy.y 
+           >> e.info.focal_length >> e.info.sensor_width >> e.size.x >> e.size.y >> std::hex >> e.hash >> std::dec;
+        in.get();
+        std::getline(in, name);
+
+        // An unreadable manifest only means that everything is decoded again
+        if (in.fail() || name.empty()) return {};
+
+        e.info.light_slab = e.info.focal_length < 0.0f;
+        manifest[name] = e;
+    }
+
+    return manifest;
+}
+
+void CameraArray::writeManifest(const std::map<std::string, ManifestEntry> &manifest) const
+{
+    std::ofstream file(folder / MANIFEST_FILE);
+    if (!file)
+    {
+        std::cout << "Unable to write " << (folder / MANIFEST_FILE).string() << std::endl;
+        return;
+    }
+
+    file << "# size mtime i j x y focal-length sensor-width width height hash name\n";
+    file << std::setprecision(9);
+    for (const auto &[name, e] : manifest)
+    {
+        file << e.file_size << " " << e.mtime << " " << e.info.ij.x << " " << e.info.ij.y << " " 
+             << e.info.xy.x << " " << e.info.xy.y << " " << e.info.focal_length << " " << e.info.sensor_width << " " 
+             << e.size.x << " " << e.size.y << " " << std::hex << e.hash << std::dec << " " << name << "\n";
+    }
+}
+
+CameraArray::~CameraArray()
+{
+    stopLoading();
+
+    for (const auto &c : cameras)
+    {
+        glDeleteTextures(1, &c.texture);
+        glDeleteTextures(1, &c.chroma_texture);
+        glDeleteTextures(1, &c.luminance_texture);
+    }
+    releaseGridTextures();
+}
+
+bool CameraArray::parseFilename(const std::filesystem::path &file, FileInfo &info)
+{
+    static const std::vector<std::string> extensions = {
+        "JPEG", "JPG", "PNG", "TGA", "BMP", "PSD", "GIF", "HDR", "PIC", "PNM"
+    };
+
+    if (!file.has_extension()) return false;
+
+    std::string ext = file.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), toupper);
+    if (std::find(extensions.begin(), extensions.end(), ext.substr(1)) == extensions.end()) return false;
+
+    std::filesystem::path extensionless = file;
+    extensionless.replace_extension("");
+    std::stringstream ss(extensionless.filename().string());
+
+    std::vector<std::string> properties;
+    while (ss.good())
+    {
+        std::string p;
+        std::getline(ss, p, '_');
+        if(!p.empty()) properties.push_back(p);
+    }
+
+    // name_i_j_-y_x, with extension _focal-length_sensor-width
+
+    if (properties.size() != 5 && properties.size() != 7) return false;
+
+    info.ij = { std::stoi(properties[1]), std::stoi(properties[2]) };
+    info.xy = { std::stof(properties[4]) * 1e-3f, -std::stof(properties[3]) * 1e-3f };
+
+    info.light_slab = properties.size() == 5;
+    if (!info.light_slab)
+    {
+        info.focal_length = std::stof(properties[5]);
+        info.sensor_width = std::stof(properties[6]);
+    }
+
+    return true;
+}
+
+CameraArray::Image CameraArray::decode(const std::filesystem::path &file, Storage storage, unsigned threads)
+{
+    // The flag is global, set once before any thread decodes
+    static const bool flip = [] { stbi_set_flip_vertically_on_load(true); return true; }();
+    (void)flip;
+
+    Image image{};
+
+    BlockFormat format;
+    if (blockFormat(storage, format))
+    {
+        image.pixel_format = GL_RGBA;
+        image.pixel_type = GL_UNSIGNED_BYTE;
+        image.internal_format = format == BlockFormat::BC1 ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;
+
+        if (readTextureCache(file, format, image)) return image;
+
+        int width, height, channels;
+        uint8_t* rgba = stbi_load(file.string().c_str(), &width, &height, &channels, 4);
+        if (!rgba) return image;
+
+        image.size = { width, height };
+        std::vector<glm::u8vec4> pixels(reinterpret_cast<glm::u8vec4*>(rgba), reinterpret_cast<glm::u8vec4*>(rgba) + (size_t)width * height);
+        stbi_image_free(rgba);
+
+        image.data = compressImage(pixels, image.size, format, mipLevels(image.size), image.levels, threads);
+        writeTextureCache(file, format, image);
+
+        return image;
+    }
+
+    // stb_image only returns upsampled RGB, so the planes are recreated from it. Alpha is dropped.
+    if (storage == Storage::YCBCR_420)
+    {
         int width, height, channels;
-        uint8_t* image_data = stbi_load(file.path().string().c_str(), &width, &height, &channels, 0);
+        uint8_t* rgb = stbi_load(file.string().c_str(), &width, &height, &channels, 3);
+        if (!rgb) return image;
+
+        image.size = { width, height };
+        image.pixel_format = GL_RED;
+        image.pixel_type = GL_UNSIGNED_BYTE;
+        image.internal_format = GL_R8;
+        splitYCbCr(rgb, image);
 
-        if (!image_data) continue;
+        stbi_image_free(rgb);
+        return image;
+    }
 
-        int pixel_format;
-        switch (channels)
+    int width, height, channels;
+    uint8_t* image_data = stbi_load(file.string().c_str(), &width, &height, &channels, 0);
+
+    if (!image_data) return image;
+
+    if (channels < 1 || channels > 4)
+    {
+        stbi_image_free(image_data);
+        return image;
+    }
+
+    constexpr int pixel_formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+
+    image.size = { width, height };
+    image.pixel_format = pixel_formats[channels - 1];
+    image.pixel_type = GL_UNSIGNED_BYTE;
+    image.internal_format = image.pixel_format;
+
+    const size_t samples = (size_t)width * height * channels;
+
+    if (storage == Storage::SRGB_SHADER)
+    {
+        image.data.assign(image_data, image_data + samples);
+    }
+    // There are no single and dual channel sRGB formats, these are linearized instead
+    else if (storage == Storage::SRGB_HARDWARE && channels >= 3)
+    {
+        image.internal_format = channels == 3 ? GL_SRGB8 : GL_SRGB8_ALPHA8;
+        image.data.assign(image_data, image_data + samples);
+    }
+    else
+    {
+        // Half float sRGB to linear lookup tables, alpha (channel 2 and 4) is already linear
+        static const auto lut = []
         {
-        case 1: pixel_format = GL_RED; break;
-        case 2: pixel_format = GL_RG; break;
-        case 3: pixel_format = GL_RGB; break;
-        case 4: pixel_format = GL_RGBA; break;
-        default: stbi_image_free(image_data); continue;
+            std::array<std::array<uint16_t, 256>, 2> lut;
+            for (int i = 0; i < 256; i++)
+            {
+                lut[0][i] = glm::packHalf1x16(srgbGammaExpand(i / 255.0f));
+                lut[1][i] = glm::packHalf1x16(i / 255.0f);
+            }
+            return lut;
+        }();
+
+        const bool has_alpha = channels == 2 || channels == 4;
+
+        image.data.resize(samples * sizeof(uint16_t));
+        uint16_t* half_data = reinterpret_cast<uint16_t*>(image.data.data());
+        for (size_t i = 0; i < samples; i++)
+        {
+            bool alpha = has_alpha && (i % channels) == (size_t)channels - 1;
+            half_data[i] = lut[alpha][image_data[i]];
         }
 
-        // Image is valid
-        Camera dc;
+        constexpr int internal_formats[] = { GL_R16F, GL_RG16F, GL_RGB16F, GL_RGBA16F };
+        image.internal_format = internal_formats[channels - 1];
+        image.pixel_type = GL_HALF_FLOAT;
+    }
+
+    stbi_image_free(image_data);
+
+    return image;
+}
+
+void CameraArray::packTextures(const std::filesystem::path &folder, Storage storage)
+{
+    BlockFormat format;
+    if (!blockFormat(storage, format)) throw std::runtime_error("Only block compressed textures are packed");
+
+    std::vector<std::filesystem::path> files;
+    for (const auto &entry : std::filesystem::directory_iterator(folder))
+    {
+        FileInfo info;
+        if (entry.is_regular_file() && parseFilename(entry.path(), info)) files.push_back(entry.path());
+    }
+    std::sort(files.begin(), files.end());
+
+    size_t encoded = 0, pixels = 0, raw_bytes = 0, compressed_bytes = 0;
+    double seconds = 0.0;
+
+    for (const auto &file : files)
+    {
+        Image cached;
+        if (readTextureCache(file, format, cached)) continue;
+
+        std::cout << "\r" << std::string(96, ' ');
+        std::cout << "\rEncoding " << file.filename();
 
-        dc.size = { width, height };
-        dc.xy = { x, y };
-        dc.ij = { i, j };
-        dc.pixel_format = pixel_format;
-        dc.focal_length = focal_length;
-        dc.sensor_width = sensor_width;
+        auto start = std::chrono::steady_clock::now();
+        Image image = decode(file, storage);
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (image.data.empty()) continue;
+
+        encoded++;
+        pixels += (size_t)image.size.x * image.size.y;
+        raw_bytes += (size_t)image.size.x * image.size.y * 4;
+        compressed_bytes += image.levels.size() > 1 ? image.levels[1] : image.data.size();
+    }
+    if (encoded) std::cout << std::endl;
+
+    std::cout << std::fixed << std::setprecision(2) << "Encoded " << encoded << " and reused " << files.size() - encoded
+              << " of " << files.size() << " cameras" << std::endl;
+    if (encoded)
+    {
+        std::cout << "  " << pixels / 1e6 / seconds << " MP/s including decoding, base levels "
+                  << compressed_bytes / 1e6 << " MB of " << raw_bytes / 1e6 << " MB RGBA8" << std::endl;
+    }
+}
 
-        glGenTextures(1, &dc.texture);
-        glBindTexture(GL_TEXTURE_2D, dc.texture);
-        glTexImage2D(GL_TEXTURE_2D, 0, pixel_format, width, height, 0, pixel_format, GL_UNSIGNED_BYTE, image_data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+unsigned int CameraArray::createTexture(const Image &image, unsigned int &chroma_texture) const
+{
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    BlockFormat format;
+    if (blockFormat(image.internal_format, format))
+    {
+        // Every level is uploaded from the encoded chain, or allocated if there is no data
+        const int levels = mipmaps ? mipLevels(image.size) : 1;
+        for (int level = 0; level < levels; level++)
+        {
+            glm::ivec2 size = glm::max(image.size >> level, glm::ivec2(1));
+            const void* data = image.data.empty() ? NULL : image.data.data() + image.levels[level];
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, image.internal_format, size.x, size.y, 0, (GLsizei)compressedBytes(format, size), data);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    }
+    else
+    {
+        texImage(image.size, image.internal_format, image.pixel_format, image.pixel_type, image.data, mipmaps);
+    }
 
-        stbi_image_free(image_data);
+    chroma_texture = 0;
+    if (ycbcr())
+    {
+        glGenTextures(1, &chroma_texture);
+        glBindTexture(GL_TEXTURE_2D, chroma_texture);
+        texImage(chromaSize(image.size), GL_RG8, GL_RG, GL_UNSIGNED_BYTE, image.chroma, mipmaps);
+    }
+
+    return texture;
+}
+
+void CameraArray::updateTexture(unsigned int texture, unsigned int chroma_texture, const Image &image) const
+{
+    glBindTexture(GL_TEXTURE_2D, texture);
 
-        cameras.push_back(dc);
+    BlockFormat format;
+    if (blockFormat(image.internal_format, format))
+    {
+        const int levels = mipmaps ? mipLevels(image.size) : 1;
+        for (int level = 0; level < levels; level++)
+        {
+            glm::ivec2 size = glm::max(image.size >> level, glm::ivec2(1));
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, size.x, size.y, image.internal_format,
+                                      (GLsizei)compressedBytes(format, size), image.data.data() + image.levels[level]);
+        }
+        return;
+    }
 
-        if (x > max_xy[0]) max_xy[0] = x;
-        if (y > max_xy[1]) max_xy[1] = y;
-        if (x < min_xy[0]) min_xy[0] = x;
-        if (y < min_xy[1]) min_xy[1] = y;
+    texSubImage(image.size, image.pixel_format, image.pixel_type, image.data, mipmaps);
 
-        if (i > max_ij[0]) max_ij[0] = i;
-        if (j > max_ij[1]) max_ij[1] = j;
+    if (chroma_texture)
+    {
+        glBindTexture(GL_TEXTURE_2D, chroma_texture);
+        texSubImage(chromaSize(image.size), GL_RG, GL_UNSIGNED_BYTE, image.chroma, mipmaps);
     }
+}
 
-    std::cout << std::endl;
+void CameraArray::swapTextures(std::vector<unsigned int> &textures, std::vector<unsigned int> &chroma_textures)
+{
+    for (size_t i = 0; i < cameras.size(); i++)
+    {
+        std::swap(cameras[i].texture, textures.at(i));
+        if (ycbcr()) std::swap(cameras[i].chroma_texture, chroma_textures.at(i));
+        releaseLuminanceTexture(cameras[i]);
+    }
+
+    // The grid copy is recreated from the new textures on next use
+    releaseGridTextures();
+}
+
+void CameraArray::bindTextures(size_t index) const
+{
+    const auto &c = cameras.at(index);
+    glBindTexture(GL_TEXTURE_2D, c.texture);
 
-    if (!cameras.empty())
+    if (c.chroma_texture)
     {
-        xy_size = max_xy - min_xy;
-        glm::vec2 mid_xy = min_xy + xy_size / 2.0f;
+        GLint unit;
+        glGetIntegerv(GL_ACTIVE_TEXTURE, &unit);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, c.chroma_texture);
+        glActiveTexture(unit);
+    }
+}
+
+size_t CameraArray::textureBytes(const Camera &c) const
+{
+    size_t bytes = 0;
+
+    BlockFormat format;
+    if (blockFormat(c.internal_format, format))
+    {
+        const int levels = mipmaps ? mipLevels(c.size) : 1;
+        for (int level = 0; level < levels; level++) bytes += compressedBytes(format, glm::max(c.size >> level, glm::ivec2(1)));
+    }
+    else
+    {
+        int channels = c.pixel_format == GL_RED ? 1 : c.pixel_format == GL_RG ? 2 : c.pixel_format == GL_RGB ? 3 : 4;
+        bytes = (size_t)c.size.x * c.size.y * channels * (c.pixel_type == GL_HALF_FLOAT ? 2 : 1);
 
-        if (light_slab)
+        if (ycbcr())
         {
-            glm::ivec2 mid_ij = max_ij / 2u;
-            for (const auto& c : cameras)
-            {
-                if (c.ij[0] == mid_ij[0] && c.ij[1] == mid_ij[1])
-                {
-                    mid_xy = c.xy;
-                    break;
-                }
-            }
+            glm::ivec2 chroma_size = chromaSize(c.size);
+            bytes += (size_t)chroma_size.x * chroma_size.y * 2;
         }
-        
 
-        for (size_t i = 0; i < cameras.size(); i++)
+        // Full mipmap chain adds a third
+        bytes = mipmaps ? (bytes * 4) / 3 : bytes;
+    }
+
+    if (c.luminance_texture) bytes += ((size_t)c.size.x * c.size.y * 2 * 4) / 3;
+
+    return bytes;
+}
+
+void CameraArray::setLuminanceTexture(size_t index, unsigned int texture)
+{
+    auto &c = cameras.at(index);
+    releaseLuminanceTexture(c);
+
+    texture_bytes -= textureBytes(c);
+    c.luminance_texture = texture;
+    texture_bytes += textureBytes(c);
+}
+
+void CameraArray::releaseLuminanceTexture(Camera &c)
+{
+    if (!c.luminance_texture) return;
+
+    texture_bytes -= textureBytes(c);
+    glDeleteTextures(1, &c.luminance_texture);
+    c.luminance_texture = 0;
+    texture_bytes += textureBytes(c);
+}
+
+void CameraArray::findGrid()
+{
+    glm::ivec2 size(0);
+    for (const auto &c : cameras)
+    {
+        size = glm::max(size, glm::ivec2(c.ij) + 1);
+    }
+
+    if (size.x < 2 || size.y < 2 || cameras.size() != (size_t)size.x * size.y) return;
+
+    std::vector<int> grid_cameras(cameras.size(), -1);
+    for (size_t i = 0; i < cameras.size(); i++)
+    {
+        const auto &c = cameras[i];
+        int &cell = grid_cameras[c.ij.x + c.ij.y * size.x];
+        if (cell != -1 || c.size != cameras[0].size || c.internal_format != cameras[0].internal_format) return;
+        cell = (int)i;
+    }
+
+    auto xy = [&](int i, int j) { return cameras[grid_cameras[i + j * size.x]].xy; };
+
+    glm::vec2 origin = xy(0, 0);
+    glm::mat2 step(xy(1, 0) - origin, xy(0, 1) - origin);
+
+    if (std::abs(glm::determinant(step)) < 1e-12f) return;
+
+    // Positions have to agree with the grid to a small fraction of the camera spacing
+    float tolerance = 0.01f * std::min(glm::length(step[0]), glm::length(step[1]));
+    for (const auto &c : cameras)
+    {
+        if (glm::distance(origin + step * glm::vec2(c.ij), c.xy) > tolerance) return;
+    }
+
+    grid.size = size;
+    grid.origin = origin;
+    grid.step = step;
+    grid.cameras = std::move(grid_cameras);
+    grid.regular = true;
+}
+
+unsigned int CameraArray::gridTextureArray()
+{
+    if (grid_texture_array || !grid.regular) return grid_texture_array;
+
+    const auto &first = cameras[grid.cameras[0]];
+
+    std::vector<unsigned int> textures, chroma_textures;
+    for (int camera : grid.cameras)
+    {
+        textures.push_back(cameras[camera].texture);
+        chroma_textures.push_back(cameras[camera].chroma_texture);
+    }
+
+    grid_texture_bytes = 0;
+    grid_texture_array = copyToTextureArray(textures, first.size, first.pixel_format, first.pixel_type, first.internal_format, grid_texture_bytes);
+    if (ycbcr())
+    {
+        grid_chroma_array = copyToTextureArray(chroma_textures, chromaSize(first.size), GL_RG, GL_UNSIGNED_BYTE, GL_RG8, grid_texture_bytes);
+    }
+    texture_bytes += grid_texture_bytes;
+
+    return grid_texture_array;
+}
+
+unsigned int CameraArray::gridChromaArray()
+{
+    gridTextureArray();
+    return grid_chroma_array;
+}
+
+void CameraArray::releaseGridTextures()
+{
+    if (!grid_texture_array) return;
+
+    glDeleteTextures(1, &grid_texture_array);
+    glDeleteTextures(1, &grid_chroma_array);
+    grid_texture_array = grid_chroma_array = 0;
+
+    texture_bytes -= grid_texture_bytes;
+    grid_texture_bytes = 0;
+}
+
+unsigned int CameraArray::copyToTextureArray(const std::vector<unsigned int> &textures, const glm::ivec2 &size, int pixel_format, 
+                                             int pixel_type, int internal_format, size_t &bytes) const
+{
+    const GLsizei layers = (GLsizei)textures.size();
+
+    // Compressed textures can't generate mipmaps, so all levels they have are copied instead
+    BlockFormat format;
+    const bool compressed = blockFormat(internal_format, format);
+    const int levels = compressed && mipmaps ? mipLevels(size) : 1;
+
+    auto levelSize = [&](int level) { return glm::max(size >> level, glm::ivec2(1)); };
+
+    auto levelBytes = [&](int level)
+    {
+        glm::ivec2 level_size = levelSize(level);
+        if (compressed) return compressedBytes(format, level_size);
+        int channels = pixel_format == GL_RED ? 1 : pixel_format == GL_RG ? 2 : pixel_format == GL_RGB ? 3 : 4;
+        return (size_t)level_size.x * level_size.y * channels * (pixel_type == GL_HALF_FLOAT ? 2 : 1);
+    };
+
+    GLuint array;
+    glGenTextures(1, &array);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+    for (int level = 0; level < levels; level++)
+    {
+        glm::ivec2 level_size = levelSize(level);
+        if (compressed)
+        {
+            glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, internal_format, level_size.x, level_size.y, layers, 0, (GLsizei)(levelBytes(level) * layers), NULL);
+        }
+        else
         {
-            auto& c = cameras[i];
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, level, internal_format, level_size.x, level_size.y, layers, 0, pixel_format, pixel_type, NULL);
+        }
+    }
 
-            c.xy -= mid_xy;
+    const size_t base_bytes = levelBytes(0);
 
-            if (!light_slab)
-            {
-                auto view = glm::lookAt(
-                    glm::vec3(c.xy.x, c.xy.y, 0),
-                    glm::vec3(c.xy.x, c.xy.y, -1),
-                    glm::vec3(0, 1, 0)
-                );
+    // Images are copied through a pixel buffer so that they never leave the GPU
+    GLuint pbo;
+    glGenBuffers(1, &pbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+    glBufferData(GL_PIXEL_PACK_BUFFER, base_bytes, NULL, GL_STREAM_COPY);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    for (GLsizei layer = 0; layer < layers; layer++)
+    {
+        for (int level = 0; level < levels; level++)
+        {
+            glm::ivec2 level_size = levelSize(level);
 
-                auto projection = perspectiveProjection(c.focal_length, c.sensor_width, c.size);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+            glBindTexture(GL_TEXTURE_2D, textures[layer]);
+            if (compressed) glGetCompressedTexImage(GL_TEXTURE_2D, level, 0);
+            else glGetTexImage(GL_TEXTURE_2D, level, pixel_format, pixel_type, 0);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
 
-                c.VP = projection * view;
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+            if (compressed)
+            {
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, level_size.x, level_size.y, 1, internal_format, (GLsizei)levelBytes(level), 0);
             }
+            else
+            {
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, level_size.x, level_size.y, 1, pixel_format, pixel_type, 0);
+            }
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
         }
     }
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glDeleteBuffers(1, &pbo);
+
+    if (mipmaps)
+    {
+        if (compressed) glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        else glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    }
     else
     {
-        throw std::runtime_error("Invalid light field folder, no images were loaded.");
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     }
-}
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-CameraArray::~CameraArray()
-{
-    for (const auto &c : cameras)
+    if (compressed)
     {
-        glDeleteTextures(1, &c.texture);
+        for (int level = 0; level < levels; level++) bytes += levelBytes(level) * layers;
     }
+    else
+    {
+        bytes += mipmaps ? (base_bytes * layers * 4) / 3 : base_bytes * layers;
+    }
+
+    return array;
 }
 
 void CameraArray::bind(size_t index, int eye_loc, int VP_loc, int st_size_loc, int st_distance_loc, float st_width, float st_distance)
 {
     const auto& c = cameras.at(index);
-    glBindTexture(GL_TEXTURE_2D, c.texture);
+    bindTextures(index);
     glUniform2fv(eye_loc, 1, &c.xy[0]);
 
     if (light_slab)
@@ -2,15 +2,59 @@
 
 #include <filesystem>
 #include <vector>
+#include <string>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 
 #include <glm/glm.hpp>
 
 class CameraArray
 {
 public:
-    CameraArray(const std::filesystem::path& path);
+    // How camera images are stored in texture memory
+    enum class Storage
+    {
+        SRGB_SHADER,   // 8-bit sRGB, gamma expanded per sample in the shader
+        SRGB_HARDWARE, // GL_SRGB8(_ALPHA8), gamma expanded by the sampler
+        LINEAR_HALF,   // 16-bit float, gamma expanded once during load
+        BC1,           // S3TC sRGB, 4 bits per pixel without alpha, encoded during load
+        BC7,           // BPTC sRGB with alpha, 8 bits per pixel, encoded during load
+        YCBCR_420      // 8-bit Y and half resolution CbCr textures, converted to RGB and gamma expanded in the shader
+    };
+
+    // Whether the OpenGL context can sample textures of the storage, block compressed formats need extensions
+    static bool supported(Storage storage);
+
+    // A progressive array only loads the coarsest level of the ij grid before the constructor returns, 
+    // every PROGRESSIVE_STRIDE-th camera around the middle camera. Finer levels at half the stride are 
+    // decoded on background threads and added by updateLoading() until all cameras are resident.
+    CameraArray(const std::filesystem::path& path, Storage storage = Storage::SRGB_HARDWARE, bool mipmaps = true, bool progressive = false);
     ~CameraArray();
 
+    // Rescans the folder and only decodes images that changed since they were loaded, 
+    // returns false if all cameras were reused. Cameras still loading progressively are decoded as well.
+    bool reload();
+
+    static constexpr int PROGRESSIVE_STRIDE = 8;
+
+    // Called once per rendered frame on the OpenGL thread, returns true if cameras were added
+    bool updateLoading();
+
+    // Blocks until all cameras of a progressive array are resident, returns true if cameras were added
+    bool finishLoading();
+
+    bool loading() const { return !pending.empty(); }
+
+    // Smallest aperture diameter for which the cameras loaded so far cover the camera plane without
+    // gaps, 0 once all cameras are loaded. The grid is only searched after loading finished.
+    float minimumAperture() const;
+
+    const std::filesystem::path folder;
+
     void bind(size_t index, int eye_loc, int VP_loc, int st_size_loc, int st_distance_loc, float st_width, float st_distance);
 
     struct Camera
@@ -19,8 +63,20 @@ public:
         glm::vec2 xy;
         glm::uvec2 ij;
         int pixel_format;
+        int pixel_type;
+        int internal_format;
         unsigned int texture;
 
+        // CbCr of YCbCr storage at half the resolution of the Y texture, otherwise 0
+        unsigned int chroma_texture = 0;
+
+        // Image file name within the folder
+        std::string file;
+
+        // Single channel linear luminance for autofocus, R16F with mipmaps. Created on first 
+        // use and released whenever the image of the camera changes.
+        unsigned int luminance_texture = 0;
+
         float focal_length;
         float sensor_width;
         glm::mat4 VP;
@@ -28,9 +84,173 @@ public:
 
     bool light_slab;
 
+    const Storage storage;
+
+    // Without mipmaps textures are sampled from the base level only
+    const bool mipmaps;
+
+    // Whether the shaders have to gamma expand texture samples themselves
+    bool shaderGammaExpand() const { return storage == Storage::SRGB_SHADER || storage == Storage::YCBCR_420; }
+
+    // Whether the shaders have to convert YCbCr samples of two textures to RGB
+    bool ycbcr() const { return storage == Storage::YCBCR_420; }
+
+    // Estimated texture memory of all cameras, including any mipmaps
+    size_t texture_bytes = 0;
+
     int findClosestCamera(const glm::vec2 &xy, int exclude_idx = -1);
 
+    // Camera parameters from an image file name, name_i_j_-y_x with extension _focal-length_sensor-width
+    struct FileInfo
+    {
+        glm::uvec2 ij;
+        glm::vec2 xy;
+        bool light_slab;
+        float focal_length = -1.0f;
+        float sensor_width = -1.0f;
+    };
+
+    // False if the file isn't a supported image that follows the naming scheme
+    static bool parseFilename(const std::filesystem::path &file, FileInfo &info);
+
+    // Image decoded and converted to the texture format of the storage, doesn't touch OpenGL state
+    struct Image
+    {
+        glm::ivec2 size;
+        int pixel_format;
+        int pixel_type;
+        int internal_format;
+        std::vector<uint8_t> data;
+
+        // Start of each mipmap level in data for block compressed formats, which can't generate mipmaps
+        std::vector<size_t> levels;
+
+        // Interleaved CbCr of YCbCr storage, where data is the Y plane
+        std::vector<uint8_t> chroma;
+    };
+
+    // Size of the CbCr plane of a YCbCr image, rounded up for odd sizes
+    static glm::ivec2 chromaSize(const glm::ivec2 &size) { return (size + 1) / 2; }
+
+    // Thread safe, the data is empty if the file couldn't be decoded. Block compressed images are
+    // cached in TEXTURE_CACHE_FOLDER next to the file and only encoded again if the file changes,
+    // encoding uses all cores unless threads is set.
+    static Image decode(const std::filesystem::path &file, Storage storage, unsigned threads = 0);
+
+    // Encodes the block compressed textures of all camera images in a folder ahead of loading
+    static void packTextures(const std::filesystem::path &folder, Storage storage);
+
+    static constexpr const char* TEXTURE_CACHE_FOLDER = "texture-cache";
+
+    // Texture with the sampling parameters of the cameras, uninitialized if the image has no data.
+    // YCbCr storage also creates the chroma texture, which is 0 for all other storages.
+    unsigned int createTexture(const Image &image, unsigned int &chroma_texture) const;
+
+    // Replaces the contents of textures created from an image of the same size and format
+    void updateTexture(unsigned int texture, unsigned int chroma_texture, const Image &image) const;
+
+    // Exchanges the textures of each camera with textures[i] and chroma_textures[i], e.g. with the next frame of a video
+    void swapTextures(std::vector<unsigned int> &textures, std::vector<unsigned int> &chroma_textures);
+
+    // Binds the image of a camera to the active texture unit and its chroma texture to unit 1
+    void bindTextures(size_t index) const;
+
+    // Texture memory of a camera, including any mipmaps and luminance texture
+    size_t textureBytes(const Camera &c) const;
+
+    void setLuminanceTexture(size_t index, unsigned int texture);
+
+    // Light slab with one equally sized camera per ij, where xy = origin + step * ij
+    struct Grid
+    {
+        bool regular = false;
+        glm::ivec2 size;
+        glm::vec2 origin;
+        glm::mat2 step;
+
+        // Camera index of each grid cell i + j * size.x
+        std::vector<int> cameras;
+    } grid;
+
+    // Copy of all camera images in grid order as a GL_TEXTURE_2D_ARRAY, created on first use
+    unsigned int gridTextureArray();
+
+    // Matching array of the chroma textures of YCbCr storage, otherwise 0
+    unsigned int gridChromaArray();
+
     glm::vec2 xy_size;
 
     std::vector<Camera> cameras;
+
+private:
+    // Loads the cameras of the folder, reusing the textures of already loaded cameras whose files are unchanged
+    bool load();
+
+    // Moves a camera from file name coordinates into the coordinates of the array
+    void place(Camera &c) const;
+
+    const bool progressive;
+    void findGrid();
+    void releaseLuminanceTexture(Camera &c);
+
+    // Layer per texture of the given size and format, adds the texture memory to bytes
+    unsigned int copyToTextureArray(const std::vector<unsigned int> &textures, const glm::ivec2 &size, int pixel_format, 
+                                    int pixel_type, int internal_format, size_t &bytes) const;
+    void releaseGridTextures();
+
+    // Record of a camera image file, written next to the images to detect changes on the next load
+    struct ManifestEntry
+    {
+        uintmax_t file_size;
+        int64_t mtime;
+        FileInfo info;
+        glm::ivec2 size;
+        uint64_t hash;
+    };
+
+    // Progressive loading, pending cameras are sorted from coarse to fine levels and uploaded in that order
+    struct Pending
+    {
+        std::filesystem::path path;
+        ManifestEntry entry;
+        int stride;
+    };
+    std::vector<Pending> pending;
+    std::vector<Image> pending_images;
+    std::vector<bool> pending_decoded;
+    size_t pending_uploaded = 0;
+
+    std::vector<std::thread> loaders;
+    std::atomic<size_t> next_pending{ 0 };
+    std::atomic<bool> stop_loading{ false };
+    std::mutex loading_mutex;
+
+    // Stride of the finest level that is completely resident
+    int resident_stride = 1;
+
+    // Distance between neighbouring cameras of the ij grid
+    glm::vec2 camera_spacing = glm::vec2(0.0f);
+    glm::vec2 mid_xy = glm::vec2(0.0f);
+
+    // Written once the pending cameras are loaded
+    std::map<std::string, ManifestEntry> loading_manifest;
+    bool loading_manifest_changed = false;
+    std::chrono::steady_clock::time_point loading_start;
+
+    void decodePending();
+    void stopLoading();
+
+    // Uploads decoded pending cameras in order until the budget is used up
+    bool uploadPending(size_t max_bytes);
+
+    static constexpr size_t MAX_UPLOAD_BYTES = 64u << 20;
+
+    std::map<std::string, ManifestEntry> readManifest() const;
+    void writeManifest(const std::map<std::string, ManifestEntry> &manifest) const;
+
+    static constexpr const char* MANIFEST_FILE = "manifest.lfm";
+
+    unsigned int grid_texture_array = 0;
+    unsigned int grid_chroma_array = 0;
+    size_t grid_texture_bytes = 0;
 };
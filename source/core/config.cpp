@@ -80,10 +80,17 @@ void Config::defaults()
 
     registerProperty("template-size", &template_size, Property(64.0f, 16.0f, 128.0f));
     registerProperty("search-scale", &search_scale, Property(2.0f, 1.5f, 4.0f));
+    registerProperty("autofocus-rate", &autofocus_rate, Property(15.0f, 1.0f, 60.0f));
 
     registerProperty("width", &width, Property(512.0f, 256.0f, 16384.0f));
     registerProperty("height", &height, Property(512.0f, 256.0f, 16384.0f));
     registerProperty("exposure", &exposure, Property(0.0f, -1.0f, 1.0f));
+    registerProperty("target-frame-rate", &target_frame_rate, Property(60.0f, 10.0f, 144.0f));
+    registerProperty("stereo-base", &stereo_base, Property(0.065f, 0.0f, 0.5f));
+    registerProperty("video-frame-rate", &video_frame_rate, Property(30.0f, 1.0f, 120.0f));
+    registerProperty("focal-stack-slices", &focal_stack_slices, Property(16.0f, 4.0f, 64.0f));
+    registerProperty("output-width", &output_width, Property(4096.0f, 256.0f, 65535.0f));
+    registerProperty("output-height", &output_height, Property(4096.0f, 256.0f, 65535.0f));
 
     registerProperty("pitch", &pitch, Property(0.0f, -89.9f, 89.9f, glm::radians(1.0f)));
     registerProperty("yaw", &yaw, Property(0.0f, -89.9f, 89.9f, glm::radians(1.0f)));
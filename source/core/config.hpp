@@ -33,6 +33,8 @@ public:
         void operator-=(const float &v) { *this = value - v; }
 
         float getRange() { return range; }
+        float getMin() { return min; }
+        float getMax() { return max; }
         float getNormalized() { return (value - min) / range; }
         float getDisplay() { return value / scale; }
         float getScale() { return scale; }
@@ -83,9 +85,26 @@ public:
     Property template_size;
     Property search_scale;
 
+    // Measurements per second of continuous autofocus, independent of the frame rate
+    Property autofocus_rate;
+
     Property width;
     Property height;
     Property exposure;
+    Property target_frame_rate;
+
+    // Distance between the eyes of the stereo preview
+    Property stereo_base;
+
+    // Playback rate of light field videos
+    Property video_frame_rate;
+
+    // Focus distances of the focal stack, spanning the focus distance range
+    Property focal_stack_slices;
+
+    // Size of tiled offline renders
+    Property output_width;
+    Property output_height;
 
     std::string folder;
 };
\ No newline at end of file
@@ -0,0 +1,439 @@
+#include "coordinator.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <functional>
+#include <algorithm>
+#include <map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstring>
+#include <cctype>
+
+#include <glm/glm.hpp>
+
+#include "http.hpp"
+#include "image-writer.hpp"
+#include "util.hpp"
+
+namespace
+{
+    struct Job
+    {
+        glm::ivec2 size = glm::ivec2(0);
+        std::string frames = "frames/%04d.png";
+        std::string tiled;
+        std::vector<std::map<std::string, std::string>> views;
+    };
+
+    // Range [first, last) of work items
+    struct Task
+    {
+        size_t first, last;
+        int attempts = 0;
+    };
+
+    struct Worker
+    {
+        WorkerAddress address;
+        bool alive = true;
+    };
+
+    constexpr int TILE_SIZE = 1024;
+
+    // Two requests in flight let a worker batch one while the other is being transferred
+    constexpr int CONNECTIONS_PER_WORKER = 2;
+
+    // Frames are split into about this many ranges per connection to balance the load
+    constexpr size_t TASKS_PER_CONNECTION = 4;
+
+    // Items that fail on a live worker, e.g. with an invalid view, are given up after this
+    constexpr int MAX_ATTEMPTS = 3;
+
+    // Workers may still be loading the light field when the coordinator starts
+    constexpr auto STARTUP_TIMEOUT = std::chrono::seconds(60);
+
+    // Substitutes the frame number for the one %d, %Nd or %0Nd conversion of the pattern, %% is a percent sign.
+    // The pattern isn't passed to printf so that other conversions can't read arguments that don't exist.
+    std::string frameFilename(const std::string &pattern, size_t frame)
+    {
+        std::string result;
+        int conversions = 0;
+        for (size_t i = 0; i < pattern.size(); i++)
+        {
+            if (pattern[i] != '%')
+            {
+                result += pattern[i];
+                continue;
+            }
+            if (i + 1 < pattern.size() && pattern[i + 1] == '%')
+            {
+                result += '%';
+                i++;
+                continue;
+            }
+
+            size_t end = i + 1;
+            char fill = end < pattern.size() && pattern[end] == '0' ? '0' : ' ';
+            if (fill == '0') end++;
+
+            size_t width = 0;
+            for (; end < pattern.size() && std::isdigit((unsigned char)pattern[end]) && width < 100; end++)
+            {
+                width = width * 10 + (pattern[end] - '0');
+            }
+            if (end >= pattern.size() || pattern[end] != 'd' || width >= 100)
+            {
+                throw std::runtime_error("Frame pattern " + pattern + " may only contain %d, %Nd or %0Nd");
+            }
+
+            std::string number = std::to_string(frame);
+            if (number.size() < width) result += std::string(width - number.size(), fill);
+            result += number;
+
+            conversions++;
+            i = end;
+        }
+
+        if (conversions != 1) throw std::runtime_error("Frame pattern " + pattern + " must contain exactly one frame number");
+        return result;
+    }
+
+    Job parseJob(const std::string &filename)
+    {
+        std::ifstream file(filename);
+        if (!file) throw std::runtime_error("Unable to open job file " + filename);
+
+        const char* view_keys[] = { "x", "y", "z", "tx", "ty", "tz", "focus", "fstop" };
+
+        Job job;
+        std::string line;
+        for (int line_number = 1; std::getline(file, line); line_number++)
+        {
+            line = line.substr(0, line.find('#'));
+            std::istringstream in(line);
+
+            auto fail = [&](const std::string &message)
+            {
+                throw std::runtime_error(filename + ":" + std::to_string(line_number) + ": " + message);
+            };
+
+            std::string statement;
+            if (!(in >> statement)) continue;
+
+            if (statement == "size")
+            {
+                if (!(in >> job.size.x >> job.size.y) || job.size.x < 1 || job.size.y < 1) fail("Invalid size");
+            }
+            else if (statement == "frames")
+            {
+                if (!(in >> job.frames) || !LinearImageWriter::supported(job.frames)) fail("Frames must be png, ppm or pfm");
+                try
+                {
+                    frameFilename(job.frames, 0);
+                }
+                catch (const std::exception &e)
+                {
+                    fail(e.what());
+                }
+            }
+            else if (statement == "tiled")
+            {
+                if (!(in >> job.tiled)) fail("Missing file name");
+            }
+            else if (statement == "view")
+            {
+                auto &view = job.views.emplace_back();
+                std::string value;
+                for (int i = 0; i < 8 && in >> value; i++)
+                {
+                    view[view_keys[i]] = value;
+                }
+            }
+            else if (statement == "animation")
+            {
+                int count;
+                if (!(in >> count) || count < 1) fail("Invalid frame count");
+                for (int i = 0; i < count; i++)
+                {
+                    job.views.push_back({ { "animation", std::to_string((double)i / count) } });
+                }
+            }
+            else
+            {
+                fail("Unknown statement " + statement);
+            }
+        }
+
+        if (job.size.x < 1) throw std::runtime_error(filename + ": Missing size");
+        if (job.views.empty()) throw std::runtime_error(filename + ": No views or animation");
+
+        return job;
+    }
+
+    // Linear image from a PFM encoded by the render server, rows from the bottom
+    std::vector<glm::vec3> decodePFM(const std::string &data, const glm::ivec2 &size)
+    {
+        std::istringstream in(data);
+        std::string magic;
+        glm::ivec2 data_size;
+        float scale;
+        in >> magic >> data_size.x >> data_size.y >> scale;
+        in.get();
+
+        const uint16_t probe = 1;
+        bool little_endian = *reinterpret_cast<const uint8_t*>(&probe) == 1;
+
+        size_t offset = (size_t)in.tellg();
+        size_t bytes = (size_t)size.x * size.y * sizeof(glm::vec3);
+        if (!in || magic != "PF" || data_size != size || (scale < 0.0f) != little_endian || data.size() < offset + bytes)
+        {
+            throw std::runtime_error("Invalid tile from worker");
+        }
+
+        std::vector<glm::vec3> image((size_t)size.x * size.y);
+        std::memcpy(image.data(), data.data() + offset, bytes);
+        return image;
+    }
+}
+
+int coordinate(const std::string &job_file, const std::vector<WorkerAddress> &addresses)
+{
+    using clock = std::chrono::steady_clock;
+
+    if (addresses.empty()) throw std::runtime_error("No workers");
+
+    Job job = parseJob(job_file);
+
+    // Each work item is one request, its response is stored by the sink from the connection threads
+    std::vector<std::string> targets;
+    std::function<void(size_t, const std::string&)> sink;
+
+    std::unique_ptr<TGAWriter> tga;
+    std::mutex tga_mutex;
+    std::vector<std::pair<glm::ivec2, glm::ivec2>> tiles;
+
+    if (!job.tiled.empty())
+    {
+        tga = std::make_unique<TGAWriter>(job.tiled, job.size);
+
+        const glm::ivec2 num_tiles = (job.size + TILE_SIZE - 1) / TILE_SIZE;
+        for (int y = 0; y < num_tiles.y; y++)
+        {
+            for (int x = 0; x < num_tiles.x; x++)
+            {
+                glm::ivec2 offset = glm::ivec2(x, y) * TILE_SIZE;
+                glm::ivec2 region = glm::min(job.size - offset, glm::ivec2(TILE_SIZE));
+                tiles.emplace_back(offset, region);
+
+                auto query = job.views.front();
+                query["width"] = std::to_string(region.x);
+                query["height"] = std::to_string(region.y);
+                query["frame_width"] = std::to_string(job.size.x);
+                query["frame_height"] = std::to_string(job.size.y);
+                query["tile_x"] = std::to_string(offset.x);
+                query["tile_y"] = std::to_string(offset.y);
+                query["format"] = "pfm";
+                targets.push_back("/render?" + http::encodeQuery(query));
+            }
+        }
+
+        sink = [&](size_t i, const std::string &body)
+        {
+            const auto &[offset, region] = tiles[i];
+            auto image = decodePFM(body, region);
+
+            std::vector<glm::u8vec3> bgr(image.size());
+            for (size_t p = 0; p < image.size(); p++)
+            {
+                glm::vec3 c = glm::clamp(image[p], 0.0f, 1.0f);
+                c = glm::vec3(srgbGammaCompress(c.r), srgbGammaCompress(c.g), srgbGammaCompress(c.b)) * 255.0f + 0.5f;
+                bgr[p] = glm::u8vec3(c.b, c.g, c.r);
+            }
+
+            std::lock_guard<std::mutex> lock(tga_mutex);
+            tga->write(offset, region, bgr);
+        };
+    }
+    else
+    {
+        std::string format = job.frames.substr(job.frames.find_last_of('.') + 1);
+        for (auto query : job.views)
+        {
+            query["width"] = std::to_string(job.size.x);
+            query["height"] = std::to_string(job.size.y);
+            query["format"] = format;
+            targets.push_back("/render?" + http::encodeQuery(query));
+        }
+
+        sink = [&](size_t i, const std::string &body)
+        {
+            std::string filename = frameFilename(job.frames, i);
+            std::ofstream file(filename, std::ios::binary);
+            if (!file.write(body.data(), body.size())) throw std::runtime_error("Unable to write " + filename);
+        };
+    }
+
+    std::vector<Worker> workers(addresses.size());
+    for (size_t w = 0; w < addresses.size(); w++) workers[w].address = addresses[w];
+
+    size_t connections = workers.size() * CONNECTIONS_PER_WORKER;
+    size_t task_size = tga ? 1 : std::max((size_t)1, targets.size() / (connections * TASKS_PER_CONNECTION));
+
+    std::deque<Task> tasks;
+    for (size_t first = 0; first < targets.size(); first += task_size)
+    {
+        tasks.push_back({ first, std::min(first + task_size, targets.size()) });
+    }
+
+    size_t remaining = targets.size(), completed = 0, failed = 0;
+    size_t alive_workers = workers.size();
+    std::mutex mutex;
+    std::condition_variable condition;
+
+    auto workerLost = [&](Worker &worker, const std::string &reason)
+    {
+        if (!worker.alive) return;
+        worker.alive = false;
+        alive_workers--;
+        std::cout << "\nWorker " << worker.address.host << ":" << worker.address.port << " lost, " << reason << std::endl;
+    };
+
+    auto connection = [&](Worker &worker)
+    {
+        while (true)
+        {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [&] { return !tasks.empty() || remaining == 0 || !worker.alive; });
+                if (remaining == 0 || !worker.alive) return;
+
+                task = tasks.front();
+                tasks.pop_front();
+            }
+
+            for (size_t i = task.first; i < task.last; i++)
+            {
+                http::Response response;
+                try
+                {
+                    response = http::get(worker.address.host, worker.address.port, targets[i]);
+                }
+                catch (const std::exception &ex)
+                {
+                    // The rest of the task goes to the remaining workers
+                    std::lock_guard<std::mutex> lock(mutex);
+                    tasks.push_front({ i, task.last, task.attempts });
+                    workerLost(worker, ex.what());
+                    condition.notify_all();
+                    return;
+                }
+
+                std::string error;
+                if (response.status != 200)
+                {
+                    error = "HTTP " + std::to_string(response.status) + " " + response.body;
+                }
+                else
+                {
+                    try
+                    {
+                        sink(i, response.body);
+                    }
+                    catch (const std::exception &ex)
+                    {
+                        error = ex.what();
+                    }
+                }
+
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error.empty())
+                {
+                    if (++task.attempts < MAX_ATTEMPTS)
+                    {
+                        tasks.push_back({ i, task.last, task.attempts });
+                    }
+                    else
+                    {
+                        std::cout << "\nGiving up on items " << i << " to " << task.last - 1 << ": " << error << std::endl;
+                        failed += task.last - i;
+                        remaining -= task.last - i;
+                    }
+                    condition.notify_all();
+                    break;
+                }
+
+                completed++;
+                remaining--;
+                std::cout << "\r" << (tga ? "Tile " : "Frame ") << completed << "/" << targets.size() << std::flush;
+                if (remaining == 0) condition.notify_all();
+            }
+        }
+    };
+
+    auto start = clock::now();
+
+    std::vector<std::thread> threads;
+    for (auto &worker : workers)
+    {
+        threads.emplace_back([&]
+        {
+            // Waits for the worker to come up before handing it work
+            auto deadline = clock::now() + STARTUP_TIMEOUT;
+            while (true)
+            {
+                try
+                {
+                    if (http::get(worker.address.host, worker.address.port, "/view").status == 200) break;
+                }
+                catch (const std::exception &) {}
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (remaining == 0) return;
+                    if (clock::now() > deadline)
+                    {
+                        workerLost(worker, "not responding");
+                        condition.notify_all();
+                        return;
+                    }
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            }
+
+            std::vector<std::thread> extra;
+            for (int c = 1; c < CONNECTIONS_PER_WORKER; c++)
+            {
+                extra.emplace_back([&] { connection(worker); });
+            }
+            connection(worker);
+            for (auto &t : extra) t.join();
+        });
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [&] { return remaining == 0 || alive_workers == 0; });
+    }
+
+    for (auto &t : threads) t.join();
+
+    double seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+    if (remaining > 0)
+    {
+        std::cout << "\nAll workers lost, " << remaining << " of " << targets.size() << " items not rendered" << std::endl;
+        return 1;
+    }
+
+    std::cout << "\nRendered " << completed << " of " << targets.size() << (tga ? " tiles" : " frames")
+              << " on " << alive_workers << " of " << workers.size() << " workers in " << seconds << " s" << std::endl;
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/*************************************************************************
+Distributes a render job over render servers, e.g. several processes
+started with --server on one machine, each with its own hidden context.
+Frames of an animation are split into ranges that are handed out to the
+workers and written as separate images. A single large frame is split
+into tiles that are assembled into one TGA file. Work held by a worker
+that stops responding is requeued for the remaining workers.
+
+Job file, one statement per line, # starts a comment:
+  size <width> <height>     Size of each frame
+  frames <pattern>          Output files, pattern with one %d, %Nd or %0Nd
+                            for the frame number such as frames/%04d.png
+                            (png, ppm, pfm)
+  view [x y z tx ty tz focus f-stop]
+                            Appends a frame, omitted values are taken from
+                            the light field configuration of the workers
+  animation <count>         Appends count frames of one animation cycle
+  tiled <file.tga>          Renders the first frame in tiles instead
+*************************************************************************/
+struct WorkerAddress
+{
+    std::string host;
+    uint16_t port;
+};
+
+// Returns non-zero if any part of the job could not be rendered
+int coordinate(const std::string &job_file, const std::vector<WorkerAddress> &workers);
@@ -0,0 +1,140 @@
+#include "fft.hpp"
+
+#include <cmath>
+
+FFT::FFT(size_t n, bool inverse) : n(n), inverse(inverse)
+{
+    const double pi = 3.14159265358979323846;
+
+    twiddles.resize(n);
+    for (size_t k = 0; k < n; k++)
+    {
+        double phase = (inverse ? 2.0 : -2.0) * pi * k / n;
+        twiddles[k] = Complex((float)std::cos(phase), (float)std::sin(phase));
+    }
+
+    // Radix 4 first, then 2, then odd factors in increasing order
+    size_t remaining = n, p = 4;
+    const size_t floor_sqrt = (size_t)std::floor(std::sqrt((double)n));
+    while (remaining > 1)
+    {
+        while (remaining % p)
+        {
+            p = p == 4 ? 2 : p == 2 ? 3 : p + 2;
+            if (p > floor_sqrt) p = remaining;
+        }
+        remaining /= p;
+        factors.push_back(p);
+        factors.push_back(remaining);
+    }
+}
+
+void FFT::transform(Complex* data, size_t stride) const
+{
+    if (n < 2) return;
+
+    thread_local std::vector<Complex> out;
+    out.resize(n);
+
+    work(out.data(), data, 1, stride, factors.data());
+
+    for (size_t i = 0; i < n; i++) data[i * stride] = out[i];
+}
+
+size_t FFT::fastSize(size_t n)
+{
+    for (;; n++)
+    {
+        size_t m = n;
+        for (size_t p : { 2, 3, 5 })
+        {
+            while (m % p == 0) m /= p;
+        }
+        if (m <= 1) return n;
+    }
+}
+
+void FFT::work(Complex* out, const Complex* in, size_t fstride, size_t in_stride, const size_t* factors) const
+{
+    const size_t p = factors[0];
+    const size_t m = factors[1];
+
+    if (m == 1)
+    {
+        for (size_t j = 0; j < p; j++) out[j] = in[j * fstride * in_stride];
+    }
+    else
+    {
+        // Each of the p interleaved subsequences is transformed into a contiguous block of m
+        for (size_t j = 0; j < p; j++)
+        {
+            work(out + j * m, in + j * fstride * in_stride, fstride * p, in_stride, factors + 2);
+        }
+    }
+
+    switch (p)
+    {
+        case 2:  butterfly2(out, fstride, m); break;
+        case 4:  butterfly4(out, fstride, m); break;
+        default: butterflyGeneric(out, fstride, p, m); break;
+    }
+}
+
+void FFT::butterfly2(Complex* out, size_t fstride, size_t m) const
+{
+    Complex* out2 = out + m;
+    for (size_t k = 0; k < m; k++)
+    {
+        Complex t = out2[k] * twiddles[k * fstride];
+        out2[k] = out[k] - t;
+        out[k] += t;
+    }
+}
+
+void FFT::butterfly4(Complex* out, size_t fstride, size_t m) const
+{
+    for (size_t k = 0; k < m; k++)
+    {
+        Complex s0 = out[k + m] * twiddles[k * fstride];
+        Complex s1 = out[k + 2 * m] * twiddles[2 * k * fstride];
+        Complex s2 = out[k + 3 * m] * twiddles[3 * k * fstride];
+
+        Complex s5 = out[k] - s1;
+        out[k] += s1;
+        Complex s3 = s0 + s2;
+        Complex s4 = s0 - s2;
+
+        out[k + 2 * m] = out[k] - s3;
+        out[k] += s3;
+
+        // Multiplication of s4 by -i for the forward and i for the inverse transform
+        Complex rotated = inverse ? Complex(-s4.imag(), s4.real()) : Complex(s4.imag(), -s4.real());
+        out[k + m] = s5 + rotated;
+        out[k + 3 * m] = s5 - rotated;
+    }
+}
+
+void FFT::butterflyGeneric(Complex* out, size_t fstride, size_t p, size_t m) const
+{
+    std::vector<Complex> scratch(p);
+
+    for (size_t u = 0; u < m; u++)
+    {
+        for (size_t q = 0; q < p; q++) scratch[q] = out[u + q * m];
+
+        for (size_t q1 = 0; q1 < p; q1++)
+        {
+            size_t k = u + q1 * m;
+            size_t twiddle = 0;
+
+            Complex sum = scratch[0];
+            for (size_t q = 1; q < p; q++)
+            {
+                twiddle += fstride * k;
+                if (twiddle >= n) twiddle %= n;
+                sum += scratch[q] * twiddles[twiddle];
+            }
+            out[k] = sum;
+        }
+    }
+}
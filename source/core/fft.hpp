@@ -0,0 +1,42 @@
+#pragma once
+
+#include <complex>
+#include <vector>
+#include <cstddef>
+
+/*************************************************************************
+Mixed-radix FFT of any length, recursive Cooley-Tukey decimation in time
+with radix 4 and 2 butterflies and a generic butterfly for odd factors.
+A plan holds the factors and twiddles of one length and direction and can
+be shared by threads. Transforms are unnormalized, an inverse after a
+forward transform scales by n.
+*************************************************************************/
+class FFT
+{
+public:
+    using Complex = std::complex<float>;
+
+    FFT(size_t n, bool inverse = false);
+
+    // Transforms n values spaced stride apart in place
+    void transform(Complex* data, size_t stride = 1) const;
+
+    // Smallest length of at least n without prime factors above 5
+    static size_t fastSize(size_t n);
+
+    const size_t n;
+    const bool inverse;
+
+private:
+    void work(Complex* out, const Complex* in, size_t fstride, size_t in_stride, const size_t* factors) const;
+
+    void butterfly2(Complex* out, size_t fstride, size_t m) const;
+    void butterfly4(Complex* out, size_t fstride, size_t m) const;
+    void butterflyGeneric(Complex* out, size_t fstride, size_t p, size_t m) const;
+
+    // Pairs of radix and remaining length
+    std::vector<size_t> factors;
+
+    // exp(-+2 pi i k / n)
+    std::vector<Complex> twiddles;
+};
@@ -0,0 +1,205 @@
+#include "focal-stack.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <nanogui/opengl.h>
+
+#include "light-field-renderer.hpp"
+#include "config.hpp"
+#include "../gl-util/layered-fbo.hpp"
+
+FocalStack::FocalStack(const glm::ivec2 &size, int slices, float min_distance, float max_distance)
+    : size(size), slices(slices), min_distance(min_distance), max_distance(max_distance)
+{
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA16F, size.x, size.y, slices, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    glGenFramebuffers(1, &handle);
+    glBindFramebuffer(GL_FRAMEBUFFER, handle);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture, 0, 0);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        throw std::runtime_error("Focal stack framebuffer not complete.");
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+FocalStack::~FocalStack()
+{
+    glDeleteTextures(1, &texture);
+    glDeleteFramebuffers(1, &handle);
+}
+
+float FocalStack::distance(int slice) const
+{
+    float t = slices > 1 ? slice / (float)(slices - 1) : 0.0f;
+    return 1.0f / glm::mix(1.0f / min_distance, 1.0f / max_distance, t);
+}
+
+float FocalStack::slice(float distance) const
+{
+    float t = (1.0f / min_distance - 1.0f / distance) / (1.0f / min_distance - 1.0f / max_distance);
+    return glm::clamp(t, 0.0f, 1.0f) * (slices - 1);
+}
+
+void FocalStack::bindSlice(int slice)
+{
+    glGetIntegerv(GL_VIEWPORT, prev_viewport);
+    glViewport(0, 0, size.x, size.y);
+
+    glGetIntegerv(GL_SCISSOR_BOX, prev_scissor);
+    glScissor(0, 0, size.x, size.y);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, handle);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture, 0, slice);
+}
+
+void FocalStack::unBind()
+{
+    glViewport(prev_viewport[0], prev_viewport[1], prev_viewport[2], prev_viewport[3]);
+    glScissor(prev_scissor[0], prev_scissor[1], prev_scissor[2], prev_scissor[3]);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void FocalStack::bindTexture()
+{
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+}
+
+std::array<float, 16> LightFieldRenderer::focalStackKey() const
+{
+    return {
+        eye.x, eye.y, eye.z, forward.x, forward.y, forward.z,
+        cfg->f_stop, cfg->focal_length, cfg->sensor_width,
+        cfg->aperture_falloff, cfg->st_width, cfg->st_distance,
+        (float)fb_size.x, (float)fb_size.y, (float)normalize_aperture, (float)focus_breathing
+    };
+}
+
+bool LightFieldRenderer::updateFocalStack()
+{
+    const int slices = (int)std::round(cfg->focal_stack_slices);
+    const float min_distance = cfg->focus_distance.getMin();
+    const float max_distance = cfg->focus_distance.getMax();
+
+    if (!focal_stack || focal_stack->size != fb_size || focal_stack->slices != slices ||
+        focal_stack->min_distance != min_distance || focal_stack->max_distance != max_distance)
+    {
+        focal_stack = std::make_unique<FocalStack>(fb_size, slices, min_distance, max_distance);
+    }
+    if (!focal_stack_fbo || focal_stack_fbo->size != fb_size)
+    {
+        focal_stack_fbo = std::make_unique<LayeredFBO>(fb_size, FOCAL_STACK_BATCH);
+    }
+
+    // Any change but the focus distance starts over, a moving view is rendered normally
+    auto key = focalStackKey();
+    if (key != focal_stack->key)
+    {
+        focal_stack->key = key;
+        focal_stack->restart();
+        return false;
+    }
+
+    if (focal_stack->complete()) return true;
+
+    const int first = focal_stack->rendered;
+    std::vector<float> max_weight_sums(FOCAL_STACK_BATCH, 0.0f);
+
+    if (!focal_stack->pending)
+    {
+        const int count = std::min(FOCAL_STACK_BATCH, focal_stack->slices - first);
+
+        std::vector<ViewBlock> blocks;
+        for (int i = 0; i < count; i++)
+        {
+            View view{ eye, eye + forward, focal_stack->distance(first + i), cfg->f_stop };
+            blocks.push_back(viewBlock(view, fb_size));
+        }
+
+        accumulateViews(blocks, *focal_stack_fbo, fb_size);
+        focal_stack_fbo->unBind();
+        focal_stack->pending = count;
+
+        if (!normalize_aperture)
+        {
+            // Resolved in a later frame once the readbacks have finished
+            for (int i = 0; i < count; i++) focal_stack_fbo->read(i, focal_stack_readbacks[i]);
+            return false;
+        }
+    }
+    else
+    {
+        for (int i = 0; i < focal_stack->pending; i++)
+        {
+            if (!focal_stack_readbacks[i].available()) return false;
+        }
+
+        // Alpha of the RGBA readback
+        for (int i = 0; i < focal_stack->pending; i++)
+        {
+            focal_stack_readbacks[i].get(focal_stack_weights);
+            for (size_t p = 3; p < focal_stack_weights.size(); p += 4)
+            {
+                max_weight_sums[i] = std::max(max_weight_sums[i], focal_stack_weights[p]);
+            }
+        }
+    }
+
+    const int count = focal_stack->pending;
+
+    // Normalized into the half float slices
+    glDisable(GL_BLEND);
+    focal_stack_fbo->bindTexture();
+
+    Shader* resolve_shader = focal_stack_resolve_shaders[normalize_aperture];
+    resolve_shader->use();
+
+    quad.bind();
+
+    glm::vec2 texcoord_scale(1.0f);
+    glUniform2fv(resolve_shader->getLocation("texcoord_scale"), 1, &texcoord_scale[0]);
+
+    for (int i = 0; i < count; i++)
+    {
+        focal_stack->bindSlice(first + i);
+        glUniform1i(resolve_shader->getLocation("layer"), i);
+        glUniform1f(resolve_shader->getLocation("max_weight_sum"), max_weight_sums[i]);
+        quad.draw();
+        focal_stack->unBind();
+    }
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    focal_stack->rendered += count;
+    focal_stack->pending = 0;
+
+    return focal_stack->complete();
+}
+
+void LightFieldRenderer::drawFocalStack()
+{
+    focal_stack->bindTexture();
+    focal_stack_shader->use();
+
+    quad.bind();
+
+    glUniform1f(focal_stack_shader->getLocation("slice"), focal_stack->slice(cfg->focus_distance));
+    glUniform1f(focal_stack_shader->getLocation("exposure"), std::pow(2, cfg->exposure));
+
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    quad.draw();
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <array>
+
+/*************************************************************************
+Focal stack of a fixed view, rendered at focus distances spaced evenly in
+inverse distance between the limits of the focus distance, so that the
+depth of field of neighbouring slices overlaps about as much everywhere.
+Slices are stored in an RGBA16F texture array as normalized linear color,
+exposure is applied when the stack is drawn.
+*************************************************************************/
+class FocalStack
+{
+public:
+    FocalStack(const glm::ivec2 &size, int slices, float min_distance, float max_distance);
+    ~FocalStack();
+
+    float distance(int slice) const;
+
+    // Fractional slice of a focus distance, clamped to the stack
+    float slice(float distance) const;
+
+    // Binds a framebuffer with a single slice attached
+    void bindSlice(int slice);
+
+    void unBind();
+
+    // Binds the texture array to GL_TEXTURE_2D_ARRAY
+    void bindTexture();
+
+    bool complete() const { return rendered == slices; }
+
+    // Discards the rendered slices and any in flight
+    void restart() { rendered = pending = 0; }
+
+    unsigned int handle, texture;
+    const glm::ivec2 size;
+    const int slices;
+    const float min_distance, max_distance;
+
+    // Slices [0, rendered) are valid for key
+    int rendered = 0;
+
+    // Slices [rendered, rendered + pending) are accumulated and wait for their weight sums to be read back
+    int pending = 0;
+
+    // View and settings that the slices were rendered with
+    std::array<float, 16> key{};
+
+    int prev_viewport[4] = { 0 };
+    int prev_scissor[4] = { 0 };
+};
@@ -0,0 +1,266 @@
+#include "fourier-refocus.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+
+#include "camera-array.hpp"
+#include "fft.hpp"
+#include "util.hpp"
+
+namespace
+{
+    const float PI = 3.14159265358979f;
+
+    // Keys cubic convolution kernel
+    float cubic(float t)
+    {
+        const float a = -0.5f;
+        t = std::abs(t);
+        if (t <= 1.0f) return ((a + 2.0f) * t - (a + 3.0f)) * t * t + 1.0f;
+        if (t < 2.0f) return ((a * t - 5.0f * a) * t + 8.0f * a) * t - 4.0f * a;
+        return 0.0f;
+    }
+
+    // Box filtered linear RGB image at most width pixels wide
+    std::vector<glm::vec3> loadView(const CameraArray::Image &image, const glm::ivec2 &size)
+    {
+        const int channels = (int)(image.data.size() / ((size_t)image.size.x * image.size.y));
+        const glm::vec2 scale = glm::vec2(image.size) / glm::vec2(size);
+
+        float lut[256];
+        for (int i = 0; i < 256; i++) lut[i] = srgbGammaExpand(i / 255.0f);
+
+        std::vector<glm::vec3> view((size_t)size.x * size.y);
+        for (int y = 0; y < size.y; y++)
+        {
+            int y0 = (int)(y * scale.y), y1 = std::max(y0 + 1, (int)((y + 1) * scale.y));
+            for (int x = 0; x < size.x; x++)
+            {
+                int x0 = (int)(x * scale.x), x1 = std::max(x0 + 1, (int)((x + 1) * scale.x));
+
+                glm::vec3 sum(0.0f);
+                for (int sy = y0; sy < y1; sy++)
+                {
+                    const uint8_t* row = image.data.data() + ((size_t)sy * image.size.x) * channels;
+                    for (int sx = x0; sx < x1; sx++)
+                    {
+                        const uint8_t* p = row + (size_t)sx * channels;
+                        sum += channels >= 3 ? glm::vec3(lut[p[0]], lut[p[1]], lut[p[2]]) : glm::vec3(lut[p[0]]);
+                    }
+                }
+                view[(size_t)y * size.x + x] = sum / (float)((y1 - y0) * (x1 - x0));
+            }
+        }
+        return view;
+    }
+}
+
+FourierRefocus::FourierRefocus(const CameraArray &camera_array, float st_width, float st_distance, int resolution)
+    : st_distance(st_distance)
+{
+    const auto &grid = camera_array.grid;
+    if (!camera_array.light_slab || !grid.regular)
+    {
+        throw std::runtime_error("Fourier slice refocusing needs a regular light slab grid");
+    }
+
+    const glm::ivec2 image_size = camera_array.cameras[grid.cameras[0]].size;
+    size.x = std::min(resolution, image_size.x);
+    size.y = std::max(1, (int)std::round(size.x * image_size.y / (float)image_size.x));
+    grid_size = grid.size;
+
+    // Pixels per unit on the st plane, which is st_width wide
+    pixel_step = grid.step * (size.x / st_width);
+
+    std::vector<std::vector<glm::vec3>> views(grid.cameras.size());
+    parallelFor(views.size(), [&](size_t cell)
+    {
+        const auto &c = camera_array.cameras[grid.cameras[cell]];
+        auto image = CameraArray::decode(camera_array.folder / c.file, CameraArray::Storage::SRGB_SHADER);
+        if (image.data.empty() || image.size != image_size)
+        {
+            throw std::runtime_error("Unable to load " + c.file + " for Fourier slice refocusing");
+        }
+        views[cell] = loadView(image, size);
+    });
+
+    build(views);
+}
+
+FourierRefocus::FourierRefocus(const std::vector<std::vector<glm::vec3>> &views, const glm::ivec2 &size,
+                               const glm::ivec2 &grid_size, const glm::mat2 &pixel_step, float st_distance)
+    : size(size), grid_size(grid_size), pixel_step(pixel_step), st_distance(st_distance)
+{
+    if (views.size() != (size_t)grid_size.x * grid_size.y) throw std::runtime_error("One view per grid cell required");
+    build(views);
+}
+
+void FourierRefocus::build(const std::vector<std::vector<glm::vec3>> &views)
+{
+    half_width = size.x / 2 + 1;
+    padded.x = (int)FFT::fastSize(grid_size.x * 2);
+    padded.y = (int)FFT::fastSize(grid_size.y * 2);
+
+    const size_t half_pixels = (size_t)half_width * size.y;
+
+    // 2D spectrum of each view and channel, only the columns that are kept are transformed
+    const FFT rows(size.x), columns(size.y);
+
+    std::vector<std::vector<Complex>> view_spectra(views.size());
+    parallelFor(views.size(), [&](size_t v)
+    {
+        auto &s = view_spectra[v];
+        s.resize(half_pixels * 3);
+
+        std::vector<Complex> row(size.x), column(size.y);
+        std::vector<Complex> transformed((size_t)size.x * size.y);
+
+        for (int c = 0; c < 3; c++)
+        {
+            for (int y = 0; y < size.y; y++)
+            {
+                for (int x = 0; x < size.x; x++) row[x] = views[v][(size_t)y * size.x + x][c];
+                rows.transform(row.data());
+                std::copy(row.begin(), row.begin() + half_width, transformed.begin() + (size_t)y * half_width);
+            }
+            for (int kx = 0; kx < half_width; kx++)
+            {
+                columns.transform(transformed.data() + kx, half_width);
+            }
+            for (size_t i = 0; i < half_pixels; i++) s[i * 3 + c] = transformed[i];
+        }
+    });
+
+    // Angular transform over the views at every spatial frequency. Views are placed around index 0 
+    // of the padded transform, where the cubic interpolation attenuates them the least.
+    const glm::ivec2 half_grid = grid_size / 2;
+    const size_t angular = (size_t)padded.x * padded.y;
+
+    const FFT u_fft(padded.x), v_fft(padded.y);
+
+    spectrum.assign(half_pixels * angular * 3, Complex(0.0f));
+    parallelFor((size_t)size.y, [&](size_t ky)
+    {
+        std::vector<Complex> block(angular);
+
+        for (int kx = 0; kx < half_width; kx++)
+        {
+            size_t k = ky * half_width + kx;
+            for (int c = 0; c < 3; c++)
+            {
+                std::fill(block.begin(), block.end(), Complex(0.0f));
+                for (int j = 0; j < grid_size.y; j++)
+                {
+                    for (int i = 0; i < grid_size.x; i++)
+                    {
+                        int mu = (i - half_grid.x + padded.x) % padded.x;
+                        int mv = (j - half_grid.y + padded.y) % padded.y;
+                        block[(size_t)mv * padded.x + mu] = view_spectra[(size_t)j * grid_size.x + i][k * 3 + c];
+                    }
+                }
+
+                for (int mv = 0; mv < padded.y; mv++) u_fft.transform(block.data() + (size_t)mv * padded.x);
+                for (int mu = 0; mu < padded.x; mu++) v_fft.transform(block.data() + mu, padded.x);
+
+                Complex* out = spectrum.data() + k * angular * 3 + c;
+                for (size_t m = 0; m < angular; m++) out[m * 3] = block[m];
+            }
+        }
+    });
+}
+
+std::vector<glm::vec3> FourierRefocus::refocus(float focus_distance) const
+{
+    // Pixel shift of view ij is A * (ij - center)
+    const glm::mat2 A = pixel_step * (1.0f - st_distance / focus_distance);
+    const glm::vec2 center = glm::vec2(grid_size - 1) * 0.5f;
+    const glm::vec2 half_grid = glm::vec2(grid_size / 2);
+    const size_t angular = (size_t)padded.x * padded.y;
+    const float normalization = 1.0f / ((float)grid_size.x * grid_size.y * size.x * size.y);
+
+    // Full 2D spectrum of the refocused image per channel
+    std::vector<Complex> image_spectrum((size_t)size.x * size.y * 3);
+
+    parallelFor((size_t)size.y, [&](size_t ky)
+    {
+        float fy = (ky <= (size_t)size.y / 2 ? (float)ky : (float)ky - size.y) / size.y;
+
+        for (int kx = 0; kx < half_width; kx++)
+        {
+            // Angular frequency in cycles per camera that the shear maps this spatial frequency to
+            glm::vec2 q = glm::transpose(A) * glm::vec2(kx / (float)size.x, fy);
+
+            // Position in the padded angular spectrum, sampled at -q
+            glm::vec2 m = -q * glm::vec2(padded);
+            glm::ivec2 m0 = glm::ivec2(glm::floor(m));
+
+            float wu[4], wv[4];
+            int iu[4], iv[4];
+            for (int t = 0; t < 4; t++)
+            {
+                wu[t] = cubic(m.x - (m0.x - 1 + t));
+                wv[t] = cubic(m.y - (m0.y - 1 + t));
+                iu[t] = ((m0.x - 1 + t) % padded.x + padded.x) % padded.x;
+                iv[t] = ((m0.y - 1 + t) % padded.y + padded.y) % padded.y;
+            }
+
+            const Complex* s = spectrum.data() + (ky * half_width + kx) * angular * 3;
+            Complex sum[3] = {};
+            for (int tv = 0; tv < 4; tv++)
+            {
+                for (int tu = 0; tu < 4; tu++)
+                {
+                    float w = wu[tu] * wv[tv];
+                    const Complex* p = s + ((size_t)iv[tv] * padded.x + iu[tu]) * 3;
+                    for (int c = 0; c < 3; c++) sum[c] += w * p[c];
+                }
+            }
+
+            // Views were placed relative to half_grid instead of the center of the grid
+            float phase = 2.0f * PI * glm::dot(half_grid - center, q);
+            Complex shift(std::cos(phase), std::sin(phase));
+
+            for (int c = 0; c < 3; c++)
+            {
+                image_spectrum[(ky * size.x + kx) * 3 + c] = sum[c] * shift;
+            }
+        }
+    });
+
+    // Spectrum of a real image is conjugate symmetric
+    for (int ky = 0; ky < size.y; ky++)
+    {
+        for (int kx = half_width; kx < size.x; kx++)
+        {
+            size_t mirror = ((size_t)((size.y - ky) % size.y) * size.x + (size.x - kx)) * 3;
+            for (int c = 0; c < 3; c++)
+            {
+                image_spectrum[((size_t)ky * size.x + kx) * 3 + c] = std::conj(image_spectrum[mirror + c]);
+            }
+        }
+    }
+
+    const FFT columns(size.y, true), rows(size.x, true);
+
+    parallelFor((size_t)size.x * 3, [&](size_t i)
+    {
+        columns.transform(image_spectrum.data() + i, (size_t)size.x * 3);
+    });
+
+    std::vector<glm::vec3> image((size_t)size.x * size.y);
+    parallelFor((size_t)size.y, [&](size_t y)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            Complex* row = image_spectrum.data() + y * size.x * 3 + c;
+            rows.transform(row, 3);
+            for (int x = 0; x < size.x; x++)
+            {
+                image[y * size.x + x][c] = std::max(row[(size_t)x * 3].real() * normalization, 0.0f);
+            }
+        }
+    });
+
+    return image;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include <complex>
+
+#include <glm/glm.hpp>
+
+class CameraArray;
+
+/*************************************************************************
+Refocusing of regular light slab grids by Fourier slice photography. The
+4D spectrum of the light field is computed once. After that, the image
+refocused at any depth is a 2D slice of the spectrum followed by an
+inverse 2D FFT, instead of a pass over every camera. It runs on the CPU
+with one thread per core.
+
+Refocusing shears the light field, and a shear is a slice through the
+angular frequencies at positions proportional to the spatial frequency.
+These positions fall between the angular samples. They are interpolated
+with a cubic kernel from an angular spectrum zero padded to at least
+twice the number of cameras. The padding keeps the attenuation of the outer cameras
+and the aliased ghost images small. As with any shift in the Fourier
+domain, the image wraps around its edges.
+*************************************************************************/
+class FourierRefocus
+{
+public:
+    // Camera images are loaded from the folder of the array and downsampled to at most 
+    // resolution pixels wide, the spectrum takes about 48 bytes per camera and pixel
+    FourierRefocus(const CameraArray &camera_array, float st_width, float st_distance, int resolution = 256);
+
+    // Linear RGB views of size pixels in grid order i + j * grid_size.x. A refocused image
+    // averages view ij shifted by (1 - st_distance / focus_distance) * pixel_step * (ij - center).
+    FourierRefocus(const std::vector<std::vector<glm::vec3>> &views, const glm::ivec2 &size,
+                   const glm::ivec2 &grid_size, const glm::mat2 &pixel_step, float st_distance);
+
+    // Linear RGB image of the central view focused at focus_distance, rows from the bottom
+    std::vector<glm::vec3> refocus(float focus_distance) const;
+
+    size_t spectrumBytes() const { return spectrum.size() * sizeof(Complex); }
+
+    glm::ivec2 size;
+    glm::ivec2 grid_size;
+
+private:
+    using Complex = std::complex<float>;
+
+    void build(const std::vector<std::vector<glm::vec3>> &views);
+
+    glm::mat2 pixel_step;
+    float st_distance;
+
+    // Lengths of the zero padded angular transforms
+    glm::ivec2 padded;
+
+    // Spatial frequencies 0 to size.x / 2 along x, the rest follows from symmetry
+    int half_width;
+
+    // Indexed [ky][kx][mv][mu][channel]
+    std::vector<Complex> spectrum;
+};
@@ -0,0 +1,442 @@
+#include "http.hpp"
+
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <chrono>
+#include <sstream>
+#include <vector>
+#include <cstring>
+#include <cctype>
+#include <cerrno>
+
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+#else
+    #include <sys/types.h>
+    #include <sys/socket.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <netdb.h>
+    #include <unistd.h>
+#endif
+
+namespace http
+{
+    namespace
+    {
+    #ifdef _WIN32
+        const Socket INVALID = INVALID_SOCKET;
+        void closeSocket(Socket s) { closesocket(s); }
+    #else
+        const Socket INVALID = -1;
+        void closeSocket(Socket s) { close(s); }
+    #endif
+
+    #ifdef MSG_NOSIGNAL
+        constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+    #else
+        constexpr int SEND_FLAGS = 0;
+    #endif
+
+        void initSockets()
+        {
+        #ifdef _WIN32
+            static bool initialized = []
+            {
+                WSADATA data;
+                if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+                {
+                    throw std::runtime_error("WSAStartup failed");
+                }
+                return true;
+            }();
+        #endif
+        }
+
+        bool sendAll(Socket s, const std::string &data)
+        {
+            size_t sent = 0;
+            while (sent < data.size())
+            {
+                int n = send(s, data.data() + sent, (int)std::min(data.size() - sent, (size_t)1 << 20), SEND_FLAGS);
+                if (n <= 0) return false;
+                sent += n;
+            }
+            return true;
+        }
+
+        // Reads until the end of the headers, returns false if the connection closes first
+        bool receiveHeaders(Socket s, std::string &data, size_t &header_end)
+        {
+            constexpr size_t MAX_HEADER_SIZE = 16384;
+
+            char buffer[4096];
+            while ((header_end = data.find("\r\n\r\n")) == std::string::npos)
+            {
+                if (data.size() > MAX_HEADER_SIZE) return false;
+                int n = recv(s, buffer, sizeof(buffer), 0);
+                if (n <= 0) return false;
+                data.append(buffer, n);
+            }
+            header_end += 4;
+            return true;
+        }
+
+        enum class AcceptError { RETRY, BACK_OFF, FATAL };
+
+        // Interrupted and aborted connections are retried at once, running out of descriptors or
+        // buffers is retried once the pool has closed some connections, anything else ends serving
+        AcceptError acceptError(int &code)
+        {
+        #ifdef _WIN32
+            code = WSAGetLastError();
+            if (code == WSAEINTR || code == WSAECONNRESET) return AcceptError::RETRY;
+            if (code == WSAEMFILE || code == WSAENOBUFS) return AcceptError::BACK_OFF;
+        #else
+            code = errno;
+            if (code == EINTR || code == ECONNABORTED) return AcceptError::RETRY;
+            if (code == EMFILE || code == ENFILE || code == ENOBUFS || code == ENOMEM) return AcceptError::BACK_OFF;
+        #endif
+            return AcceptError::FATAL;
+        }
+
+        void setReceiveTimeout(Socket s, int milliseconds)
+        {
+        #ifdef _WIN32
+            DWORD timeout = milliseconds;
+        #else
+            timeval timeout{ milliseconds / 1000, (milliseconds % 1000) * 1000 };
+        #endif
+            setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+        }
+
+        void sendStatus(Socket s, int status);
+
+        const char* statusText(int status)
+        {
+            switch (status)
+            {
+            case 200: return "OK";
+            case 400: return "Bad Request";
+            case 404: return "Not Found";
+            case 405: return "Method Not Allowed";
+            case 503: return "Service Unavailable";
+            default: return "Internal Server Error";
+            }
+        }
+
+        void handleConnection(Socket s, const std::function<Response(const Request&)> &handler)
+        {
+            std::string data;
+            size_t header_end;
+            if (receiveHeaders(s, data, header_end))
+            {
+                std::istringstream request_line(data.substr(0, data.find("\r\n")));
+
+                Request request;
+                std::string target;
+                request_line >> request.method >> target;
+
+                size_t q = target.find('?');
+                request.path = target.substr(0, q);
+                if (q != std::string::npos) request.query = decodeQuery(target.substr(q + 1));
+
+                Response response;
+                if (request.method != "GET")
+                {
+                    response.status = 405;
+                }
+                else
+                {
+                    try
+                    {
+                        response = handler(request);
+                    }
+                    catch (const std::exception &ex)
+                    {
+                        response.status = 500;
+                        response.body = ex.what();
+                    }
+                }
+
+                std::ostringstream header;
+                header << "HTTP/1.1 " << response.status << " " << statusText(response.status) << "\r\n"
+                       << "Content-Type: " << response.content_type << "\r\n"
+                       << "Content-Length: " << response.body.size() << "\r\n"
+                       << "Connection: close\r\n\r\n";
+
+                if (sendAll(s, header.str())) sendAll(s, response.body);
+            }
+            closeSocket(s);
+        }
+
+        void sendStatus(Socket s, int status)
+        {
+            std::ostringstream header;
+            header << "HTTP/1.1 " << status << " " << statusText(status) << "\r\n"
+                   << "Content-Length: 0\r\nConnection: close\r\n\r\n";
+            sendAll(s, header.str());
+        }
+
+        int hexValue(char c)
+        {
+            if (c >= '0' && c <= '9') return c - '0';
+            if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+            return -1;
+        }
+
+        // Malformed escapes are kept as they are
+        std::string percentDecode(const std::string &text)
+        {
+            std::string result;
+            result.reserve(text.size());
+            for (size_t i = 0; i < text.size(); i++)
+            {
+                int high, low;
+                if (text[i] == '+')
+                {
+                    result += ' ';
+                }
+                else if (text[i] == '%' && i + 2 < text.size() && (high = hexValue(text[i + 1])) >= 0 && (low = hexValue(text[i + 2])) >= 0)
+                {
+                    result += (char)(high * 16 + low);
+                    i += 2;
+                }
+                else
+                {
+                    result += text[i];
+                }
+            }
+            return result;
+        }
+
+        std::string percentEncode(const std::string &text)
+        {
+            constexpr char HEX[] = "0123456789ABCDEF";
+            std::string result;
+            for (unsigned char c : text)
+            {
+                if (std::isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~')
+                {
+                    result += (char)c;
+                }
+                else
+                {
+                    result += '%';
+                    result += HEX[c >> 4];
+                    result += HEX[c & 15];
+                }
+            }
+            return result;
+        }
+    }
+
+    // Running from the start, so that a stop() before serve() isn't lost
+    Server::Server(uint16_t port, bool all_interfaces) : port(port), listener(INVALID), running(true)
+    {
+        initSockets();
+
+        listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (listener == INVALID) throw std::runtime_error("Unable to create socket");
+
+        int reuse = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(all_interfaces ? INADDR_ANY : INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+
+        if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0)
+        {
+            closeSocket(listener);
+            throw std::runtime_error("Unable to listen on port " + std::to_string(port));
+        }
+    }
+
+    Server::~Server()
+    {
+        stop();
+    }
+
+    void Server::serve(const std::function<Response(const Request&)> &handler)
+    {
+        std::vector<std::thread> pool;
+        for (size_t i = 0; i < MAX_CONNECTIONS; i++)
+        {
+            pool.emplace_back([this, &handler]
+            {
+                while (true)
+                {
+                    Socket client;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        condition.wait(lock, [this] { return !running || !connections.empty(); });
+                        if (connections.empty()) return;
+
+                        client = connections.front();
+                        connections.pop_front();
+                    }
+                    handleConnection(client, handler);
+                }
+            });
+        }
+
+        while (running)
+        {
+            Socket client = accept(listener, nullptr, nullptr);
+            if (client == INVALID)
+            {
+                if (!running) break;
+
+                int code;
+                auto error = acceptError(code);
+                if (error == AcceptError::RETRY) continue;
+                if (error == AcceptError::BACK_OFF)
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(ACCEPT_BACK_OFF_MS));
+                    continue;
+                }
+
+                std::cout << "Stopped serving port " << port << ", accept failed with error " << code << std::endl;
+                break;
+            }
+
+            int no_delay = 1;
+            setsockopt(client, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&no_delay), sizeof(no_delay));
+            setReceiveTimeout(client, RECEIVE_TIMEOUT_MS);
+
+            std::unique_lock<std::mutex> lock(mutex);
+            if (connections.size() >= MAX_CONNECTIONS)
+            {
+                lock.unlock();
+                sendStatus(client, 503);
+                closeSocket(client);
+                continue;
+            }
+            connections.push_back(client);
+            lock.unlock();
+            condition.notify_one();
+        }
+
+        // Queued connections are still answered before the pool exits
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        condition.notify_all();
+        for (auto &t : pool) t.join();
+    }
+
+    void Server::stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        condition.notify_all();
+
+        if (listener != INVALID)
+        {
+            // Wakes up a blocking accept
+        #ifdef _WIN32
+            shutdown(listener, SD_BOTH);
+        #else
+            shutdown(listener, SHUT_RDWR);
+        #endif
+            closeSocket(listener);
+            listener = INVALID;
+        }
+    }
+
+    Response get(const std::string &host, uint16_t port, const std::string &target)
+    {
+        initSockets();
+
+        addrinfo hints{}, *addresses = nullptr;
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0)
+        {
+            throw std::runtime_error("Unable to resolve " + host);
+        }
+
+        Socket s = INVALID;
+        for (addrinfo *a = addresses; a; a = a->ai_next)
+        {
+            s = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+            if (s == INVALID) continue;
+            if (connect(s, a->ai_addr, (int)a->ai_addrlen) == 0) break;
+            closeSocket(s);
+            s = INVALID;
+        }
+        freeaddrinfo(addresses);
+
+        if (s == INVALID) throw std::runtime_error("Unable to connect to " + host + ":" + std::to_string(port));
+
+        std::string request = "GET " + target + " HTTP/1.1\r\nHost: " + host + "\r\nConnection: close\r\n\r\n";
+
+        std::string data;
+        size_t header_end;
+        if (!sendAll(s, request) || !receiveHeaders(s, data, header_end))
+        {
+            closeSocket(s);
+            throw std::runtime_error("Connection to " + host + " closed");
+        }
+
+        // The body ends when the server closes the connection
+        char buffer[65536];
+        int n;
+        while ((n = recv(s, buffer, sizeof(buffer), 0)) > 0)
+        {
+            data.append(buffer, n);
+        }
+        closeSocket(s);
+
+        Response response;
+        std::istringstream status_line(data.substr(0, data.find("\r\n")));
+        std::string version;
+        status_line >> version >> response.status;
+
+        std::string headers = data.substr(0, header_end);
+        size_t type = headers.find("Content-Type: ");
+        if (type != std::string::npos)
+        {
+            type += 14;
+            response.content_type = headers.substr(type, headers.find("\r\n", type) - type);
+        }
+
+        response.body = data.substr(header_end);
+        return response;
+    }
+
+    std::string encodeQuery(const std::map<std::string, std::string> &query)
+    {
+        std::string result;
+        for (const auto &[key, value] : query)
+        {
+            if (!result.empty()) result += '&';
+            result += percentEncode(key) + '=' + percentEncode(value);
+        }
+        return result;
+    }
+
+    std::map<std::string, std::string> decodeQuery(const std::string &query)
+    {
+        std::map<std::string, std::string> result;
+
+        std::istringstream ss(query);
+        std::string pair;
+        while (std::getline(ss, pair, '&'))
+        {
+            size_t eq = pair.find('=');
+            if (eq == std::string::npos) result[percentDecode(pair)] = "";
+            else result[percentDecode(pair.substr(0, eq))] = percentDecode(pair.substr(eq + 1));
+        }
+        return result;
+    }
+}
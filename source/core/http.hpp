@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <cstdint>
+
+/*************************************************************************
+Minimal blocking HTTP/1.1 over TCP for the render server and its test 
+client. Each connection carries a single request and is closed after the 
+response. Only GET requests with query parameters are supported.
+*************************************************************************/
+namespace http
+{
+#ifdef _WIN32
+    using Socket = uintptr_t;
+#else
+    using Socket = int;
+#endif
+
+    struct Request
+    {
+        std::string method;
+        std::string path;
+        std::map<std::string, std::string> query;
+    };
+
+    struct Response
+    {
+        int status = 200;
+        std::string content_type = "text/plain";
+        std::string body;
+    };
+
+    class Server
+    {
+    public:
+        // Listens on the loopback interface unless all interfaces are requested, throws if the port can't be bound.
+        // There is no authentication, so only trusted networks should reach a server on all interfaces.
+        Server(uint16_t port, bool all_interfaces = false);
+        ~Server();
+
+        // Accepts connections until stop() is called. Connections are handled by a pool of
+        // MAX_CONNECTIONS threads, further ones wait in a queue of the same length or get a 503.
+        void serve(const std::function<Response(const Request&)> &handler);
+        void stop();
+
+        const uint16_t port;
+
+        static constexpr size_t MAX_CONNECTIONS = 32;
+
+        // Idle connections are closed after this time so that they can't hold a pool thread
+        static constexpr int RECEIVE_TIMEOUT_MS = 10000;
+
+        // Wait before accepting again when the process is out of descriptors
+        static constexpr int ACCEPT_BACK_OFF_MS = 100;
+
+    private:
+        Socket listener;
+        std::atomic<bool> running;
+
+        std::deque<Socket> connections;
+        std::mutex mutex;
+        std::condition_variable condition;
+    };
+
+    // Throws on connection failures, HTTP errors are returned as the response status
+    Response get(const std::string &host, uint16_t port, const std::string &target);
+
+    // Keys and values are percent-encoded, '+' decodes to a space
+    std::string encodeQuery(const std::map<std::string, std::string> &query);
+    std::map<std::string, std::string> decodeQuery(const std::string &query);
+}
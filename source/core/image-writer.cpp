@@ -0,0 +1,359 @@
+#include "image-writer.hpp"
+
+#include <stdexcept>
+#include <filesystem>
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <ostream>
+
+#include "util.hpp"
+
+TGAWriter::TGAWriter(const std::string &filename, const glm::ivec2 &size) : size(size)
+{
+    if (size.x < 1 || size.y < 1 || size.x > 0xFFFF || size.y > 0xFFFF)
+    {
+        throw std::runtime_error("TGA size out of range: " + std::to_string(size.x) + "x" + std::to_string(size.y));
+    }
+
+    file.open(filename, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Unable to open " + filename + " for writing");
+    }
+
+    // Uncompressed true-color image with 24 bits per pixel and the origin in the lower left corner
+    uint8_t header[HEADER_SIZE] = { 0, 0, 2 };
+    header[12] = size.x & 0xFF;
+    header[13] = (size.x >> 8) & 0xFF;
+    header[14] = size.y & 0xFF;
+    header[15] = (size.y >> 8) & 0xFF;
+    header[16] = 24;
+    file.write(reinterpret_cast<char*>(header), HEADER_SIZE);
+
+    // Allocate the full image so that regions can be written in any order
+    file.seekp(HEADER_SIZE + (std::streamoff)size.x * size.y * 3 - 1);
+    file.put(0);
+
+    if (!file)
+    {
+        throw std::runtime_error("Unable to allocate " + filename);
+    }
+}
+
+void TGAWriter::write(const glm::ivec2 &offset, const glm::ivec2 &region, const std::vector<glm::u8vec3> &bgr)
+{
+    if (glm::any(glm::lessThan(offset, glm::ivec2(0))) || glm::any(glm::greaterThan(offset + region, size)) || 
+        bgr.size() < (size_t)region.x * region.y)
+    {
+        throw std::runtime_error("TGA region out of range");
+    }
+
+    for (int y = 0; y < region.y; y++)
+    {
+        file.seekp(HEADER_SIZE + ((std::streamoff)(offset.y + y) * size.x + offset.x) * 3);
+        file.write(reinterpret_cast<const char*>(&bgr[(size_t)y * region.x]), (std::streamsize)region.x * 3);
+    }
+
+    if (!file)
+    {
+        throw std::runtime_error("Failed writing TGA region");
+    }
+}
+
+LinearImageWriter::LinearImageWriter(const std::string &filename, const glm::ivec2 &size) : LinearImageWriter(file, size)
+{
+    file.open(filename, std::ios::binary);
+    if (!file)
+    {
+        throw std::runtime_error("Unable to open " + filename + " for writing");
+    }
+}
+
+LinearImageWriter::LinearImageWriter(std::ostream &stream, const glm::ivec2 &size) : size(size), out(stream)
+{
+    if (size.x < 1 || size.y < 1)
+    {
+        throw std::runtime_error("Invalid image size: " + std::to_string(size.x) + "x" + std::to_string(size.y));
+    }
+}
+
+void LinearImageWriter::finish()
+{
+    out.flush();
+    if (file.is_open()) file.close();
+    if (out.fail())
+    {
+        throw std::runtime_error("Failed writing image");
+    }
+}
+
+namespace
+{
+    uint16_t toUnorm16(float linear)
+    {
+        return (uint16_t)(glm::clamp(srgbGammaCompress(linear), 0.0f, 1.0f) * 65535.0f + 0.5f);
+    }
+
+    bool littleEndian()
+    {
+        const uint16_t one = 1;
+        return *reinterpret_cast<const uint8_t*>(&one) == 1;
+    }
+
+    class PFMWriter : public LinearImageWriter
+    {
+    public:
+        template<typename Target>
+        PFMWriter(Target &&target, const glm::ivec2 &size) : LinearImageWriter(std::forward<Target>(target), size)
+        {
+            // Negative scale means little endian
+            out << "PF\n" << size.x << " " << size.y << "\n" << (littleEndian() ? "-1.0" : "1.0") << "\n";
+        }
+
+        bool bottomUp() const override { return true; }
+
+        void writeRow(const std::vector<glm::vec3> &row) override
+        {
+            out.write(reinterpret_cast<const char*>(row.data()), (std::streamsize)size.x * sizeof(glm::vec3));
+        }
+    };
+
+    class PPMWriter : public LinearImageWriter
+    {
+    public:
+        template<typename Target>
+        PPMWriter(Target &&target, const glm::ivec2 &size) : LinearImageWriter(std::forward<Target>(target), size), bytes(size.x * 6)
+        {
+            out << "P6\n" << size.x << " " << size.y << "\n65535\n";
+        }
+
+        bool bottomUp() const override { return false; }
+
+        void writeRow(const std::vector<glm::vec3> &row) override
+        {
+            // Samples are big endian
+            for (int x = 0; x < size.x; x++)
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    uint16_t v = toUnorm16(row[x][c]);
+                    bytes[x * 6 + c * 2 + 0] = v >> 8;
+                    bytes[x * 6 + c * 2 + 1] = v & 0xFF;
+                }
+            }
+            out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+        }
+
+    private:
+        std::vector<uint8_t> bytes;
+    };
+
+    /**********************************************************************
+    Each row is written as its own IDAT chunk holding stored (uncompressed) 
+    deflate blocks, which keeps the zlib stream valid without buffering 
+    more than a row. The checksums are updated incrementally.
+    **********************************************************************/
+    class PNGWriter : public LinearImageWriter
+    {
+    public:
+        template<typename Target>
+        PNGWriter(Target &&target, const glm::ivec2 &size) : LinearImageWriter(std::forward<Target>(target), size), scanline(1 + size.x * 6)
+        {
+            const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+            out.write(reinterpret_cast<const char*>(signature), 8);
+
+            std::vector<uint8_t> ihdr;
+            put32(ihdr, size.x);
+            put32(ihdr, size.y);
+            ihdr.insert(ihdr.end(), { 16, 2, 0, 0, 0 }); // 16-bit RGB, deflate, no filter, no interlace
+            chunk("IHDR", ihdr);
+
+            chunk("sRGB", { 0 });
+
+            pending = { 0x78, 0x01 }; // zlib header, no compression
+        }
+
+        bool bottomUp() const override { return false; }
+
+        void writeRow(const std::vector<glm::vec3> &row) override
+        {
+            scanline[0] = 0; // No filter
+            for (int x = 0; x < size.x; x++)
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    uint16_t v = toUnorm16(row[x][c]);
+                    scanline[1 + x * 6 + c * 2 + 0] = v >> 8;
+                    scanline[1 + x * 6 + c * 2 + 1] = v & 0xFF;
+                }
+            }
+            adler32(scanline);
+
+            bool last_row = ++rows == size.y;
+
+            // Stored blocks hold at most 65535 bytes
+            for (size_t offset = 0; offset < scanline.size(); offset += 0xFFFF)
+            {
+                uint16_t length = (uint16_t)std::min(scanline.size() - offset, (size_t)0xFFFF);
+                bool final_block = last_row && offset + length == scanline.size();
+
+                pending.push_back(final_block ? 1 : 0);
+                pending.insert(pending.end(), { (uint8_t)(length & 0xFF), (uint8_t)(length >> 8), 
+                                                (uint8_t)(~length & 0xFF), (uint8_t)((~length >> 8) & 0xFF) });
+                pending.insert(pending.end(), scanline.begin() + offset, scanline.begin() + offset + length);
+            }
+
+            if (last_row) put32(pending, (adler_b << 16) | adler_a);
+
+            chunk("IDAT", pending);
+            pending.clear();
+        }
+
+        void finish() override
+        {
+            chunk("IEND", {});
+            LinearImageWriter::finish();
+        }
+
+    private:
+        std::vector<uint8_t> scanline, pending;
+        int rows = 0;
+        uint32_t adler_a = 1, adler_b = 0;
+
+        static void put32(std::vector<uint8_t> &v, uint32_t x)
+        {
+            v.insert(v.end(), { (uint8_t)(x >> 24), (uint8_t)(x >> 16), (uint8_t)(x >> 8), (uint8_t)x });
+        }
+
+        void adler32(const std::vector<uint8_t> &data)
+        {
+            // Largest number of bytes before the sums can overflow
+            constexpr size_t NMAX = 5552;
+            for (size_t i = 0; i < data.size(); i += NMAX)
+            {
+                size_t end = std::min(i + NMAX, data.size());
+                for (size_t j = i; j < end; j++)
+                {
+                    adler_a += data[j];
+                    adler_b += adler_a;
+                }
+                adler_a %= 65521;
+                adler_b %= 65521;
+            }
+        }
+
+        static uint32_t crc32(uint32_t crc, const uint8_t *data, size_t size)
+        {
+            static const auto table = []
+            {
+                std::array<uint32_t, 256> t;
+                for (uint32_t n = 0; n < 256; n++)
+                {
+                    uint32_t c = n;
+                    for (int k = 0; k < 8; k++)
+                    {
+                        c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                    }
+                    t[n] = c;
+                }
+                return t;
+            }();
+
+            for (size_t i = 0; i < size; i++)
+            {
+                crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+            }
+            return crc;
+        }
+
+        void chunk(const char* type, const std::vector<uint8_t> &data)
+        {
+            std::vector<uint8_t> length;
+            put32(length, (uint32_t)data.size());
+            out.write(reinterpret_cast<const char*>(length.data()), 4);
+            out.write(type, 4);
+            out.write(reinterpret_cast<const char*>(data.data()), data.size());
+
+            uint32_t crc = crc32(0xFFFFFFFFu, reinterpret_cast<const uint8_t*>(type), 4);
+            crc = crc32(crc, data.data(), data.size()) ^ 0xFFFFFFFFu;
+
+            std::vector<uint8_t> crc_bytes;
+            put32(crc_bytes, crc);
+            out.write(reinterpret_cast<const char*>(crc_bytes.data()), 4);
+        }
+    };
+
+    std::string lowercaseExtension(const std::string &filename)
+    {
+        std::string extension = std::filesystem::path(filename).extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+        return extension;
+    }
+}
+
+bool LinearImageWriter::supported(const std::string &filename)
+{
+    std::string extension = lowercaseExtension(filename);
+    return extension == ".pfm" || extension == ".ppm" || extension == ".png";
+}
+
+namespace
+{
+    template<typename Target>
+    std::unique_ptr<LinearImageWriter> createWriter(Target &&target, const std::string &extension, const glm::ivec2 &size)
+    {
+        if (extension == ".pfm") return std::make_unique<PFMWriter>(std::forward<Target>(target), size);
+        if (extension == ".ppm") return std::make_unique<PPMWriter>(std::forward<Target>(target), size);
+        if (extension == ".png") return std::make_unique<PNGWriter>(std::forward<Target>(target), size);
+
+        throw std::runtime_error("Unsupported image format: " + extension);
+    }
+}
+
+std::unique_ptr<LinearImageWriter> LinearImageWriter::create(const std::string &filename, const glm::ivec2 &size)
+{
+    return createWriter(filename, lowercaseExtension(filename), size);
+}
+
+std::unique_ptr<LinearImageWriter> LinearImageWriter::create(std::ostream &stream, const std::string &extension, const glm::ivec2 &size)
+{
+    return createWriter(stream, extension, size);
+}
+
+WriteQueue::WriteQueue() : thread(&WriteQueue::run, this) { }
+
+WriteQueue::~WriteQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    condition.notify_one();
+    thread.join();
+}
+
+void WriteQueue::push(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    condition.notify_one();
+}
+
+void WriteQueue::run()
+{
+    while (true)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return stop || !jobs.empty(); });
+            if (jobs.empty()) return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <string>
+#include <fstream>
+#include <vector>
+#include <memory>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <glm/glm.hpp>
+
+/*************************************************************************
+Uncompressed 24-bit TGA file that is allocated up front and written one 
+region at a time, so that images larger than memory can be streamed to 
+disk. Rows are stored bottom to top, the same order as OpenGL reads them.
+*************************************************************************/
+class TGAWriter
+{
+public:
+    TGAWriter(const std::string &filename, const glm::ivec2 &size);
+
+    // BGR pixels of the region, row by row from the bottom
+    void write(const glm::ivec2 &offset, const glm::ivec2 &region, const std::vector<glm::u8vec3> &bgr);
+
+    const glm::ivec2 size;
+
+private:
+    std::ofstream file;
+
+    static constexpr std::streamoff HEADER_SIZE = 18;
+};
+
+/*************************************************************************
+High bit depth output of linear RGB images, written one row at a time in 
+the order given by bottomUp(). The format is chosen from the extension:
+  .pfm  32-bit float linear, rows bottom to top
+  .ppm  16-bit sRGB, rows top to bottom
+  .png  16-bit sRGB with uncompressed deflate, rows top to bottom
+*************************************************************************/
+class LinearImageWriter
+{
+public:
+    static std::unique_ptr<LinearImageWriter> create(const std::string &filename, const glm::ivec2 &size);
+
+    // Writes to a stream that must outlive the writer, the format is given by an extension such as ".png"
+    static std::unique_ptr<LinearImageWriter> create(std::ostream &stream, const std::string &extension, const glm::ivec2 &size);
+
+    static bool supported(const std::string &filename);
+
+    virtual ~LinearImageWriter() = default;
+
+    virtual bool bottomUp() const = 0;
+    virtual void writeRow(const std::vector<glm::vec3> &row) = 0;
+    virtual void finish();
+
+    const glm::ivec2 size;
+
+protected:
+    LinearImageWriter(const std::string &filename, const glm::ivec2 &size);
+    LinearImageWriter(std::ostream &stream, const glm::ivec2 &size);
+
+    std::ofstream file;
+    std::ostream &out;
+};
+
+// Runs jobs such as image encoding on a background thread, in submission order
+class WriteQueue
+{
+public:
+    WriteQueue();
+
+    // Waits for all pending jobs
+    ~WriteQueue();
+
+    void push(std::function<void()> job);
+
+private:
+    void run();
+
+    std::deque<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stop = false;
+    std::thread thread;
+};
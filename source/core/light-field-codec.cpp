@@ -0,0 +1,774 @@
+#include "light-field-codec.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <filesystem>
+#include <vector>
+#include <array>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+#include "camera-array.hpp"
+#include "image-writer.hpp"
+#include "util.hpp"
+
+namespace
+{
+    constexpr char MAGIC[4] = { 'L', 'F', 'C', '1' };
+
+    // Limits of the header, so that a corrupt file can't ask for huge allocations
+    constexpr int MAX_IMAGE_SIZE = 16384;
+    constexpr size_t MAX_VIEWS = 65536;
+
+    constexpr int BLOCK_SIZE = 16;
+
+    // Largest disparity searched per block, in pixels per camera baseline
+    constexpr int MAX_DISPARITY = 32;
+
+    // Rice codes with a longer unary part are escaped to a fixed 16-bit value
+    constexpr uint32_t RICE_LIMIT = 24;
+
+    // References of a block, the view to the left, the view below or their average
+    enum Mode { INTRA = 0, FIRST = 1, SECOND = 2, BOTH = 3 };
+
+    // Y, Co and Cg planes of a view, rows from the bottom
+    using Planes = std::array<std::vector<int16_t>, 3>;
+
+    constexpr int CHANNEL_MIN[3] = { 0, -255, -255 };
+    constexpr int CHANNEL_MAX[3] = { 255, 255, 255 };
+
+    struct Header
+    {
+        glm::ivec2 grid_size;
+        glm::ivec2 image_size;
+        int quality;
+
+        // Original file names in grid order i + j * grid_size.x
+        std::vector<std::string> names;
+        std::vector<uint64_t> stream_sizes;
+    };
+
+    // Camera positions of the grid, from which the reference shifts follow
+    struct Geometry
+    {
+        std::vector<glm::vec2> xy;
+        float baseline;
+    };
+
+    struct Block
+    {
+        int mode = INTRA;
+        int disparity = 0;
+    };
+
+    class BitWriter
+    {
+    public:
+        void put(uint32_t value, int count)
+        {
+            if (count == 0) return;
+            acc = (acc << count) | (value & ((1ull << count) - 1));
+            bits += count;
+            while (bits >= 8)
+            {
+                bits -= 8;
+                bytes.push_back((uint8_t)(acc >> bits));
+            }
+        }
+
+        void rice(uint32_t value, int k)
+        {
+            uint32_t q = value >> k;
+            if (q < RICE_LIMIT)
+            {
+                ones(q);
+                put(0, 1);
+                put(value, k);
+            }
+            else
+            {
+                ones(RICE_LIMIT);
+                put(value, 16);
+            }
+        }
+
+        std::vector<uint8_t> finish()
+        {
+            if (bits > 0) bytes.push_back((uint8_t)(acc << (8 - bits)));
+            bits = 0;
+            return std::move(bytes);
+        }
+
+    private:
+        void ones(uint32_t count)
+        {
+            while (count > 0)
+            {
+                int n = (int)std::min(count, 24u);
+                put((1u << n) - 1, n);
+                count -= n;
+            }
+        }
+
+        std::vector<uint8_t> bytes;
+        uint64_t acc = 0;
+        int bits = 0;
+    };
+
+    class BitReader
+    {
+    public:
+        BitReader(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+        // Reads zeros past the end, so that a truncated stream can't read out of bounds
+        uint32_t get(int count)
+        {
+            if (count == 0) return 0;
+            while (bits < count)
+            {
+                acc = (acc << 8) | (pos < size ? data[pos++] : 0);
+                bits += 8;
+            }
+            bits -= count;
+            return (uint32_t)(acc >> bits) & (uint32_t)((1ull << count) - 1);
+        }
+
+        uint32_t rice(int k)
+        {
+            uint32_t q = 0;
+            while (q < RICE_LIMIT && get(1)) q++;
+            if (q == RICE_LIMIT) return get(16);
+            return (q << k) | get(k);
+        }
+
+    private:
+        const uint8_t* data;
+        size_t size, pos = 0;
+        uint64_t acc = 0;
+        int bits = 0;
+    };
+
+    // Rice parameter from the running mean magnitude of the coded values, as in LOCO-I
+    struct RiceContext
+    {
+        uint32_t a = 4, n = 1;
+
+        int k() const
+        {
+            int k = 0;
+            while ((n << k) < a && k < 16) k++;
+            return k;
+        }
+
+        void update(uint32_t value)
+        {
+            a += value;
+            if (++n == 64)
+            {
+                a >>= 1;
+                n >>= 1;
+            }
+        }
+    };
+
+    uint32_t zigzag(int v) { return v >= 0 ? 2u * v : 2u * (uint32_t)(-v) - 1u; }
+    int unzigzag(uint32_t v) { return (v & 1) ? -(int)((v + 1) >> 1) : (int)(v >> 1); }
+
+    // Median edge detector of LOCO-I
+    int med(int a, int b, int c)
+    {
+        if (c >= std::max(a, b)) return std::min(a, b);
+        if (c <= std::min(a, b)) return std::max(a, b);
+        return a + b - c;
+    }
+
+    // Reversible RGB to YCoCg-R
+    void toYCoCg(const uint8_t* rgb, int16_t &y, int16_t &co, int16_t &cg)
+    {
+        int c_o = rgb[0] - rgb[2];
+        int t = rgb[2] + (c_o >> 1);
+        int c_g = rgb[1] - t;
+        y = (int16_t)(t + (c_g >> 1));
+        co = (int16_t)c_o;
+        cg = (int16_t)c_g;
+    }
+
+    glm::u8vec3 toRGB(int y, int co, int cg)
+    {
+        int t = y - (cg >> 1);
+        int g = cg + t;
+        int b = t - (co >> 1);
+        int r = b + co;
+        return glm::u8vec3(glm::clamp(glm::ivec3(r, g, b), 0, 255));
+    }
+
+    Planes loadPlanes(const std::filesystem::path &file, const glm::ivec2 &size)
+    {
+        auto image = CameraArray::decode(file, CameraArray::Storage::SRGB_SHADER);
+        if (image.data.empty()) throw std::runtime_error("Unable to decode " + file.string());
+        if (image.size != size) throw std::runtime_error(file.string() + " differs in size from the other cameras");
+
+        const size_t pixels = (size_t)size.x * size.y;
+        const size_t channels = image.data.size() / pixels;
+
+        Planes planes;
+        for (auto &p : planes) p.resize(pixels);
+
+        for (size_t i = 0; i < pixels; i++)
+        {
+            // Gray is replicated, alpha is dropped
+            const uint8_t* p = image.data.data() + i * channels;
+            uint8_t rgb[3] = { p[0], p[channels >= 3 ? 1 : 0], p[channels >= 3 ? 2 : 0] };
+            toYCoCg(rgb, planes[0][i], planes[1][i], planes[2][i]);
+        }
+        return planes;
+    }
+
+    // Decoding order, views on one anti-diagonal of the grid only depend on the previous one
+    std::vector<std::vector<int>> wavefronts(const glm::ivec2 &grid_size)
+    {
+        std::vector<std::vector<int>> fronts(grid_size.x + grid_size.y - 1);
+        for (int j = 0; j < grid_size.y; j++)
+        {
+            for (int i = 0; i < grid_size.x; i++)
+            {
+                fronts[i + j].push_back(i + j * grid_size.x);
+            }
+        }
+        return fronts;
+    }
+
+    Geometry findGeometry(const Header &header)
+    {
+        Geometry geometry;
+        for (const auto &name : header.names)
+        {
+            CameraArray::FileInfo info;
+            if (!CameraArray::parseFilename(name, info)) throw std::runtime_error("Invalid camera file name " + name);
+            geometry.xy.push_back(info.xy);
+        }
+
+        // Mean distance between horizontal neighbours, or vertical ones for a single column
+        const glm::ivec2 n = header.grid_size;
+        const glm::ivec2 step = n.x > 1 ? glm::ivec2(1, 0) : glm::ivec2(0, 1);
+        float sum = 0.0f;
+        int count = 0;
+        for (int j = 0; j + step.y < n.y; j++)
+        {
+            for (int i = 0; i + step.x < n.x; i++)
+            {
+                sum += glm::distance(geometry.xy[i + j * n.x], geometry.xy[i + step.x + (j + step.y) * n.x]);
+                count++;
+            }
+        }
+        geometry.baseline = count > 0 && sum > 0.0f ? sum / count : 1.0f;
+        return geometry;
+    }
+
+    // Prediction of a view from the reconstructed views to its left and below
+    class Predictor
+    {
+    public:
+        Predictor(const Header &header, const Geometry &geometry, const std::vector<Planes> &recon, int index)
+            : size(header.image_size)
+        {
+            const glm::ivec2 ij(index % header.grid_size.x, index / header.grid_size.x);
+            const glm::ivec2 neighbours[2] = { ij - glm::ivec2(1, 0), ij - glm::ivec2(0, 1) };
+
+            for (int r = 0; r < 2; r++)
+            {
+                if (neighbours[r].x < 0 || neighbours[r].y < 0) continue;
+                int ref = neighbours[r].x + neighbours[r].y * header.grid_size.x;
+                refs[r] = &recon[ref];
+                directions[r] = (geometry.xy[ref] - geometry.xy[index]) / geometry.baseline;
+            }
+        }
+
+        bool available(int mode) const
+        {
+            return ((mode != FIRST && mode != BOTH) || refs[0]) && ((mode != SECOND && mode != BOTH) || refs[1]);
+        }
+
+        // Offsets of the references for a block disparity
+        void offsets(int disparity, glm::ivec2 out[2]) const
+        {
+            for (int r = 0; r < 2; r++) out[r] = glm::ivec2(glm::round(directions[r] * (float)disparity));
+        }
+
+        int sample(int r, int c, int x, int y, const glm::ivec2 &offset) const
+        {
+            x = glm::clamp(x + offset.x, 0, size.x - 1);
+            y = glm::clamp(y + offset.y, 0, size.y - 1);
+            return (*refs[r])[c][(size_t)y * size.x + x];
+        }
+
+        int predict(int mode, int c, int x, int y, const glm::ivec2 offset[2]) const
+        {
+            switch (mode)
+            {
+                case FIRST:  return sample(0, c, x, y, offset[0]);
+                case SECOND: return sample(1, c, x, y, offset[1]);
+                default:     return (sample(0, c, x, y, offset[0]) + sample(1, c, x, y, offset[1]) + 1) >> 1;
+            }
+        }
+
+        const glm::ivec2 size;
+        const Planes* refs[2] = { nullptr, nullptr };
+        glm::vec2 directions[2];
+    };
+
+    int intraPrediction(const std::vector<int16_t> &plane, int c, int x, int y, int width)
+    {
+        const size_t i = (size_t)y * width + x;
+        if (x == 0 && y == 0) return c == 0 ? 128 : 0;
+
+        int a = x > 0 ? plane[i - 1] : plane[i - width];
+        int b = y > 0 ? plane[i - width] : a;
+        int d = x > 0 && y > 0 ? plane[i - width - 1] : b;
+        return med(a, b, d);
+    }
+
+    // Mode and disparity of each block with the smallest absolute luma residual
+    std::vector<Block> chooseBlocks(const Predictor &predictor, const Planes &original)
+    {
+        const glm::ivec2 size = predictor.size;
+        const glm::ivec2 blocks = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        const auto &Y = original[0];
+
+        std::vector<Block> choice((size_t)blocks.x * blocks.y);
+        for (int by = 0; by < blocks.y; by++)
+        {
+            for (int bx = 0; bx < blocks.x; bx++)
+            {
+                const glm::ivec2 min = glm::ivec2(bx, by) * BLOCK_SIZE;
+                const glm::ivec2 max = glm::min(min + BLOCK_SIZE, size);
+
+                // Estimated on the original, the encoder predicts from the reconstruction
+                int64_t best_cost = 0;
+                for (int y = min.y; y < max.y; y++)
+                {
+                    for (int x = min.x; x < max.x; x++)
+                    {
+                        best_cost += std::abs(Y[(size_t)y * size.x + x] - intraPrediction(Y, 0, x, y, size.x));
+                    }
+                }
+
+                Block best;
+                if (predictor.refs[0] || predictor.refs[1])
+                {
+                    for (int d = -MAX_DISPARITY; d <= MAX_DISPARITY; d++)
+                    {
+                        glm::ivec2 offset[2];
+                        predictor.offsets(d, offset);
+
+                        int64_t cost[4] = { 0, 0, 0, 0 };
+                        for (int y = min.y; y < max.y; y++)
+                        {
+                            for (int x = min.x; x < max.x; x++)
+                            {
+                                int v = Y[(size_t)y * size.x + x];
+                                int r0 = predictor.refs[0] ? predictor.sample(0, 0, x, y, offset[0]) : 0;
+                                int r1 = predictor.refs[1] ? predictor.sample(1, 0, x, y, offset[1]) : 0;
+                                cost[FIRST] += std::abs(v - r0);
+                                cost[SECOND] += std::abs(v - r1);
+                                cost[BOTH] += std::abs(v - ((r0 + r1 + 1) >> 1));
+                            }
+                        }
+
+                        for (int mode = FIRST; mode <= BOTH; mode++)
+                        {
+                            if (predictor.available(mode) && cost[mode] < best_cost)
+                            {
+                                best_cost = cost[mode];
+                                best = { mode, d };
+                            }
+                        }
+                    }
+                }
+
+                choice[(size_t)by * blocks.x + bx] = best;
+            }
+        }
+        return choice;
+    }
+
+    // Prediction loop shared by the encoder and decoder. Residuals of original are quantized and
+    // written if it is given, otherwise they are read. The reconstruction is identical in both.
+    void codeResiduals(const Predictor &predictor, const std::vector<Block> &blocks, int quality,
+                       const Planes* original, BitWriter* writer, BitReader* reader, Planes &recon)
+    {
+        const glm::ivec2 size = predictor.size;
+        const int blocks_x = (size.x + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+        for (auto &p : recon) p.assign((size_t)size.x * size.y, 0);
+
+        RiceContext contexts[3];
+        glm::ivec2 offset[2];
+        int offset_block = -1;
+
+        for (int y = 0; y < size.y; y++)
+        {
+            for (int x = 0; x < size.x; x++)
+            {
+                const size_t i = (size_t)y * size.x + x;
+                const int b = (y / BLOCK_SIZE) * blocks_x + x / BLOCK_SIZE;
+                const Block &block = blocks[b];
+
+                if (b != offset_block)
+                {
+                    predictor.offsets(block.disparity, offset);
+                    offset_block = b;
+                }
+
+                for (int c = 0; c < 3; c++)
+                {
+                    int prediction = block.mode == INTRA ? intraPrediction(recon[c], c, x, y, size.x) : predictor.predict(block.mode, c, x, y, offset);
+
+                    int q;
+                    if (original)
+                    {
+                        int residual = (*original)[c][i] - prediction;
+                        q = residual >= 0 ? (residual + quality / 2) / quality : -((-residual + quality / 2) / quality);
+                        writer->rice(zigzag(q), contexts[c].k());
+                    }
+                    else
+                    {
+                        q = unzigzag(reader->rice(contexts[c].k()));
+                    }
+                    contexts[c].update(zigzag(q));
+
+                    recon[c][i] = (int16_t)glm::clamp(prediction + q * quality, CHANNEL_MIN[c], CHANNEL_MAX[c]);
+                }
+            }
+        }
+    }
+
+    std::vector<uint8_t> encodeView(const Predictor &predictor, const Planes &original, int quality, Planes &recon)
+    {
+        auto blocks = chooseBlocks(predictor, original);
+
+        BitWriter writer;
+        int last_disparity = 0;
+        for (const auto &block : blocks)
+        {
+            writer.put(block.mode, 2);
+            if (block.mode == INTRA) continue;
+            writer.rice(zigzag(block.disparity - last_disparity), 2);
+            last_disparity = block.disparity;
+        }
+
+        codeResiduals(predictor, blocks, quality, &original, &writer, nullptr, recon);
+        return writer.finish();
+    }
+
+    void decodeView(const Predictor &predictor, const uint8_t* data, size_t size, int quality, Planes &recon)
+    {
+        const glm::ivec2 num_blocks = (predictor.size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+        BitReader reader(data, size);
+        std::vector<Block> blocks((size_t)num_blocks.x * num_blocks.y);
+        int last_disparity = 0;
+        for (auto &block : blocks)
+        {
+            block.mode = (int)reader.get(2);
+            if (!predictor.available(block.mode)) throw std::runtime_error("Corrupt light field stream");
+            if (block.mode == INTRA) continue;
+            block.disparity = last_disparity + unzigzag(reader.rice(2));
+            last_disparity = block.disparity;
+        }
+
+        codeResiduals(predictor, blocks, quality, nullptr, nullptr, &reader, recon);
+    }
+
+    // Decodes all views in wavefronts, views of older wavefronts are released once they can't be referenced
+    template<typename Callback>
+    void decodeViews(const Header &header, const std::vector<uint8_t> &data, const Callback &callback)
+    {
+        const Geometry geometry = findGeometry(header);
+
+        std::vector<uint64_t> offsets(header.stream_sizes.size(), 0);
+        for (size_t v = 1; v < offsets.size(); v++) offsets[v] = offsets[v - 1] + header.stream_sizes[v - 1];
+        if (!offsets.empty() && offsets.back() + header.stream_sizes.back() > data.size())
+        {
+            throw std::runtime_error("Truncated light field file");
+        }
+
+        std::vector<Planes> recon(header.names.size());
+        auto fronts = wavefronts(header.grid_size);
+        for (size_t f = 0; f < fronts.size(); f++)
+        {
+            const auto &front = fronts[f];
+            parallelFor(front.size(), [&](size_t k)
+            {
+                int v = front[k];
+                Predictor predictor(header, geometry, recon, v);
+                decodeView(predictor, data.data() + offsets[v], header.stream_sizes[v], header.quality, recon[v]);
+                callback(v, recon[v]);
+            });
+
+            if (f > 0)
+            {
+                for (int v : fronts[f - 1]) recon[v] = Planes();
+            }
+        }
+    }
+
+    template<typename T>
+    void writeValue(std::ostream &out, T value)
+    {
+        for (size_t b = 0; b < sizeof(T); b++) out.put((char)((uint64_t)value >> (8 * b)));
+    }
+
+    template<typename T>
+    T readValue(std::istream &in)
+    {
+        uint64_t value = 0;
+        for (size_t b = 0; b < sizeof(T); b++) value |= (uint64_t)(uint8_t)in.get() << (8 * b);
+        return (T)value;
+    }
+
+    // Reads the header and returns the concatenated view streams
+    std::vector<uint8_t> readFile(const std::string &file, Header &header)
+    {
+        std::ifstream in(file, std::ios::binary);
+        if (!in) throw std::runtime_error("Unable to open " + file);
+
+        char magic[4];
+        in.read(magic, 4);
+        if (!in || !std::equal(magic, magic + 4, MAGIC)) throw std::runtime_error(file + " is not a light field file");
+
+        header.grid_size.x = readValue<uint32_t>(in);
+        header.grid_size.y = readValue<uint32_t>(in);
+        header.image_size.x = readValue<uint32_t>(in);
+        header.image_size.y = readValue<uint32_t>(in);
+        header.quality = readValue<uint32_t>(in);
+
+        if (!in || glm::any(glm::lessThan(header.grid_size, glm::ivec2(1))) || (size_t)header.grid_size.x * header.grid_size.y > MAX_VIEWS ||
+            glm::any(glm::lessThan(header.image_size, glm::ivec2(1))) || glm::any(glm::greaterThan(header.image_size, glm::ivec2(MAX_IMAGE_SIZE))) ||
+            header.quality < 1)
+        {
+            throw std::runtime_error("Invalid header in " + file);
+        }
+
+        const size_t views = (size_t)header.grid_size.x * header.grid_size.y;
+        for (size_t v = 0; v < views; v++)
+        {
+            std::string name(readValue<uint16_t>(in), '\0');
+            in.read(name.data(), name.size());
+
+            // Names are written into the output folder, so they can't contain a path
+            if (in && (name.empty() || name == "." || name == ".." || name != std::filesystem::path(name).filename().string()))
+            {
+                throw std::runtime_error("Invalid header in " + file);
+            }
+            header.names.push_back(name);
+            header.stream_sizes.push_back(readValue<uint64_t>(in));
+        }
+        if (!in) throw std::runtime_error("Truncated light field file " + file);
+
+        // The streams are the rest of the file
+        const auto streams_start = in.tellg();
+        in.seekg(0, std::ios::end);
+        const uint64_t remaining = (uint64_t)(in.tellg() - streams_start);
+        in.seekg(streams_start);
+
+        uint64_t total = 0;
+        for (uint64_t size : header.stream_sizes)
+        {
+            if (size > remaining - total) throw std::runtime_error("Stream sizes exceed the length of " + file);
+            total += size;
+        }
+
+        std::vector<uint8_t> data(total);
+        in.read(reinterpret_cast<char*>(data.data()), data.size());
+        if (!in) throw std::runtime_error("Truncated light field file " + file);
+        return data;
+    }
+
+    double seconds(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int encodeLightField(const std::string &folder, const std::string &file, int quality)
+{
+    if (quality < 1) throw std::runtime_error("Quality must be at least 1");
+
+    // Camera images by grid cell
+    std::map<std::pair<int, int>, std::filesystem::path> cells;
+    glm::ivec2 grid_size(0);
+    uintmax_t file_bytes = 0;
+    for (const auto &entry : std::filesystem::directory_iterator(folder))
+    {
+        CameraArray::FileInfo info;
+        if (!entry.is_regular_file() || !CameraArray::parseFilename(entry.path(), info)) continue;
+
+        if (!cells.emplace(std::make_pair((int)info.ij.x, (int)info.ij.y), entry.path()).second)
+        {
+            throw std::runtime_error("More than one camera at " + std::to_string(info.ij.x) + ", " + std::to_string(info.ij.y));
+        }
+        grid_size = glm::max(grid_size, glm::ivec2(info.ij) + 1);
+        file_bytes += entry.file_size();
+    }
+
+    if (cells.empty() || cells.size() != (size_t)grid_size.x * grid_size.y)
+    {
+        throw std::runtime_error(folder + " has no complete grid of cameras");
+    }
+
+    Header header;
+    header.grid_size = grid_size;
+    header.quality = quality;
+
+    std::vector<std::filesystem::path> paths;
+    for (int j = 0; j < grid_size.y; j++)
+    {
+        for (int i = 0; i < grid_size.x; i++)
+        {
+            paths.push_back(cells[{ i, j }]);
+            header.names.push_back(paths.back().filename().string());
+        }
+    }
+
+    auto first = CameraArray::decode(paths[0], CameraArray::Storage::SRGB_SHADER);
+    if (first.data.empty()) throw std::runtime_error("Unable to decode " + paths[0].string());
+    header.image_size = first.size;
+    if (glm::any(glm::greaterThan(header.image_size, glm::ivec2(MAX_IMAGE_SIZE))))
+    {
+        throw std::runtime_error("Images larger than " + std::to_string(MAX_IMAGE_SIZE) + " pixels can't be encoded");
+    }
+
+    const Geometry geometry = findGeometry(header);
+    const size_t views = paths.size();
+    const size_t pixels = (size_t)header.image_size.x * header.image_size.y;
+
+    std::vector<std::vector<uint8_t>> streams(views);
+    std::vector<Planes> recon(views);
+    double squared_error = 0.0;
+    std::mutex error_mutex;
+
+    auto start = std::chrono::steady_clock::now();
+
+    auto fronts = wavefronts(grid_size);
+    for (size_t f = 0; f < fronts.size(); f++)
+    {
+        const auto &front = fronts[f];
+        parallelFor(front.size(), [&](size_t k)
+        {
+            int v = front[k];
+            Planes original = loadPlanes(paths[v], header.image_size);
+
+            Predictor predictor(header, geometry, recon, v);
+            streams[v] = encodeView(predictor, original, quality, recon[v]);
+
+            double sum = 0.0;
+            if (quality > 1)
+            {
+                for (size_t i = 0; i < pixels; i++)
+                {
+                    glm::ivec3 a = toRGB(original[0][i], original[1][i], original[2][i]);
+                    glm::ivec3 b = toRGB(recon[v][0][i], recon[v][1][i], recon[v][2][i]);
+                    glm::ivec3 d = a - b;
+                    sum += (double)d.x * d.x + (double)d.y * d.y + (double)d.z * d.z;
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(error_mutex);
+            squared_error += sum;
+        });
+
+        if (f > 0)
+        {
+            for (int v : fronts[f - 1]) recon[v] = Planes();
+        }
+    }
+
+    double encode_time = seconds(start);
+
+    std::ofstream out(file, std::ios::binary);
+    if (!out) throw std::runtime_error("Unable to write " + file);
+
+    out.write(MAGIC, 4);
+    writeValue<uint32_t>(out, grid_size.x);
+    writeValue<uint32_t>(out, grid_size.y);
+    writeValue<uint32_t>(out, header.image_size.x);
+    writeValue<uint32_t>(out, header.image_size.y);
+    writeValue<uint32_t>(out, quality);
+
+    std::vector<uint8_t> data;
+    for (size_t v = 0; v < views; v++)
+    {
+        writeValue<uint16_t>(out, (uint16_t)header.names[v].size());
+        out.write(header.names[v].data(), header.names[v].size());
+        writeValue<uint64_t>(out, streams[v].size());
+        header.stream_sizes.push_back(streams[v].size());
+        data.insert(data.end(), streams[v].begin(), streams[v].end());
+    }
+    out.write(reinterpret_cast<const char*>(data.data()), data.size());
+    out.close();
+
+    const uintmax_t coded_bytes = std::filesystem::file_size(file);
+
+    // Decoding the streams again measures the throughput without any file output
+    start = std::chrono::steady_clock::now();
+    decodeViews(header, data, [](int, const Planes&) {});
+    double decode_time = seconds(start);
+
+    const double raw_bytes = 3.0 * pixels * views;
+    const double mse = squared_error / (raw_bytes);
+
+    std::cout << std::fixed << std::setprecision(2)
+              << "Encoded " << views << " views of " << header.image_size.x << "x" << header.image_size.y
+              << " px in " << encode_time << " s\n"
+              << "  " << coded_bytes / 1e6 << " MB, " << (double)file_bytes / coded_bytes << ":1 of the image files ("
+              << file_bytes / 1e6 << " MB), " << raw_bytes / coded_bytes << ":1 of raw RGB (" << raw_bytes / 1e6 << " MB)\n"
+              << "  PSNR " << (mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : INFINITY) << " dB\n"
+              << "  Decoded in " << decode_time << " s, " << views / decode_time << " views/s, "
+              << raw_bytes / 1e6 / decode_time << " MB/s of RGB" << std::endl;
+
+    return 0;
+}
+
+int decodeLightField(const std::string &file, const std::string &folder)
+{
+    Header header;
+    auto data = readFile(file, header);
+
+    std::filesystem::create_directories(folder);
+
+    const size_t pixels = (size_t)header.image_size.x * header.image_size.y;
+
+    auto start = std::chrono::steady_clock::now();
+
+    decodeViews(header, data, [&](int v, const Planes &planes)
+    {
+        std::vector<glm::u8vec3> bgr(pixels);
+        for (size_t i = 0; i < pixels; i++)
+        {
+            glm::u8vec3 rgb = toRGB(planes[0][i], planes[1][i], planes[2][i]);
+            bgr[i] = glm::u8vec3(rgb.b, rgb.g, rgb.r);
+        }
+
+        auto path = std::filesystem::path(folder) / std::filesystem::path(header.names[v]).replace_extension(".tga");
+        TGAWriter writer(path.string(), header.image_size);
+        writer.write(glm::ivec2(0), header.image_size, bgr);
+    });
+
+    double time = seconds(start);
+    const double raw_bytes = 3.0 * pixels * header.names.size();
+
+    std::cout << std::fixed << std::setprecision(2)
+              << "Decoded " << header.names.size() << " views to " << folder << " in " << time << " s, "
+              << header.names.size() / time << " views/s, " << raw_bytes / 1e6 / time << " MB/s of RGB" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+
+/*************************************************************************
+Storage codec for camera grids, where neighbouring views are nearly
+identical. Each view is coded as the residual against a prediction from
+the already decoded views to its left (i - 1) and below (j - 1) in the ij
+grid. The prediction is shifted along the camera baseline by a disparity
+per 16x16 block. Blocks that are occluded in both neighbours fall back to
+a spatial median predictor, which also codes the first view.
+
+Residuals are coded in YCoCg-R, which is lossless for quality 1, with an
+adaptive Rice code. Larger quality values quantize the residuals with
+that step inside the prediction loop. Views only depend on the previous
+anti-diagonal of the grid, so each diagonal is decoded in parallel.
+
+Decoded views are written as TGA images named after the original files,
+which the renderer opens like any other light field folder.
+*************************************************************************/
+
+// Encodes the camera images of a folder with one camera per grid cell into an .lfc file, prints
+// compression ratio, PSNR and decode throughput. Returns non-zero on failure.
+int encodeLightField(const std::string &folder, const std::string &file, int quality = 1);
+
+// Decodes an .lfc file into a folder of TGA images
+int decodeLightField(const std::string &file, const std::string &folder);
@@ -3,6 +3,7 @@
 #include <exception>
 #include <iostream>
 #include <fstream>
+#include <cstring>
 
 #include <nanogui/nanogui.h>
 
@@ -16,72 +17,184 @@
 #include "../shaders/data-camera-projections.vert"
 #include "../shaders/screen.vert"
 #include "../shaders/normalize-aperture-filters.frag"
+#include "../shaders/pinhole.frag"
+#include "../shaders/temporal-reprojection.frag"
+#include "../shaders/multi-view.geom"
+#include "../shaders/focal-stack.frag"
 
 #include "../shaders/autofocus/disparity.vert"
 #include "../shaders/autofocus/disparity.frag"
+#include "../shaders/autofocus/luminance.frag"
 #include "../shaders/autofocus/template-match.frag"
 #include "../shaders/autofocus/visualize-autofocus.frag"
 
 #include "config.hpp"
 #include "camera-array.hpp"
+#include "image-writer.hpp"
 #include "../gl-util/fbo.hpp"
+#include "../gl-util/layered-fbo.hpp"
+#include "focal-stack.hpp"
 #include "util.hpp"
 
 LightFieldRenderer::LightFieldRenderer(Widget* parent, const std::shared_ptr<Config> &cfg) : 
     Canvas(parent, 1, false), quad(), cfg(cfg), aperture(32),
-    draw_shader(screen_vert, normalize_aperture_filters_frag),
-    visualize_autofocus_shader(screen_vert, visualize_autofocus_frag),
-    template_match_shader(screen_vert, template_match_frag)
+    shader_cache(std::filesystem::temp_directory_path() / "light-field-renderer" / "shader-cache"),
+    view_block{}, view_ubo(sizeof(ViewBlock), VIEW_BINDING), views_ubo(MAX_VIEWS * sizeof(ViewBlock), VIEWS_BINDING)
 {
+    shader_cache.bindUniformBlock("View", VIEW_BINDING);
+    shader_cache.bindUniformBlock("Views", VIEWS_BINDING);
+
+    draw_shaders[0] = shader_cache.get(screen_vert, normalize_aperture_filters_frag);
+    draw_shaders[1] = shader_cache.get(screen_vert, normalize_aperture_filters_frag, { "NORMALIZE" });
+    layered_draw_shaders[0] = shader_cache.get(screen_vert, normalize_aperture_filters_frag, { "LAYERED" });
+    layered_draw_shaders[1] = shader_cache.get(screen_vert, normalize_aperture_filters_frag, { "LAYERED", "NORMALIZE" });
+    focal_stack_resolve_shaders[0] = shader_cache.get(screen_vert, normalize_aperture_filters_frag, { "LAYERED", "LINEAR_OUTPUT" });
+    focal_stack_resolve_shaders[1] = shader_cache.get(screen_vert, normalize_aperture_filters_frag, { "LAYERED", "NORMALIZE", "LINEAR_OUTPUT" });
+    focal_stack_shader = shader_cache.get(screen_vert, focal_stack_frag);
+    visualize_autofocus_shader = shader_cache.get(screen_vert, visualize_autofocus_frag);
+    template_match_shader = shader_cache.get(screen_vert, template_match_frag);
+    reprojection_shader = shader_cache.get(screen_vert, temporal_reprojection_frag);
+
     resize();
 }
 
 void LightFieldRenderer::draw_contents()
 {
-    if (!camera_array || !shader) return;
+    if (!camera_array || !shaders[0]) return;
+
+    // Finer levels of a progressive open change the image and the minimum aperture like a new video frame,
+    // saves wait for all of them
+    if (save_next ? camera_array->finishLoading() : camera_array->updateLoading())
+    {
+        history_valid = false;
+        if (focal_stack) focal_stack->restart();
+    }
 
     move();
+    bool view_changed = uploadView();
+
+    // A new video frame can't reuse the accumulation or focal stack of the last one
+    if (video && video->update(video_playback, cfg->video_frame_rate))
+    {
+        history_valid = false;
+        if (focal_stack) focal_stack->restart();
+    }
+
+    // Results of earlier autofocus measurements may have moved the focal plane
+    if (collectAutofocus()) view_changed |= uploadView();
 
     if (continuous_autofocus || autofocus_click || visualize_autofocus)
     {
         phaseDetectionAutofocus();
-        autofocus_click = false;
     }
 
-    if (visualize_autofocus)
+    // Focus changes of a still view are looked up in the completed focal stack
+    if (focal_stack_preview && !stereo_preview && updateFocalStack())
     {
-        fbo1->bindTexture();
-        visualize_autofocus_shader.use();
+        drawFocalStack();
+        if (visualize_autofocus) visualizeAutofocus();
+        if (save_next) saveRender();
+        return;
+    }
 
-        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
+    glm::vec3 settings(cfg->aperture_falloff, cfg->st_width, cfg->st_distance);
 
-        quad.draw();
+    // Saves are rendered at full resolution
+    updateRenderScale((view_changed || settings != last_settings) && !save_next);
 
-        if (save_next) saveRender();
+    // Only the viewpoint may change between temporal frames, anything else starts over
+    if (settings != last_settings) history_valid = false;
+    bool temporal = temporal_reprojection && view_changed && historyUsable();
+
+    last_settings = settings;
+
+    // Only one measurement in flight to never wait for the result
+    bool time_accumulation = adaptive_resolution && !timing_accumulation;
+    if (time_accumulation) accumulation_timer.begin();
+
+    if (stereo_preview)
+    {
+        accumulateStereo();
+    }
+    else
+    {
+        accumulate(temporal);
+    }
+
+    if (time_accumulation)
+    {
+        accumulation_timer.end();
+        timing_accumulation = true;
+        timed_scale = render_size.x / (float)fb_size.x;
+    }
 
+    if (stereo_preview)
+    {
+        drawStereo();
+        if (visualize_autofocus) visualizeAutofocus();
+        if (save_next) saveRender();
         return;
     }
 
-    fbo0->bind();
-    aperture.bind();
+    float max_weight_sum = normalize_aperture ? 0.0f : fbo0->getMaxAlpha();
+
+    fbo0->unBind();
+    fbo0->bindTexture();
+
+    Shader* draw_shader = draw_shaders[normalize_aperture];
+    draw_shader->use();
+
+    quad.bind();
+
+    glm::vec2 texcoord_scale = glm::vec2(fbo0->viewport_size) / glm::vec2(fbo0->size);
+    glUniform2fv(draw_shader->getLocation("texcoord_scale"), 1, &texcoord_scale[0]);
+    glUniform1f(draw_shader->getLocation("max_weight_sum"), max_weight_sum);
+    glUniform1f(draw_shader->getLocation("exposure"), std::pow(2, cfg->exposure));
+
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    quad.draw();
+
+    if (visualize_autofocus) visualizeAutofocus();
+
+    if (save_next) saveRender(fbo0.get(), max_weight_sum);
+}
+
+void LightFieldRenderer::accumulate(bool temporal)
+{
+    fbo0->bind(render_size);
 
     glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
+    if (usePinholePath())
+    {
+        accumulatePinhole();
+
+        // Weights of the pinhole path are not on the same scale as the aperture filters
+        history_valid = false;
+        return;
+    }
+
+    int first_camera = 0, camera_stride = 1;
+    if (temporal)
+    {
+        reprojectHistory();
+        first_camera = temporal_frame++ % TEMPORAL_SUBSETS;
+        camera_stride = TEMPORAL_SUBSETS;
+    }
+
+    aperture.bind();
+
     glEnable(GL_BLEND);
     glBlendEquation(GL_FUNC_ADD);
     glBlendFunc(GL_ONE, GL_ONE);
 
+    // Skip the per-fragment pow() when the falloff is linear
+    Shader* shader = shaders[std::abs(cfg->aperture_falloff - 1.0f) < 1e-3f];
     shader->use();
 
-    glUniformMatrix4fv(shader->getLocation("VP"), 1, GL_FALSE, &VP[0][0]);
-    glUniform3fv(shader->getLocation("eye"), 1, &eye[0]);
-    glUniform1f(shader->getLocation("focus_distance"), cfg->focus_distance);
-    glUniform1f(shader->getLocation("aperture_diameter"), cfg->focal_length / cfg->f_stop);
-    glUniform3fv(shader->getLocation("forward"), 1, &forward[0]);
-    glUniform3fv(shader->getLocation("right"), 1, &right[0]);
-    glUniform3fv(shader->getLocation("up"), 1, &up[0]);
     glUniform1f(shader->getLocation("aperture_falloff"), cfg->aperture_falloff);
 
     int data_eye_loc = shader->getLocation("data_eye");
@@ -89,29 +202,106 @@ void LightFieldRenderer::draw_contents()
     int st_size_loc = shader->getLocation("st_size");
     int st_distance_loc = shader->getLocation("st_distance");
 
-    for (int i = 0; i < camera_array->cameras.size(); i++)
+    for (int i = first_camera; i < camera_array->cameras.size(); i += camera_stride)
     {
         camera_array->bind(i, data_eye_loc, data_VP_loc, st_size_loc, st_distance_loc, cfg->st_width, cfg->st_distance);
         aperture.draw();
     }
 
-    float max_weight_sum = normalize_aperture ? 0.0f : fbo0->getMaxAlpha();
+    if (temporal_reprojection) storeHistory();
+}
 
-    fbo0->unBind();
-    fbo0->bindTexture();
-    draw_shader.use();
+bool LightFieldRenderer::historyUsable() const
+{
+    if (!history_valid) return false;
+
+    // Reprojection through the focal plane is only valid for the same optics
+    glm::vec4 optics(view_block.focus_distance, view_block.aperture_diameter, image_distance, cfg->sensor_width);
+    if (optics != history_optics) return false;
+
+    // Jumps, e.g. from presets or animation restarts, share too little with the last frame
+    return glm::distance(eye, history_eye) < 0.1f * view_block.focus_distance;
+}
+
+void LightFieldRenderer::reprojectHistory()
+{
+    glDisable(GL_BLEND);
+
+    history->bindTexture();
+    reprojection_shader->use();
+
+    glm::vec2 sensor_size(cfg->sensor_width, cfg->sensor_width * fb_size.y / (float)fb_size.x);
+
+    // Exponential moving average that on average holds the weights of all cameras, the same as a full frame
+    float decay = 1.0f - 1.0f / TEMPORAL_SUBSETS;
+
+    glUniform2fv(reprojection_shader->getLocation("sensor_size"), 1, &sensor_size[0]);
+    glUniform1f(reprojection_shader->getLocation("image_distance"), image_distance);
+    glUniformMatrix4fv(reprojection_shader->getLocation("history_VP"), 1, GL_FALSE, &history_VP[0][0]);
+    glUniform2fv(reprojection_shader->getLocation("history_texcoord_scale"), 1, &history_texcoord_scale[0]);
+    glUniform1f(reprojection_shader->getLocation("history_decay"), decay);
 
     quad.bind();
+    quad.draw();
+}
 
-    glUniform1f(draw_shader.getLocation("max_weight_sum"), max_weight_sum);
-    glUniform1f(draw_shader.getLocation("exposure"), std::pow(2, cfg->exposure));
+void LightFieldRenderer::storeHistory()
+{
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo0->handle);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, history->handle);
+    glBlitFramebuffer(0, 0, render_size.x, render_size.y, 0, 0, render_size.x, render_size.y, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo0->handle);
+
+    history_VP = VP;
+    history_eye = eye;
+    history_optics = glm::vec4(view_block.focus_distance, view_block.aperture_diameter, image_distance, cfg->sensor_width);
+    history_texcoord_scale = glm::vec2(fbo0->viewport_size) / glm::vec2(fbo0->size);
+    history_valid = true;
+}
 
-    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+bool LightFieldRenderer::usePinholePath() const
+{
+    if (!pinhole_fast_path || !pinhole_shader || !camera_array->grid.regular) return false;
+
+    // Each ray would otherwise reach more than the four surrounding cameras
+    const auto &step = camera_array->grid.step;
+    return view_block.aperture_diameter < std::min(glm::length(step[0]), glm::length(step[1]));
+}
+
+void LightFieldRenderer::accumulatePinhole()
+{
+    const auto &grid = camera_array->grid;
+
+    glDisable(GL_BLEND);
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, camera_array->gridTextureArray());
+    if (camera_array->ycbcr())
+    {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, camera_array->gridChromaArray());
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    pinhole_shader->use();
+
+    glm::vec2 sensor_size(cfg->sensor_width, cfg->sensor_width * fb_size.y / (float)fb_size.x);
+    glm::vec2 st_size = glm::vec2(camera_array->cameras[grid.cameras[0]].size);
+    st_size = (st_size / st_size.x) * (float)cfg->st_width;
+    glm::mat2 grid_inverse = glm::inverse(grid.step);
+
+    glUniform2fv(pinhole_shader->getLocation("sensor_size"), 1, &sensor_size[0]);
+    glUniform1f(pinhole_shader->getLocation("image_distance"), image_distance);
+    glUniform2iv(pinhole_shader->getLocation("grid_size"), 1, &grid.size[0]);
+    glUniform2fv(pinhole_shader->getLocation("grid_origin"), 1, &grid.origin[0]);
+    glUniformMatrix2fv(pinhole_shader->getLocation("grid_step"), 1, GL_FALSE, &grid.step[0][0]);
+    glUniformMatrix2fv(pinhole_shader->getLocation("grid_inverse"), 1, GL_FALSE, &grid_inverse[0][0]);
+    glUniform2fv(pinhole_shader->getLocation("st_size"), 1, &st_size[0]);
+    glUniform1f(pinhole_shader->getLocation("st_distance"), cfg->st_distance);
 
+    quad.bind();
     quad.draw();
 
-    if (save_next) saveRender();
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
 }
 
 void LightFieldRenderer::move()
@@ -168,42 +358,137 @@ void LightFieldRenderer::move()
     VP = projection * view;
 }
 
+bool LightFieldRenderer::uploadView()
+{
+    ViewBlock block{};
+    block.VP = VP;
+    block.eye = eye;
+    block.focus_distance = cfg->focus_distance;
+    block.forward = forward;
+    block.aperture_diameter = cfg->focal_length / cfg->f_stop;
+    block.right = right;
+
+    // Smaller apertures would leave gaps between the cameras loaded so far
+    if (camera_array) block.aperture_diameter = std::max(block.aperture_diameter, camera_array->minimumAperture());
+    block.up = up;
+
+    // Skip the upload if nothing has changed since last time
+    if (std::memcmp(&block, &view_block, sizeof(ViewBlock)) == 0) return false;
+
+    view_block = block;
+    view_ubo.update(&view_block);
+    return true;
+}
+
+void LightFieldRenderer::updateRenderScale(bool interacting)
+{
+    if (timing_accumulation && accumulation_timer.available())
+    {
+        // Cost of the accumulation pass is roughly proportional to the number of pixels
+        double full_time = accumulation_timer.elapsed() / (timed_scale * timed_scale);
+
+        // Leave some headroom for the normalization pass and the GUI
+        double target_time = 0.8 * 1000.0 / cfg->target_frame_rate;
+
+        float ideal_scale = (float)std::sqrt(target_time / full_time);
+        adaptive_scale = glm::clamp(glm::mix(adaptive_scale, ideal_scale, 0.5f), MIN_RENDER_SCALE, 1.0f);
+
+        timing_accumulation = false;
+    }
+
+    // Full resolution once the view is idle
+    float render_scale = adaptive_resolution && interacting ? adaptive_scale : 1.0f;
+
+    // Quantized to avoid resampling shimmer from tiny scale changes
+    render_scale = std::ceil(render_scale * 32.0f) / 32.0f;
+
+    render_size = glm::max(glm::ivec2(glm::round(glm::vec2(fb_size) * render_scale)), glm::ivec2(1));
+}
+
 void LightFieldRenderer::open()
 {
     try
     {
-        camera_array.reset();
-        camera_array = std::make_unique<CameraArray>(cfg->folder);
+        auto frames = LightFieldVideo::findFrames(cfg->folder);
+
+        // Reopening the same light field only decodes the images that changed
+        bool reopen = frames.empty() && !video && camera_array && camera_array->folder == std::filesystem::path(cfg->folder) &&
+                      camera_array->storage == texture_storage && camera_array->mipmaps == texture_mipmaps;
 
-        if (!camera_array->light_slab)
+        if (reopen)
         {
-            shader = std::make_unique<Shader>(
-                (std::string(light_field_renderer_vert) + std::string(perspective_projection)).c_str(),
-                light_field_renderer_frag
-            );
-            disparity_shader = std::make_unique<Shader>(
-                (std::string(disparity_vert) + std::string(perspective_projection)).c_str(),
-                disparity_frag
-            );
+            camera_array->reload();
         }
         else
         {
-            shader = std::make_unique<Shader>(
-                (std::string(light_field_renderer_vert) + std::string(light_slab_projection)).c_str(),
-                light_field_renderer_frag
-            );
-            disparity_shader = std::make_unique<Shader>(
-                (std::string(disparity_vert) + std::string(light_slab_projection)).c_str(),
-                disparity_frag
-            );
+            video.reset();
+            camera_array.reset();
+
+            // Videos need all cameras of the first frame before they decode the next
+            camera_array = std::make_unique<CameraArray>(frames.empty() ? std::filesystem::path(cfg->folder) : frames[0], texture_storage, 
+                                                         texture_mipmaps, frames.size() < 2);
+            if (frames.size() > 1) video = std::make_unique<LightFieldVideo>(frames, *camera_array);
         }
+
+        std::vector<std::string> defines;
+        if (camera_array->shaderGammaExpand()) defines.push_back("SRGB_TEXTURES");
+        if (camera_array->ycbcr()) defines.push_back("YCBCR_TEXTURES");
+        if (camera_array->mipmaps) defines.push_back("MIPMAPS");
+        if (camera_array->light_slab) defines.push_back("LIGHT_SLAB");
+
+        std::string vert = std::string(light_field_renderer_vert) + data_camera_projection;
+
+        shaders[0] = shader_cache.get(vert, light_field_renderer_frag, defines);
+
+        defines.push_back("LINEAR_FALLOFF");
+        shaders[1] = shader_cache.get(vert, light_field_renderer_frag, defines);
+        defines.pop_back();
+
+        defines.push_back("MULTI_VIEW");
+        multi_view_shaders[0] = shader_cache.get(vert, multi_view_geom, light_field_renderer_frag, defines);
+        defines.push_back("LINEAR_FALLOFF");
+        multi_view_shaders[1] = shader_cache.get(vert, multi_view_geom, light_field_renderer_frag, defines);
+        defines.resize(defines.size() - 2);
+
+        disparity_shader = shader_cache.get(std::string(disparity_vert) + data_camera_projection, disparity_frag, defines);
+        luminance_shader = shader_cache.get(screen_vert, luminance_frag, defines);
+
+        // The grid of a progressive open is only known once all cameras are loaded
+        pinhole_shader = camera_array->grid.regular || camera_array->loading() ? shader_cache.get(screen_vert, pinhole_frag, defines) : nullptr;
+
+        // Chroma textures of YCbCr storage are bound to the second texture unit
+        if (camera_array->ycbcr())
+        {
+            auto chromaUnit = [](Shader* shader, const char* name)
+            {
+                if (!shader) return;
+                shader->use();
+                glUniform1i(shader->getLocation(name), 1);
+            };
+            for (auto shader : shaders) chromaUnit(shader, "data_chroma");
+            for (auto shader : multi_view_shaders) chromaUnit(shader, "data_chroma");
+            chromaUnit(luminance_shader, "chroma");
+            chromaUnit(pinhole_shader, "data_chroma_images");
+        }
+
+        history_valid = false;
+
+        focal_stack.reset();
+
+        // Measurements in flight belong to the previous cameras
+        autofocus_collected = autofocus_submitted;
+        autofocus_tracking = false;
     }
     catch (const std::exception &ex)
     {
         std::cout << ex.what() << std::endl;
+        video.reset();
         camera_array.reset();
-        shader.reset();
-        disparity_shader.reset();
+        shaders = { nullptr, nullptr };
+        multi_view_shaders = { nullptr, nullptr };
+        disparity_shader = nullptr;
+        luminance_shader = nullptr;
+        pinhole_shader = nullptr;
     }
 }
 
@@ -289,57 +574,103 @@ void LightFieldRenderer::resize()
     fb_size = glm::ivec2(glm::vec2(fb_size) * screen()->pixel_ratio());
 
     fbo0 = std::make_unique<FBO>(fb_size);
-    fbo1 = std::make_unique<FBO>(fb_size);
+    history = std::make_unique<FBO>(fb_size);
+    stereo_fbo = std::make_unique<LayeredFBO>(glm::max(glm::ivec2(fb_size.x / 2, fb_size.y), glm::ivec2(1)), 2);
+    history_valid = false;
+
+    render_size = fb_size;
 }
 
 void LightFieldRenderer::saveNextRender(const std::string &filename)
 {
-    savename = std::filesystem::path(filename).replace_extension(".tga").string();
+    savename = filename;
+    if (!LinearImageWriter::supported(savename))
+    {
+        savename = std::filesystem::path(filename).replace_extension(".tga").string();
+    }
     save_next = true;
 }
 
-void LightFieldRenderer::saveRender()
+void LightFieldRenderer::saveRender(const FBO* accumulation, float max_weight_sum)
 {
     if (!save_next || savename.empty()) return;
 
-    struct HeaderTGA
+    // High bit depth output is read from the accumulation, which has to be at full resolution
+    if (LinearImageWriter::supported(savename) && accumulation && accumulation->viewport_size != fb_size) return;
+
+    save_next = false;
+    std::string filename = std::move(savename);
+
+    if (LinearImageWriter::supported(filename))
     {
-        HeaderTGA(uint16_t width, uint16_t height)
-            : width(width), height(height) {}
+        if (!accumulation)
+        {
+            std::cout << "High bit depth output is only available for light field renders" << std::endl;
+            return;
+        }
 
-    private:
-        uint8_t begin[12] = { 0, 0, 2 };
-        uint16_t width;
-        uint16_t height;
-        uint8_t end[2] = { 24, 32 };
-    };
+        // Linear accumulation is encoded on the write queue, only the readback happens here
+        glm::ivec2 size = accumulation->viewport_size;
+        std::vector<glm::vec4> pixels;
+        int prev_framebuffer;
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prev_framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, accumulation->handle);
+        accumulation->read(pixels);
+        glBindFramebuffer(GL_FRAMEBUFFER, prev_framebuffer);
+
+        float exposure = std::pow(2.0f, (float)cfg->exposure);
+        if (normalize_aperture) max_weight_sum = 0.0f;
+
+        write_queue.push([filename, size, pixels = std::move(pixels), exposure, max_weight_sum]
+        {
+            try
+            {
+                auto writer = LinearImageWriter::create(filename, size);
+                std::vector<glm::vec3> row(size.x);
+                for (int i = 0; i < size.y; i++)
+                {
+                    int y = writer->bottomUp() ? i : size.y - 1 - i;
+                    for (int x = 0; x < size.x; x++)
+                    {
+                        const auto &c = pixels[(size_t)y * size.x + x];
+                        float weight_sum = std::max(max_weight_sum, c.w);
+                        row[x] = weight_sum > 0.0f ? exposure * glm::vec3(c) / weight_sum : glm::vec3(0.0f);
+                    }
+                    writer->writeRow(row);
+                }
+                writer->finish();
+                std::cout << "Saved " << filename << std::endl;
+            }
+            catch (const std::exception &ex)
+            {
+                std::cout << ex.what() << std::endl;
+            }
+        });
+        return;
+    }
 
     int vp[4];
     glGetIntegerv(GL_VIEWPORT, vp);
 
-    // GL_RGBA is required for some reason
-    std::vector<glm::u8vec4> data(vp[2] * vp[3]);
-    glReadPixels(vp[0], vp[1], vp[2], vp[3], GL_RGBA, GL_UNSIGNED_BYTE, data.data());
+    // Rows of 3 bytes per pixel are only tightly packed with an alignment of 1
+    std::vector<glm::u8vec3> bgr((size_t)vp[2] * vp[3]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(vp[0], vp[1], vp[2], vp[3], GL_BGR, GL_UNSIGNED_BYTE, bgr.data());
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
 
-    HeaderTGA header(vp[2], vp[3]);
-
-    std::vector<glm::u8vec3> rearranged(vp[2] * vp[3]);
-    for (int y = 0; y < vp[3]; y++)
+    glm::ivec2 size(vp[2], vp[3]);
+    write_queue.push([filename, size, bgr = std::move(bgr)]
     {
-        for (int x = 0; x < vp[2]; x++)
+        try
         {
-            const auto &p = data[(vp[3] - 1 - y) * vp[2] + x];
-            rearranged[y * vp[2] + x] = { p.b, p.g, p.r };
+            TGAWriter writer(filename, size);
+            writer.write({ 0, 0 }, size, bgr);
         }
-    }
-
-    std::ofstream image_file(savename, std::ios::binary);
-    image_file.write(reinterpret_cast<char*>(&header), sizeof(header));
-    image_file.write(reinterpret_cast<char*>(rearranged.data()), rearranged.size() * 3);
-    image_file.close();
-
-    save_next = false;
-    savename = "";
+        catch (const std::exception &ex)
+        {
+            std::cout << ex.what() << std::endl;
+        }
+    });
 }
 
 void LightFieldRenderer::animate()
@@ -351,8 +682,19 @@ void LightFieldRenderer::animate()
     //float f = current_frame / num_frames;
     //current_frame = (current_frame + 1) % (int)num_frames;
 
-    float f = (float)glfwGetTime() / cfg->animation_duration;
+    View view = animationView((float)glfwGetTime() / cfg->animation_duration);
+
+    cfg->x = view.eye.x;
+    cfg->y = view.eye.y;
+    cfg->z = view.eye.z;
 
+    cfg->target_x = view.target.x;
+    cfg->target_y = view.target.y;
+    cfg->target_z = view.target.z;
+}
+
+LightFieldRenderer::View LightFieldRenderer::animationView(float f) const
+{
     float theta = glm::radians(f * 360.0f);
     float phi = glm::radians(f * std::round(cfg->animation_cycles) * 360.0f);
     glm::vec3 r = glm::vec3(camera_array->xy_size, 0.0f) / 2.0f;
@@ -360,23 +702,28 @@ void LightFieldRenderer::animate()
 
     r *= (float)cfg->animation_scale;
 
-    cfg->x = r.x * std::cos(phi) * std::sin(theta);
-    cfg->y = r.y * std::sin(phi) * std::sin(theta);
+    View view{};
+    view.eye.x = r.x * std::cos(phi) * std::sin(theta);
+    view.eye.y = r.y * std::sin(phi) * std::sin(theta);
 
-    cfg->z = r.z * std::cos(theta);
+    view.eye.z = r.z * std::cos(theta);
 
-    cfg->target_x = glm::mix((1.0f - cfg->animation_sway) * cfg->x, (float)cfg->x, (1.0f - (1.0f + std::cos(theta * 2.0f)) / 2.0f));
-    cfg->target_y = glm::mix((1.0f - cfg->animation_sway) * cfg->y, (float)cfg->y, (1.0f - (1.0f + std::cos(theta * 2.0f)) / 2.0f));
+    view.target.x = glm::mix((1.0f - cfg->animation_sway) * view.eye.x, view.eye.x, (1.0f - (1.0f + std::cos(theta * 2.0f)) / 2.0f));
+    view.target.y = glm::mix((1.0f - cfg->animation_sway) * view.eye.y, view.eye.y, (1.0f - (1.0f + std::cos(theta * 2.0f)) / 2.0f));
 
     float lim = 0.001f;
-    if (cfg->z > 0.0f)
+    if (view.eye.z > 0.0f)
     {
-        if (cfg->z < lim) cfg->z = lim;
+        if (view.eye.z < lim) view.eye.z = lim;
     }
     else
     {
-        if (cfg->z > -lim) cfg->z = -lim;
+        if (view.eye.z > -lim) view.eye.z = -lim;
     }
 
-    cfg->target_z = cfg->z - (r.z / (float)cfg->animation_scale) * 4;
+    view.target.z = view.eye.z - (r.z / (float)cfg->animation_scale) * 4;
+
+    view.focus_distance = cfg->focus_distance;
+    view.f_stop = cfg->f_stop;
+    return view;
 }
\ No newline at end of file
@@ -1,17 +1,27 @@
 #pragma once
 
 #include <filesystem>
+#include <array>
 
 #include <nanogui/canvas.h>
 
 #include <glm/glm.hpp>
 
 #include "../gl-util/shader.hpp"
+#include "../gl-util/shader-cache.hpp"
 #include "../gl-util/quad.hpp"
 #include "../gl-util/n-sided-polygon.hpp"
+#include "../gl-util/ubo.hpp"
+#include "../gl-util/timer-query.hpp"
+#include "../gl-util/pixel-readback.hpp"
+
+#include "camera-array.hpp"
+#include "light-field-video.hpp"
+#include "image-writer.hpp"
 
-class CameraArray;
 class FBO;
+class LayeredFBO;
+class FocalStack;
 class Config;
 
 class LightFieldRenderer : public nanogui::Canvas
@@ -26,6 +36,41 @@ public:
     void resize();
     void saveNextRender(const std::string& filename);
 
+    // Implemented in benchmark.cpp
+    void benchmark();
+
+    // Times 100 image focal sweeps with shift and add and Fourier slice refocusing, light slab grids only
+    void benchmarkFocalSweep();
+
+    // Compares CPU sampling of ray bundles from the Z-ordered host store and from one image per camera
+    void benchmarkHostStore();
+
+    // Implemented in tiled-render.cpp. Renders the current view at any size in tiles of 
+    // TILE_SIZE pixels that are streamed to a TGA file.
+    void renderTiled(const std::string &filename, const glm::ivec2 &output_size);
+
+    // Off-screen view, e.g. requested from the render server
+    struct View
+    {
+        glm::vec3 eye;
+        glm::vec3 target;
+        float focus_distance;
+        float f_stop;
+
+        // When frame_size is set only the region of size pixels at offset of the frame is rendered
+        glm::ivec2 frame_size = glm::ivec2(0);
+        glm::ivec2 offset = glm::ivec2(0);
+    };
+
+    // Position along the animation path, one cycle per unit of f
+    View animationView(float f) const;
+
+    // Implemented in batch-render.cpp. Renders views of the same size in multi-view passes over the 
+    // cameras and returns their linear normalized images with rows from the bottom.
+    std::vector<std::vector<glm::vec3>> renderBatch(const std::vector<View> &views, const glm::ivec2 &size);
+
+    bool loaded() const { return camera_array && shaders[0]; }
+
     virtual bool mouse_drag_event(const nanogui::Vector2i& p, const nanogui::Vector2i& rel, int button, int modifiers) override;
     virtual bool scroll_event(const nanogui::Vector2i& p, const nanogui::Vector2f& rel) override;
     virtual bool mouse_button_event(const nanogui::Vector2i &p, int button, bool down, int modifiers) override;
@@ -69,32 +114,220 @@ public:
 
     bool visualize_autofocus = false;
 
+    // View state an autofocus measurement was submitted with
+    struct AutofocusView
+    {
+        glm::vec3 eye, forward, right, up;
+        float image_distance;
+        float sensor_width;
+        float focus_distance;
+        glm::ivec2 fb_size;
+    };
+
+    // Lowers the resolution of the accumulation pass while the view changes to hold cfg->target_frame_rate
+    bool adaptive_resolution = false;
+
+    // Applied when a light field is opened
+    CameraArray::Storage texture_storage = CameraArray::Storage::SRGB_HARDWARE;
+    bool texture_mipmaps = true;
+
+    // Interpolate the four nearest cameras of regular light slab grids in a single pass when 
+    // the aperture is smaller than the camera spacing
+    bool pinhole_fast_path = true;
+
+    // Reuse the reprojected accumulation of previous frames while the view moves and only 
+    // render a rotating subset of the cameras each frame
+    bool temporal_reprojection = false;
+
+    // Side by side stereo pair separated by cfg->stereo_base, rendered in a single multi-view pass
+    bool stereo_preview = false;
+
+    // Plays light field videos at cfg->video_frame_rate, the next frame is prefetched while paused
+    bool video_playback = true;
+
+    // Renders a focal stack of the current view in the background, changing only the focus distance
+    // then interpolates between its slices instead of rendering
+    bool focal_stack_preview = false;
+
     // Used to prevent large relative movement the first click
     bool click = false;
 
 private:
-    // The following functions are implemented in phase-detect-autofocus.cpp
+    // The following functions are implemented in phase-detect-autofocus.cpp. Autofocus is pipelined,
+    // a measurement is submitted at cfg->autofocus_rate and its result is read back without waiting
+    // a frame or more later, computed from the view it was submitted with.
     void phaseDetectionAutofocus();
-    glm::vec3 pixelDirection(const glm::vec2 &px);
-    glm::vec3 pixelToFocalPlane(const glm::vec2 &px);
-    glm::vec2 pixelToCameraPlane(const glm::vec2 &px);
+    bool collectAutofocus();
+
+    // Draws the search region and template over the rendered image
+    void visualizeAutofocus();
+    unsigned int luminanceTexture(int camera);
+
+    struct AutofocusMeasurement
+    {
+        PixelReadback readback;
+        AutofocusView view;
+        glm::ivec2 af_pos;
+        std::array<glm::vec3, 2> cameras;
+        glm::ivec2 template_size;
+
+        // Lower left template positions that were searched
+        glm::ivec2 window_min, window_size;
+        bool full_search;
+    };
+
+    static constexpr int MAX_AUTOFOCUS_IN_FLIGHT = 2;
+
+    // Half size of the window searched around the predicted disparity while tracking
+    static constexpr int AUTOFOCUS_TRACK_RADIUS = 6;
+
+    // Ring of measurements, [autofocus_collected, autofocus_submitted) are in flight
+    std::array<AutofocusMeasurement, MAX_AUTOFOCUS_IN_FLIGHT> autofocus_measurements;
+    size_t autofocus_submitted = 0;
+    size_t autofocus_collected = 0;
+    double autofocus_submit_time = 0.0;
+
+    // Depth along the forward direction of the surface found by the last result
+    bool autofocus_tracking = false;
+    float autofocus_depth = 0.0f;
+    glm::ivec2 autofocus_track_pos;
+
+    // Disparity images and template match of the search region, independent of the frame size
+    std::unique_ptr<FBO> autofocus_disparity;
+    std::unique_ptr<FBO> autofocus_match;
+
     std::vector<float> sqdiff_data;
 
     std::shared_ptr<Config> cfg;
     std::unique_ptr<CameraArray> camera_array;
-    std::unique_ptr<Shader> shader;
-    std::unique_ptr<Shader> disparity_shader;
-    Shader draw_shader;
-    Shader visualize_autofocus_shader;
-    Shader template_match_shader;
+
+    // Set when the opened folder holds one light field per frame, swaps the textures of camera_array
+    std::unique_ptr<LightFieldVideo> video;
+
+    // Owns all programs, the pointers below refer to specialized permutations
+    ShaderCache shader_cache;
+
+    // Indexed by whether the aperture filter falloff is linear
+    std::array<Shader*, 2> shaders = { nullptr, nullptr };
+
+    // Indexed by normalize_aperture
+    std::array<Shader*, 2> draw_shaders = { nullptr, nullptr };
+
+    Shader* disparity_shader = nullptr;
+    Shader* luminance_shader = nullptr;
+    Shader* pinhole_shader = nullptr;
+    Shader* reprojection_shader;
+    Shader* visualize_autofocus_shader;
+    Shader* template_match_shader;
     Quad quad;
     NSidedPolygon aperture;
     std::unique_ptr<FBO> fbo0;
-    std::unique_ptr<FBO> fbo1;
+    std::unique_ptr<FBO> history;
+
+    // Per-frame view state shared by all programs that declare the View uniform block (std140 layout)
+    struct ViewBlock
+    {
+        glm::mat4 VP;
+        glm::vec3 eye;
+        float focus_distance;
+        glm::vec3 forward;
+        float aperture_diameter;
+        glm::vec3 right;
+        float pad0;
+        glm::vec3 up;
+        float pad1;
+    };
+
+    static constexpr unsigned int VIEW_BINDING = 0;
+
+    ViewBlock view_block;
+    UBO view_ubo;
+
+    // Multi-view rendering, implemented in multi-view.cpp. Every camera is bound once and its aperture is 
+    // instanced across all views, which are routed to one layer each by the geometry shader.
+    static constexpr int MAX_VIEWS = 16;
+    static constexpr unsigned int VIEWS_BINDING = 1;
+    static_assert(sizeof(ViewBlock) == 128, "ViewBlock must match the std140 array stride of the Views block");
+
+    UBO views_ubo;
 
-    void saveRender();
+    // Indexed by whether the aperture filter falloff is linear
+    std::array<Shader*, 2> multi_view_shaders = { nullptr, nullptr };
+
+    // Indexed by normalize_aperture
+    std::array<Shader*, 2> layered_draw_shaders = { nullptr, nullptr };
+
+    std::unique_ptr<LayeredFBO> stereo_fbo;
+
+    // Accumulates up to MAX_VIEWS views into the layers of fbo, which is left bound
+    void accumulateViews(const std::vector<ViewBlock> &blocks, LayeredFBO &fbo, const glm::ivec2 &size);
+    void accumulateStereo();
+    void drawStereo();
+
+    // Returns true if the view has changed since the last upload
+    bool uploadView();
+
+    // Dynamic resolution, the accumulation pass renders render_size pixels of fb_size
+    void updateRenderScale(bool interacting);
+    static constexpr float MIN_RENDER_SCALE = 0.25f;
+    glm::ivec2 render_size;
+    float adaptive_scale = 1.0f;
+    TimerQuery accumulation_timer;
+    bool timing_accumulation = false;
+    float timed_scale = 1.0f;
+    glm::vec3 last_settings = glm::vec3(0.0f);
+
+    // Renders all data cameras into fbo0, which is left bound. Temporal frames start from the 
+    // reprojected history and only render every TEMPORAL_SUBSETS camera.
+    void accumulate(bool temporal = false);
+    bool usePinholePath() const;
+    void accumulatePinhole();
+
+    // Temporal reprojection, the accumulation of the last frame is kept in history
+    bool historyUsable() const;
+    void reprojectHistory();
+    void storeHistory();
+    static constexpr int TEMPORAL_SUBSETS = 4;
+    bool history_valid = false;
+    int temporal_frame = 0;
+    glm::mat4 history_VP;
+    glm::vec3 history_eye;
+    glm::vec4 history_optics;
+    glm::vec2 history_texcoord_scale;
+
+    // Whether the aperture filter of the data camera can cover any part of the view
+    bool apertureInView(const glm::vec2 &data_eye, const ViewBlock &view) const;
+    static constexpr int TILE_SIZE = 1024;
+
+    // Implemented in batch-render.cpp
+    ViewBlock viewBlock(const View &view, const glm::ivec2 &size) const;
+    std::unique_ptr<LayeredFBO> batch_fbo;
+
+    // High bit depth formats are written from the linear accumulation, 8-bit TGA from the screen
+    void saveRender(const FBO* accumulation = nullptr, float max_weight_sum = 0.0f);
     bool save_next = false;
     std::string savename = "";
+    WriteQueue write_queue;
 
     void animate();
+
+    // Implemented in focal-stack.cpp, a few slices are rendered per frame through the multi-view path
+    static constexpr int FOCAL_STACK_BATCH = 4;
+    std::unique_ptr<FocalStack> focal_stack;
+    std::unique_ptr<LayeredFBO> focal_stack_fbo;
+
+    // Weight sums of the pending slices when the aperture isn't normalized
+    std::array<PixelReadback, FOCAL_STACK_BATCH> focal_stack_readbacks;
+    std::vector<float> focal_stack_weights;
+
+    // Indexed by normalize_aperture
+    std::array<Shader*, 2> focal_stack_resolve_shaders = { nullptr, nullptr };
+    Shader* focal_stack_shader = nullptr;
+
+    std::array<float, 16> focalStackKey() const;
+
+    // Renders the next slices once the view has been still for a frame, returns true once the stack
+    // of the current view is complete
+    bool updateFocalStack();
+    void drawFocalStack();
 };
@@ -0,0 +1,132 @@
+#include "light-field-store.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+
+#include "camera-array.hpp"
+#include "util.hpp"
+
+namespace
+{
+    constexpr int BRICK_PIXELS = LightFieldStore::TILE_SIZE * LightFieldStore::BRICK_TILES;
+    constexpr size_t BRICK_TEXELS = (size_t)BRICK_PIXELS * BRICK_PIXELS * LightFieldStore::BRICK_CAMERAS * LightFieldStore::BRICK_CAMERAS;
+
+    // Spreads the low bits of v to every other bit, starting at bit shift
+    size_t dilate(int v, int bits, int shift)
+    {
+        size_t d = 0;
+        for (int b = 0; b < bits; b++) d |= (size_t)((v >> b) & 1) << (2 * b + shift);
+        return d;
+    }
+
+    // Morton bits of a pixel coordinate inside its brick, axis 0 for x and 1 for y. The 6 bits of
+    // the pixel in its tile come first, then 2 camera bits, then the bits of the tile in the brick.
+    size_t brickIndex(int p, int axis)
+    {
+        const int pixel = p % LightFieldStore::TILE_SIZE;
+        const int tile = (p / LightFieldStore::TILE_SIZE) % LightFieldStore::BRICK_TILES;
+        return dilate(pixel, 3, axis) | dilate(tile, 2, 8 + axis);
+    }
+}
+
+LightFieldStore::LightFieldStore(const CameraArray &camera_array)
+{
+    const auto &grid = camera_array.grid;
+    if (!grid.regular) throw std::runtime_error("The light field store needs a regular camera grid");
+
+    size = camera_array.cameras[grid.cameras[0]].size;
+    grid_size = grid.size;
+    allocate();
+
+    parallelFor(grid.cameras.size(), [&](size_t cell)
+    {
+        const auto &c = camera_array.cameras[grid.cameras[cell]];
+        auto image = CameraArray::decode(camera_array.folder / c.file, CameraArray::Storage::SRGB_SHADER);
+        if (image.data.empty() || image.size != size)
+        {
+            throw std::runtime_error("Unable to load " + c.file + " into the light field store");
+        }
+
+        // Gray is replicated, a missing alpha is opaque
+        const int channels = (int)(image.data.size() / ((size_t)size.x * size.y));
+        for (int y = 0; y < size.y; y++)
+        {
+            for (int x = 0; x < size.x; x++)
+            {
+                const uint8_t* p = image.data.data() + ((size_t)y * size.x + x) * channels;
+                glm::u8vec4 &t = arena[offset((int)cell, x, y)];
+                t = channels >= 3 ? glm::u8vec4(p[0], p[1], p[2], 255) : glm::u8vec4(p[0], p[0], p[0], 255);
+                if (channels == 2 || channels == 4) t.a = p[channels - 1];
+            }
+        }
+    });
+}
+
+LightFieldStore::LightFieldStore(const std::vector<std::vector<glm::u8vec4>> &views, const glm::ivec2 &size, const glm::ivec2 &grid_size)
+    : size(size), grid_size(grid_size)
+{
+    if (views.size() != (size_t)grid_size.x * grid_size.y) throw std::runtime_error("One view per grid cell required");
+    allocate();
+
+    parallelFor(views.size(), [&](size_t cell)
+    {
+        for (int y = 0; y < size.y; y++)
+        {
+            for (int x = 0; x < size.x; x++)
+            {
+                arena[offset((int)cell, x, y)] = views[cell][(size_t)y * size.x + x];
+            }
+        }
+    });
+}
+
+void LightFieldStore::allocate()
+{
+    const glm::ivec2 bricks = (size + BRICK_PIXELS - 1) / BRICK_PIXELS;
+    const glm::ivec2 camera_bricks = (grid_size + BRICK_CAMERAS - 1) / BRICK_CAMERAS;
+
+    const size_t camera_stride = (size_t)camera_bricks.x * camera_bricks.y * BRICK_TEXELS;
+
+    x_offsets.resize(size.x);
+    for (int x = 0; x < size.x; x++)
+    {
+        x_offsets[x] = brickIndex(x, 0) + (x / BRICK_PIXELS) * camera_stride;
+    }
+
+    y_offsets.resize(size.y);
+    for (int y = 0; y < size.y; y++)
+    {
+        y_offsets[y] = brickIndex(y, 1) + (y / BRICK_PIXELS) * bricks.x * camera_stride;
+    }
+
+    cell_offsets.resize((size_t)grid_size.x * grid_size.y);
+    for (int j = 0; j < grid_size.y; j++)
+    {
+        for (int i = 0; i < grid_size.x; i++)
+        {
+            size_t camera_brick = (size_t)(j / BRICK_CAMERAS) * camera_bricks.x + i / BRICK_CAMERAS;
+            size_t camera = dilate(i % BRICK_CAMERAS, 1, 6) | dilate(j % BRICK_CAMERAS, 1, 7);
+            cell_offsets[i + j * grid_size.x] = camera + camera_brick * BRICK_TEXELS;
+        }
+    }
+
+    arena.assign(camera_stride * bricks.x * bricks.y, glm::u8vec4(0));
+}
+
+glm::vec4 LightFieldStore::sample(int cell, const glm::vec2 &st) const
+{
+    const size_t base = cell_offsets[cell];
+    return bilinear([&](int x, int y) { return arena[base + x_offsets[x] + y_offsets[y]]; }, size, st);
+}
+
+glm::vec4 LightFieldStore::sample(const glm::vec2 &uv, const glm::vec2 &st) const
+{
+    glm::vec2 p = glm::clamp(uv, glm::vec2(0.0f), glm::vec2(grid_size - 1));
+    glm::ivec2 c0 = glm::ivec2(p);
+    glm::ivec2 c1 = glm::min(c0 + 1, grid_size - 1);
+    glm::vec2 f = p - glm::vec2(c0);
+
+    glm::vec4 bottom = glm::mix(sample(c0.x + c0.y * grid_size.x, st), sample(c1.x + c0.y * grid_size.x, st), f.x);
+    glm::vec4 top = glm::mix(sample(c0.x + c1.y * grid_size.x, st), sample(c1.x + c1.y * grid_size.x, st), f.x);
+    return glm::mix(bottom, top, f.y);
+}
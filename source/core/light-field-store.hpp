@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+class CameraArray;
+
+/*************************************************************************
+Host copy of a regular camera grid for CPU side sampling of rays. All
+views are kept in one RGBA8 arena that is tiled in Z-order over pixels
+and cameras, so rays that are close in (u,v,s,t) are close in memory.
+
+Bricks of 2x2 cameras by 32x32 pixels are 16 kB each. Inside a brick, the
+bits of the Morton index are interleaved as pixel x/y within an 8x8
+tile, then camera i/j, then tile x/y, which puts the same tile of the
+four cameras into one kilobyte. Bricks follow in row-major order with
+the camera bricks innermost. The index is separable, a sum of one lookup
+per coordinate, and images are only padded to whole bricks.
+*************************************************************************/
+class LightFieldStore
+{
+public:
+    // Camera images of a regular grid are decoded from the folder of the array
+    LightFieldStore(const CameraArray &camera_array);
+
+    // RGBA views of size pixels in grid order i + j * grid_size.x, rows from the bottom
+    LightFieldStore(const std::vector<std::vector<glm::u8vec4>> &views, const glm::ivec2 &size, const glm::ivec2 &grid_size);
+
+    size_t offset(int cell, int x, int y) const { return cell_offsets[cell] + x_offsets[x] + y_offsets[y]; }
+
+    // Unchecked texel of grid cell i + j * grid_size.x
+    const glm::u8vec4 &texel(int cell, int x, int y) const { return arena[offset(cell, x, y)]; }
+
+    // Bilinear sample of a view at texture coordinates st in [0, 1], clamped to the edge
+    glm::vec4 sample(int cell, const glm::vec2 &st) const;
+
+    // Quadrilinear sample of the ray through the grid at uv in cells, from 0 to grid_size - 1
+    glm::vec4 sample(const glm::vec2 &uv, const glm::vec2 &st) const;
+
+    // Bilinear interpolation over any layout, fetch(x, y) returns the texel of clamped pixel coordinates
+    template<typename Fetch>
+    static glm::vec4 bilinear(const Fetch &fetch, const glm::ivec2 &size, const glm::vec2 &st)
+    {
+        glm::vec2 p = st * glm::vec2(size) - 0.5f;
+        glm::vec2 f = p - glm::floor(p);
+        glm::ivec2 p0 = glm::clamp(glm::ivec2(glm::floor(p)), glm::ivec2(0), size - 1);
+        glm::ivec2 p1 = glm::clamp(glm::ivec2(glm::floor(p)) + 1, glm::ivec2(0), size - 1);
+
+        glm::vec4 bottom = glm::mix(glm::vec4(fetch(p0.x, p0.y)), glm::vec4(fetch(p1.x, p0.y)), f.x);
+        glm::vec4 top = glm::mix(glm::vec4(fetch(p0.x, p1.y)), glm::vec4(fetch(p1.x, p1.y)), f.x);
+        return glm::mix(bottom, top, f.y) / 255.0f;
+    }
+
+    size_t bytes() const { return arena.size() * sizeof(glm::u8vec4); }
+
+    const glm::u8vec4* data() const { return arena.data(); }
+
+    glm::ivec2 size;
+    glm::ivec2 grid_size;
+
+    static constexpr int TILE_SIZE = 8;
+    static constexpr int BRICK_TILES = 4;
+    static constexpr int BRICK_CAMERAS = 2;
+
+private:
+    void allocate();
+
+    std::vector<glm::u8vec4> arena;
+
+    // Parts of the texel index contributed by each coordinate
+    std::vector<size_t> x_offsets, y_offsets, cell_offsets;
+};
@@ -0,0 +1,268 @@
+#include "light-field-video.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+#include <map>
+#include <cmath>
+
+#include <nanogui/opengl.h>
+
+std::vector<std::filesystem::path> LightFieldVideo::findFrames(const std::filesystem::path &folder)
+{
+    std::vector<std::filesystem::path> frame_folders;
+    if (!std::filesystem::is_directory(folder)) return frame_folders;
+
+    CameraArray::FileInfo info;
+    for (const auto &entry : std::filesystem::directory_iterator(folder))
+    {
+        // Camera images directly in the folder make it a single light field
+        if (entry.is_regular_file() && CameraArray::parseFilename(entry.path(), info)) return {};
+
+        if (!entry.is_directory()) continue;
+
+        for (const auto &file : std::filesystem::directory_iterator(entry.path()))
+        {
+            if (CameraArray::parseFilename(file.path(), info))
+            {
+                frame_folders.push_back(entry.path());
+                break;
+            }
+        }
+    }
+
+    std::sort(frame_folders.begin(), frame_folders.end());
+
+    return frame_folders;
+}
+
+LightFieldVideo::LightFieldVideo(const std::vector<std::filesystem::path> &frame_folders, CameraArray &camera_array)
+    : camera_array(camera_array)
+{
+    const auto &cameras = camera_array.cameras;
+
+    // Cameras of other frames are matched to the first frame by their indices
+    std::map<std::pair<unsigned, unsigned>, size_t> camera_index;
+    for (size_t i = 0; i < cameras.size(); i++)
+    {
+        camera_index[{ cameras[i].ij.x, cameras[i].ij.y }] = i;
+    }
+
+    if (camera_index.size() != cameras.size())
+    {
+        throw std::runtime_error("Cameras of a light field video need unique indices");
+    }
+
+    for (const auto &folder : frame_folders)
+    {
+        std::vector<std::filesystem::path> files(cameras.size());
+        size_t found = 0;
+
+        for (const auto &file : std::filesystem::directory_iterator(folder))
+        {
+            CameraArray::FileInfo info;
+            if (!CameraArray::parseFilename(file.path(), info) || info.light_slab != camera_array.light_slab) continue;
+
+            auto it = camera_index.find({ info.ij.x, info.ij.y });
+            if (it == camera_index.end() || !files[it->second].empty()) continue;
+
+            files[it->second] = file.path();
+            found++;
+        }
+
+        if (found == cameras.size())
+        {
+            frames.push_back(std::move(files));
+        }
+        else
+        {
+            std::cout << "Skipping video frame " << folder << " with " << found << " of " << cameras.size() << " cameras" << std::endl;
+        }
+    }
+
+    if (frames.size() < 2) return;
+
+    // Second texture set in the formats of the first frame
+    for (const auto &c : cameras)
+    {
+        CameraArray::Image format{};
+        format.size = c.size;
+        format.pixel_format = c.pixel_format;
+        format.pixel_type = c.pixel_type;
+        format.internal_format = c.internal_format;
+
+        unsigned int chroma_texture;
+        back_textures.push_back(camera_array.createTexture(format, chroma_texture));
+        back_chroma_textures.push_back(chroma_texture);
+        back_texture_bytes += camera_array.textureBytes(c);
+    }
+    camera_array.texture_bytes += back_texture_bytes;
+
+    images.resize(cameras.size());
+    decoded.assign(cameras.size(), false);
+
+    // Leaves a core for the render thread
+    unsigned cores = std::thread::hardware_concurrency();
+    unsigned workers = cores > 1 ? cores - 1 : 1;
+    for (unsigned i = 0; i < workers; i++)
+    {
+        threads.emplace_back([this] { decodeImages(); });
+    }
+
+    last_update = last_report = clock::now();
+
+    std::cout << "Light field video with " << frames.size() << " frames, decoding on " << workers << " threads" << std::endl;
+}
+
+LightFieldVideo::~LightFieldVideo()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    condition.notify_all();
+
+    for (auto &t : threads) t.join();
+
+    if (!back_textures.empty())
+    {
+        glDeleteTextures((GLsizei)back_textures.size(), back_textures.data());
+        glDeleteTextures((GLsizei)back_chroma_textures.size(), back_chroma_textures.data());
+        camera_array.texture_bytes -= back_texture_bytes;
+    }
+}
+
+void LightFieldVideo::decodeImages()
+{
+    while (true)
+    {
+        size_t camera;
+        std::filesystem::path file;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return stop || (decode_sequence != NONE && next_camera < images.size()); });
+            if (stop) return;
+
+            camera = next_camera++;
+            file = frames[decode_sequence % frames.size()][camera];
+        }
+
+        // Each decoding thread already has a core
+        auto image = CameraArray::decode(file, camera_array.storage, 1);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        images[camera] = std::move(image);
+        decoded[camera] = true;
+    }
+}
+
+void LightFieldVideo::startDecode(int64_t sequence)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        decode_sequence = sequence;
+        next_camera = 0;
+        decoded.assign(decoded.size(), false);
+    }
+    condition.notify_all();
+
+    uploaded = 0;
+    decode_start = clock::now();
+}
+
+bool LightFieldVideo::uploadDecoded()
+{
+    size_t bytes = 0;
+    while (uploaded < images.size() && bytes < MAX_UPLOAD_BYTES)
+    {
+        CameraArray::Image image;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!decoded[uploaded]) break;
+            image = std::move(images[uploaded]);
+        }
+
+        // A camera that doesn't match keeps the contents of an earlier frame
+        const auto &c = camera_array.cameras[uploaded];
+        if (image.size == c.size && image.pixel_type == c.pixel_type && image.internal_format == c.internal_format)
+        {
+            camera_array.updateTexture(back_textures[uploaded], back_chroma_textures[uploaded], image);
+        }
+        else
+        {
+            std::cout << "Camera " << uploaded << " of video frame " << decode_sequence % frames.size() << " doesn't match the first frame" << std::endl;
+        }
+
+        bytes += image.data.size() + image.chroma.size();
+        uploaded++;
+    }
+
+    return uploaded == images.size();
+}
+
+bool LightFieldVideo::update(bool playing, float frame_rate)
+{
+    if (frames.size() < 2) return false;
+
+    auto now = clock::now();
+
+    if (playing && !was_playing)
+    {
+        shown = skipped = 0;
+        last_report = now;
+    }
+    else if (playing)
+    {
+        position += std::chrono::duration<double>(now - last_update).count() * frame_rate;
+    }
+    was_playing = playing;
+    last_update = now;
+
+    if (decode_sequence != NONE && uploadDecoded())
+    {
+        double seconds = std::chrono::duration<double>(now - decode_start).count();
+        prefetch_seconds = prefetch_seconds > 0.0 ? prefetch_seconds + 0.25 * (seconds - prefetch_seconds) : seconds;
+
+        back_sequence = decode_sequence;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        decode_sequence = NONE;
+    }
+
+    bool swapped = false;
+    if (playing && back_sequence != NONE && position >= back_sequence)
+    {
+        camera_array.swapTextures(back_textures, back_chroma_textures);
+
+        skipped += back_sequence - front_sequence - 1;
+        front_sequence = back_sequence;
+        back_sequence = NONE;
+        shown++;
+        swapped = true;
+    }
+
+    // Prefetches the frame that is due once the prefetch is expected to be complete,
+    // skipping the frames in between if decoding can't keep up
+    if (back_sequence == NONE && decode_sequence == NONE)
+    {
+        int64_t due = (int64_t)std::floor(position + prefetch_seconds * frame_rate) + 1;
+        startDecode(std::max(front_sequence + 1, due));
+    }
+
+    double report_seconds = std::chrono::duration<double>(now - last_report).count();
+    if (playing && report_seconds >= REPORT_INTERVAL)
+    {
+        playback_rate = (float)(shown / report_seconds);
+        dropped = skipped;
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << "Video frame " << front_sequence % frames.size() << "/" << frames.size() << ", "
+                  << playback_rate << " of " << frame_rate << " fps, " << dropped << " frames dropped" << std::endl;
+
+        shown = skipped = 0;
+        last_report = now;
+    }
+
+    return swapped;
+}
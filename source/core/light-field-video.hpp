@@ -0,0 +1,90 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+
+#include "camera-array.hpp"
+
+/*************************************************************************
+Playback of a light field video, a folder with one light field folder per
+frame in name order. Camera images of the next frame are decoded on
+background threads and uploaded into a second set of textures while the
+current frame is rendered, then the textures of all cameras are swapped
+at once. Frames are numbered by a playback sequence that wraps around the
+video, frames that aren't ready when they are due are skipped.
+*************************************************************************/
+class LightFieldVideo
+{
+public:
+    // Frame folders in playback order, empty if the folder isn't a light field video
+    static std::vector<std::filesystem::path> findFrames(const std::filesystem::path &folder);
+
+    // The camera array holds the first frame and has to outlive the video
+    LightFieldVideo(const std::vector<std::filesystem::path> &frame_folders, CameraArray &camera_array);
+    ~LightFieldVideo();
+
+    // Called once per rendered frame on the OpenGL thread, returns true if the textures changed
+    bool update(bool playing, float frame_rate);
+
+    size_t frameCount() const { return frames.size(); }
+
+    // Frames shown per second and frames skipped since the last report
+    float playback_rate = 0.0f;
+    size_t dropped = 0;
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    void decodeImages();
+    void startDecode(int64_t sequence);
+
+    // Uploads decoded images to the back textures within the budget, true once the frame is complete
+    bool uploadDecoded();
+
+    CameraArray &camera_array;
+
+    // Image file of each camera of each frame
+    std::vector<std::vector<std::filesystem::path>> frames;
+
+    std::vector<unsigned int> back_textures;
+    std::vector<unsigned int> back_chroma_textures;
+    size_t back_texture_bytes = 0;
+
+    static constexpr int64_t NONE = -1;
+
+    int64_t front_sequence = 0;
+    int64_t back_sequence = NONE;
+
+    // Frame being decoded by the worker threads, images[i] is valid once decoded[i] is set
+    int64_t decode_sequence = NONE;
+    size_t next_camera = 0;
+    size_t uploaded = 0;
+    std::vector<CameraArray::Image> images;
+    std::vector<bool> decoded;
+    clock::time_point decode_start;
+
+    // Moving average of the time from the start of a decode until the frame is uploaded
+    double prefetch_seconds = 0.0;
+
+    // Limits the stall of a single rendered frame from texture uploads
+    static constexpr size_t MAX_UPLOAD_BYTES = 64u << 20;
+
+    bool stop = false;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::vector<std::thread> threads;
+
+    // Playback clock in frames of the sequence, advances with the frame rate while playing
+    double position = 0.0;
+    bool was_playing = false;
+    clock::time_point last_update;
+
+    size_t shown = 0, skipped = 0;
+    clock::time_point last_report;
+    static constexpr double REPORT_INTERVAL = 2.0;
+};
@@ -0,0 +1,118 @@
+#include "light-field-renderer.hpp"
+
+#include <nanogui/opengl.h>
+
+#include <glm/gtx/transform.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "config.hpp"
+#include "camera-array.hpp"
+#include "../gl-util/layered-fbo.hpp"
+#include "util.hpp"
+
+void LightFieldRenderer::accumulateViews(const std::vector<ViewBlock> &blocks, LayeredFBO &fbo, const glm::ivec2 &size)
+{
+    const int num_views = (int)std::min(blocks.size(), (size_t)std::min(MAX_VIEWS, fbo.layers));
+
+    views_ubo.update(blocks.data(), 0, num_views * sizeof(ViewBlock));
+    views_ubo.bind();
+
+    fbo.bind(size);
+    aperture.bind();
+
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glEnable(GL_BLEND);
+    glBlendEquation(GL_FUNC_ADD);
+    glBlendFunc(GL_ONE, GL_ONE);
+
+    Shader* shader = multi_view_shaders[std::abs(cfg->aperture_falloff - 1.0f) < 1e-3f];
+    shader->use();
+
+    glUniform1f(shader->getLocation("aperture_falloff"), cfg->aperture_falloff);
+
+    int data_eye_loc = shader->getLocation("data_eye");
+    int data_VP_loc = shader->getLocation("data_VP");
+    int st_size_loc = shader->getLocation("st_size");
+    int st_distance_loc = shader->getLocation("st_distance");
+
+    for (size_t i = 0; i < camera_array->cameras.size(); i++)
+    {
+        // Instances of views that the camera doesn't reach are clipped, cameras that reach no view are skipped
+        bool visible = false;
+        for (int v = 0; v < num_views && !visible; v++)
+        {
+            visible = apertureInView(camera_array->cameras[i].xy, blocks[v]);
+        }
+        if (!visible) continue;
+
+        camera_array->bind(i, data_eye_loc, data_VP_loc, st_size_loc, st_distance_loc, cfg->st_width, cfg->st_distance);
+        aperture.drawInstanced(num_views);
+    }
+}
+
+void LightFieldRenderer::accumulateStereo()
+{
+    const glm::ivec2 size = glm::max(glm::ivec2(render_size.x / 2, render_size.y), glm::ivec2(1));
+    const glm::mat4 projection = perspectiveProjection(image_distance, cfg->sensor_width, size);
+
+    std::vector<ViewBlock> blocks(2, view_block);
+    for (int i = 0; i < 2; i++)
+    {
+        float offset = (i == 0 ? -0.5f : 0.5f) * cfg->stereo_base;
+
+        // Off-axis projections that converge on the focal plane, where the parallax is zero
+        float shift = offset * image_distance / (cfg->focus_distance * 0.5f * cfg->sensor_width);
+
+        blocks[i].eye = eye + right * offset;
+        blocks[i].VP = glm::translate(glm::vec3(shift, 0.0f, 0.0f)) * projection * glm::lookAt(blocks[i].eye, blocks[i].eye + forward, Y_AXIS);
+    }
+
+    accumulateViews(blocks, *stereo_fbo, size);
+}
+
+void LightFieldRenderer::drawStereo()
+{
+    float max_weight_sum = 0.0f;
+    if (!normalize_aperture)
+    {
+        std::vector<glm::vec4> pixels;
+        for (int layer = 0; layer < 2; layer++)
+        {
+            stereo_fbo->read(layer, pixels);
+            for (const auto &p : pixels) max_weight_sum = std::max(max_weight_sum, p.a);
+        }
+    }
+
+    stereo_fbo->unBind();
+    stereo_fbo->bindTexture();
+
+    Shader* draw_shader = layered_draw_shaders[normalize_aperture];
+    draw_shader->use();
+
+    quad.bind();
+
+    glm::vec2 texcoord_scale = glm::vec2(stereo_fbo->viewport_size) / glm::vec2(stereo_fbo->size);
+    glUniform2fv(draw_shader->getLocation("texcoord_scale"), 1, &texcoord_scale[0]);
+    glUniform1f(draw_shader->getLocation("max_weight_sum"), max_weight_sum);
+    glUniform1f(draw_shader->getLocation("exposure"), std::pow(2, cfg->exposure));
+
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    int vp[4];
+    glGetIntegerv(GL_VIEWPORT, vp);
+
+    // Left eye on the left half
+    int half_width = vp[2] / 2;
+    for (int layer = 0; layer < 2; layer++)
+    {
+        glViewport(vp[0] + layer * half_width, vp[1], half_width, vp[3]);
+        glUniform1i(draw_shader->getLocation("layer"), layer);
+        quad.draw();
+    }
+
+    glViewport(vp[0], vp[1], vp[2], vp[3]);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
@@ -12,21 +12,79 @@
 
 glm::vec3 closestPointBetweenRays(const glm::vec3 &p0, const glm::vec3 &d0, const glm::vec3 &p1, const glm::vec3 &d1);
 
+namespace
+{
+    using AutofocusView = LightFieldRenderer::AutofocusView;
+
+    glm::vec3 pixelDirection(const AutofocusView &view, const glm::vec2 &px)
+    {
+        float x = view.sensor_width * ((px.x - (view.fb_size.x * 0.5f)) / view.fb_size.x);
+        float y = view.sensor_width * ((px.y - (view.fb_size.y * 0.5f)) / view.fb_size.x);
+
+        return glm::normalize(view.right * x + view.up * y + view.forward * view.image_distance);
+    }
+
+    // Point where the ray crosses the plane at distance along the forward direction
+    glm::vec3 rayToPlane(const AutofocusView &view, const glm::vec3 &origin, const glm::vec3 &direction, float distance)
+    {
+        return origin + direction * ((distance - glm::dot(origin - view.eye, view.forward)) / glm::dot(direction, view.forward));
+    }
+
+    glm::vec3 pixelToFocalPlane(const AutofocusView &view, const glm::vec2 &px)
+    {
+        return rayToPlane(view, view.eye, pixelDirection(view, px), view.focus_distance);
+    }
+
+    glm::vec2 pixelToCameraPlane(const AutofocusView &view, const glm::vec2 &px)
+    {
+        glm::vec3 direction = pixelDirection(view, px);
+        return glm::vec2(view.eye) + glm::vec2(direction) * (-view.eye.z / direction.z);
+    }
+
+    glm::vec2 pointToPixel(const AutofocusView &view, const glm::vec3 &p)
+    {
+        glm::vec3 d = p - view.eye;
+        glm::vec2 sensor = glm::vec2(glm::dot(d, view.right), glm::dot(d, view.up)) * (view.image_distance / glm::dot(d, view.forward));
+        return sensor * (view.fb_size.x / view.sensor_width) + glm::vec2(view.fb_size) * 0.5f;
+    }
+
+    // Disparity between the cameras at px of a surface at depth along the forward direction
+    glm::vec2 predictDisparity(const AutofocusView &view, const glm::vec3 &c0, const glm::vec3 &c1, const glm::vec2 &px, float depth)
+    {
+        glm::vec3 f0 = pixelToFocalPlane(view, px);
+        glm::vec3 surface = rayToPlane(view, c0, f0 - c0, depth);
+        glm::vec3 f1 = rayToPlane(view, c1, surface - c1, view.focus_distance);
+        return pointToPixel(view, f1) - px;
+    }
+}
+
 void LightFieldRenderer::phaseDetectionAutofocus()
 {
+    double now = glfwGetTime();
+    bool slot_free = autofocus_submitted - autofocus_collected < MAX_AUTOFOCUS_IN_FLIGHT;
+    bool due = autofocus_click || (continuous_autofocus && now - autofocus_submit_time >= 1.0 / cfg->autofocus_rate);
+    bool submit = slot_free && due;
+
+    if (!submit && !visualize_autofocus) return;
+
     const glm::ivec2 template_size((int)std::round(cfg->template_size));
     const glm::ivec2 search_size((int)std::round(cfg->template_size * cfg->search_scale));
 
     glm::ivec2 af_pos(glm::vec2(cfg->autofocus_x, cfg->autofocus_y) * glm::vec2(fb_size));
 
-    glm::clamp(af_pos, search_size / 2 + 1, fb_size - (search_size / 2 + 1));
+    af_pos = glm::clamp(af_pos, search_size / 2 + 1, fb_size - (search_size / 2 + 1));
 
     cfg->autofocus_x = af_pos.x / (float)fb_size.x;
     cfg->autofocus_y = af_pos.y / (float)fb_size.y;
 
+    AutofocusView view{ eye, forward, right, up, image_distance, cfg->sensor_width, cfg->focus_distance, fb_size };
+
     glm::ivec2 cameras;
-    cameras.x = camera_array->findClosestCamera(pixelToCameraPlane(glm::vec2(fb_size) * 0.4f));
-    cameras.y = camera_array->findClosestCamera(pixelToCameraPlane(glm::vec2(fb_size) * 0.6f), cameras.x);
+    cameras.x = camera_array->findClosestCamera(pixelToCameraPlane(view, glm::vec2(fb_size) * 0.4f));
+    cameras.y = camera_array->findClosestCamera(pixelToCameraPlane(view, glm::vec2(fb_size) * 0.6f), cameras.x);
+
+    glm::vec3 c0 = glm::vec3(camera_array->cameras[cameras.x].xy, 0.0f);
+    glm::vec3 c1 = glm::vec3(camera_array->cameras[cameras.y].xy, 0.0f);
 
     glm::ivec2 template_min(af_pos - template_size / 2);
     glm::ivec2 template_max(af_pos + template_size / 2);
@@ -34,7 +92,35 @@ void LightFieldRenderer::phaseDetectionAutofocus()
     glm::ivec2 search_min(af_pos - search_size / 2);
     glm::ivec2 search_max(af_pos + search_size / 2);
 
-    fbo1->bind();
+    // While tracking the same point only template positions close to the disparity that the last
+    // found surface would have in this view are searched
+    glm::ivec2 window_min = search_min, window_size = search_size;
+    bool full_search = true;
+    if (autofocus_tracking && !autofocus_click && af_pos == autofocus_track_pos)
+    {
+        glm::vec2 disparity = predictDisparity(view, c0, c1, glm::vec2(af_pos), autofocus_depth);
+        glm::ivec2 center(glm::round(glm::vec2(af_pos) - glm::vec2(template_size) * 0.5f - disparity));
+
+        glm::ivec2 min = center - AUTOFOCUS_TRACK_RADIUS;
+        glm::ivec2 max = center + AUTOFOCUS_TRACK_RADIUS + 1;
+        if (glm::all(glm::greaterThanEqual(min, search_min)) && glm::all(glm::lessThanEqual(max, search_max)))
+        {
+            window_min = min;
+            window_size = max - min;
+            full_search = false;
+        }
+    }
+
+    const unsigned int luminance[] = { luminanceTexture(cameras.x), luminanceTexture(cameras.y) };
+
+    // Both passes only cover the search region, in targets of its size
+    if (!autofocus_disparity || autofocus_disparity->size != search_size)
+    {
+        autofocus_disparity = std::make_unique<FBO>(search_size);
+        autofocus_match = std::make_unique<FBO>(search_size);
+    }
+
+    autofocus_disparity->bind();
 
     quad.bind();
 
@@ -45,128 +131,203 @@ void LightFieldRenderer::phaseDetectionAutofocus()
     glBlendEquation(GL_FUNC_ADD);
     glBlendFunc(GL_ONE, GL_ONE);
 
-    // Discard fragments outside of search region
-    if(!visualize_autofocus)
-        glScissor(search_min.x, search_min.y, search_size.x, search_size.y);
-
     disparity_shader->use();
 
+    glm::mat4 roi = tileProjection(glm::mat4(1.0f), fb_size, search_min, search_size);
+    glUniformMatrix4fv(disparity_shader->getLocation("roi"), 1, GL_FALSE, &roi[0][0]);
+
     // Size of visible part of focal plane
     glm::vec2 focal_plane_size = (glm::vec2(fb_size) / (float)fb_size.x) * (cfg->sensor_width / image_distance) * (float)cfg->focus_distance;
 
-    glUniformMatrix4fv(disparity_shader->getLocation("VP"), 1, GL_FALSE, &VP[0][0]);
-    glUniform3fv(disparity_shader->getLocation("eye"), 1, &eye[0]);
-    glUniform1f(disparity_shader->getLocation("focus_distance"), cfg->focus_distance);
     glUniform2fv(disparity_shader->getLocation("size"), 1, &focal_plane_size[0]);
-    glUniform3fv(disparity_shader->getLocation("forward"), 1, &forward[0]);
-    glUniform3fv(disparity_shader->getLocation("right"), 1, &right[0]);
-    glUniform3fv(disparity_shader->getLocation("up"), 1, &up[0]);
 
     int data_eye_loc = disparity_shader->getLocation("data_eye");
     int data_VP_loc = disparity_shader->getLocation("data_VP");
     int st_size_loc = disparity_shader->getLocation("st_size");
     int st_distance_loc = disparity_shader->getLocation("st_distance");
+    int channel_loc = disparity_shader->getLocation("channel");
 
     for (int i = 0; i < 2; i++)
     {
         camera_array->bind(cameras[i], data_eye_loc, data_VP_loc, st_size_loc, st_distance_loc, cfg->st_width, cfg->st_distance);
-        glUniform1i(disparity_shader->getLocation("channel"), i);
+        glBindTexture(GL_TEXTURE_2D, luminance[i]);
+        glUniform1i(channel_loc, i);
         quad.draw();
     }
     
-    fbo1->unBind();
+    autofocus_disparity->unBind();
+
+    // Template region relative to the search region
+    glm::ivec2 roi_template_min = template_min - search_min;
+    glm::ivec2 roi_template_max = template_max - search_min;
 
     if (visualize_autofocus)
     {
-        visualize_autofocus_shader.use();
+        visualize_autofocus_shader->use();
 
-        glUniform2iv(visualize_autofocus_shader.getLocation("size"), 1, &fb_size[0]);
-        glUniform2iv(visualize_autofocus_shader.getLocation("template_min"), 1, &template_min[0]);
-        glUniform2iv(visualize_autofocus_shader.getLocation("template_max"), 1, &template_max[0]);
-        glUniform2iv(visualize_autofocus_shader.getLocation("search_min"), 1, &search_min[0]);
-        glUniform2iv(visualize_autofocus_shader.getLocation("search_max"), 1, &search_max[0]);
+        glUniform2iv(visualize_autofocus_shader->getLocation("size"), 1, &fb_size[0]);
+        glUniform2iv(visualize_autofocus_shader->getLocation("template_min"), 1, &template_min[0]);
+        glUniform2iv(visualize_autofocus_shader->getLocation("template_max"), 1, &template_max[0]);
+        glUniform2iv(visualize_autofocus_shader->getLocation("search_min"), 1, &search_min[0]);
+        glUniform2iv(visualize_autofocus_shader->getLocation("search_max"), 1, &search_max[0]);
 
-        if(!(continuous_autofocus || autofocus_click)) return;
+        if (!submit) return;
     }
 
-    fbo0->bind();
+    glm::ivec2 roi_window_min = window_min - search_min;
+
+    autofocus_match->bind();
     glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
     glClear(GL_COLOR_BUFFER_BIT);
-    fbo1->bindTexture();
+    autofocus_disparity->bindTexture();
 
-    // Discard fragments outside of search region
-    glScissor(search_min.x, search_min.y, search_size.x, search_size.y);
+    // Discard fragments outside of the searched template positions
+    glScissor(roi_window_min.x, roi_window_min.y, window_size.x, window_size.y);
 
-    template_match_shader.use();
+    template_match_shader->use();
 
-    glUniform2iv(template_match_shader.getLocation("size"), 1, &fb_size[0]);
-    glUniform2iv(template_match_shader.getLocation("template_min"), 1, &template_min[0]);
-    glUniform2iv(template_match_shader.getLocation("template_max"), 1, &template_max[0]);
+    glUniform2iv(template_match_shader->getLocation("size"), 1, &search_size[0]);
+    glUniform2iv(template_match_shader->getLocation("template_min"), 1, &roi_template_min[0]);
+    glUniform2iv(template_match_shader->getLocation("template_max"), 1, &roi_template_max[0]);
 
     quad.draw();
 
-    if (sqdiff_data.size() != search_size.x * search_size.y)
-    {
-        sqdiff_data.resize(search_size.x * search_size.y);
-    }
-    glReadPixels(search_min.x, search_min.y, search_size.x, search_size.y, GL_RED, GL_FLOAT, sqdiff_data.data());
-    fbo0->unBind();
+    auto &m = autofocus_measurements[autofocus_submitted % MAX_AUTOFOCUS_IN_FLIGHT];
+    m.readback.read(roi_window_min.x, roi_window_min.y, window_size.x, window_size.y);
+    autofocus_match->unBind();
+
+    m.view = view;
+    m.af_pos = af_pos;
+    m.cameras = { c0, c1 };
+    m.template_size = template_size;
+    m.window_min = window_min;
+    m.window_size = window_size;
+    m.full_search = full_search;
+
+    autofocus_submitted++;
+    autofocus_submit_time = now;
+    autofocus_click = false;
+}
+
+bool LightFieldRenderer::collectAutofocus()
+{
+    bool focused = false;
 
-    glm::vec2 best;
-    float min_diff = std::numeric_limits<float>::max();
-    for (int x = 0; x < search_size.x; x++)
+    while (autofocus_collected < autofocus_submitted)
     {
-        for (int y = 0; y < search_size.y; y++)
+        auto &m = autofocus_measurements[autofocus_collected % MAX_AUTOFOCUS_IN_FLIGHT];
+        if (!m.readback.available()) break;
+
+        m.readback.get(sqdiff_data);
+        autofocus_collected++;
+
+        glm::ivec2 best(0);
+        float min_diff = std::numeric_limits<float>::max();
+        for (int y = 0; y < m.window_size.y; y++)
         {
-            float diff = sqdiff_data[x + y * search_size.y];
-            if (diff < min_diff)
+            for (int x = 0; x < m.window_size.x; x++)
             {
-                min_diff = diff;
-                best = { x, y };
+                float diff = sqdiff_data[x + y * m.window_size.x];
+                if (diff < min_diff)
+                {
+                    min_diff = diff;
+                    best = { x, y };
+                }
             }
         }
-    }
 
-    best += glm::vec2(template_size) * 0.5f;
+        // The minimum of a narrow window on its border may lie outside of it, searches everything next
+        bool on_border = glm::any(glm::equal(best, glm::ivec2(0))) || glm::any(glm::equal(best, m.window_size - 1));
+        if (!m.full_search && on_border)
+        {
+            autofocus_tracking = false;
+            autofocus_submit_time = 0.0;
+            continue;
+        }
 
-    glm::vec2 pixel_phase_difference = (glm::vec2(search_size) * 0.5f) - best;
+        glm::vec2 pixel_phase_difference = glm::vec2(m.af_pos) - (glm::vec2(m.window_min + best) + glm::vec2(m.template_size) * 0.5f);
 
-    // Pixels projected to focal plane
-    glm::vec3 f0 = pixelToFocalPlane(glm::vec2(af_pos));
-    glm::vec3 f1 = pixelToFocalPlane(glm::vec2(af_pos) + pixel_phase_difference);
+        // Pixels projected to focal plane
+        glm::vec3 f0 = pixelToFocalPlane(m.view, glm::vec2(m.af_pos));
+        glm::vec3 f1 = pixelToFocalPlane(m.view, glm::vec2(m.af_pos) + pixel_phase_difference);
 
-    // Camera positions
-    glm::vec3 c0 = glm::vec3(camera_array->cameras[cameras.x].xy, 0.0f);
-    glm::vec3 c1 = glm::vec3(camera_array->cameras[cameras.y].xy, 0.0f);
+        // Directions from cameras to points on focal plane
+        glm::vec3 d0 = glm::normalize(f0 - m.cameras[0]);
+        glm::vec3 d1 = glm::normalize(f1 - m.cameras[1]);
 
-    // Directions from cameras to points on focal plane
-    glm::vec3 d0 = glm::normalize(f0 - c0);
-    glm::vec3 d1 = glm::normalize(f1 - c1);
+        // Point on new focal plane
+        glm::vec3 nf = closestPointBetweenRays(m.cameras[0], d0, m.cameras[1], d1);
 
-    // Point on new focal plane
-    glm::vec3 nf = closestPointBetweenRays(c0, d0, c1, d1);
+        // Relative to the current view, which may have moved since the measurement was submitted
+        cfg->focus_distance = glm::dot(nf - eye, forward);
 
-    cfg->focus_distance = glm::dot(nf - eye, forward);
+        autofocus_tracking = true;
+        autofocus_depth = cfg->focus_distance;
+        autofocus_track_pos = m.af_pos;
+        focused = true;
+    }
+
+    return focused;
 }
 
-glm::vec3 LightFieldRenderer::pixelDirection(const glm::vec2 &px)
+void LightFieldRenderer::visualizeAutofocus()
 {
-    float x = (float)cfg->sensor_width * ((px.x - (fb_size.x * 0.5f)) / fb_size.x);
-    float y = (float)cfg->sensor_width * ((px.y - (fb_size.y * 0.5f)) / fb_size.x);
+    if (!autofocus_disparity) return;
 
-    return glm::normalize(right * x + up * y + forward * image_distance);
-}
+    glDisable(GL_BLEND);
 
-glm::vec3 LightFieldRenderer::pixelToFocalPlane(const glm::vec2 &px)
-{
-    glm::vec3 direction = pixelDirection(px);
-    return eye + direction * ((float)cfg->focus_distance / glm::dot(direction, forward));
+    autofocus_disparity->bindTexture();
+    visualize_autofocus_shader->use();
+
+    quad.bind();
+    quad.draw();
 }
 
-glm::vec2 LightFieldRenderer::pixelToCameraPlane(const glm::vec2 &px)
+unsigned int LightFieldRenderer::luminanceTexture(int camera)
 {
-    glm::vec3 direction = pixelDirection(px);
-    return glm::vec2(eye) + glm::vec2(direction) * (-eye.z / direction.z);
+    const auto &c = camera_array->cameras[camera];
+    if (c.luminance_texture) return c.luminance_texture;
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, c.size.x, c.size.y, 0, GL_RED, GL_HALF_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    GLint prev_framebuffer, prev_viewport[4];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &prev_framebuffer);
+    glGetIntegerv(GL_VIEWPORT, prev_viewport);
+    GLboolean scissor = glIsEnabled(GL_SCISSOR_TEST);
+
+    // Temporary framebuffer, this only happens once per camera image
+    GLuint framebuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+
+    glViewport(0, 0, c.size.x, c.size.y);
+    glDisable(GL_SCISSOR_TEST);
+    glDisable(GL_BLEND);
+
+    camera_array->bindTextures(camera);
+    luminance_shader->use();
+    quad.bind();
+    quad.draw();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, prev_framebuffer);
+    glDeleteFramebuffers(1, &framebuffer);
+    glViewport(prev_viewport[0], prev_viewport[1], prev_viewport[2], prev_viewport[3]);
+    if (scissor) glEnable(GL_SCISSOR_TEST);
+
+    // Coarse levels for minified sampling
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    camera_array->setLuminanceTexture(camera, texture);
+    return texture;
 }
 
 // ray0(s) = p0 + d0 * s
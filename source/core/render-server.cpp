@@ -0,0 +1,340 @@
+#include "render-server.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <map>
+#include <cstring>
+
+#include <nanogui/opengl.h>
+
+#include "config.hpp"
+#include "image-writer.hpp"
+
+RenderServer::RenderServer(const std::string &light_field, uint16_t port, bool all_interfaces) :
+    cfg(std::make_shared<Config>()), http_server(port, all_interfaces)
+{
+    // Never shown, only provides the OpenGL context
+    screen = new nanogui::Screen(nanogui::Vector2i(64, 64), "Light Field Renderer Server", false, false, false, false, false, 3U, 3U);
+
+    cfg->open(light_field);
+
+    renderer = new LightFieldRenderer(screen, cfg);
+    renderer->navigation = LightFieldRenderer::Navigation::TARGET;
+    renderer->open();
+
+    if (!renderer->loaded())
+    {
+        throw std::runtime_error("Unable to load light field " + light_field);
+    }
+
+    std::map<std::string, std::string> view = {
+        { "x", std::to_string(cfg->x) }, { "y", std::to_string(cfg->y) }, { "z", std::to_string(cfg->z) },
+        { "tx", std::to_string(cfg->target_x) }, { "ty", std::to_string(cfg->target_y) }, { "tz", std::to_string(cfg->target_z) },
+        { "focus", std::to_string(cfg->focus_distance) }, { "fstop", std::to_string(cfg->f_stop) },
+        { "width", std::to_string((int)cfg->width) }, { "height", std::to_string((int)cfg->height) }
+    };
+    default_view = http::encodeQuery(view);
+
+    http_thread = std::thread([this] { http_server.serve([this](const http::Request &r) { return handle(r); }); });
+
+    std::cout << "Serving " << cfg->folder << " on " << (all_interfaces ? "all interfaces" : "localhost") << ", port " << port << std::endl;
+}
+
+RenderServer::~RenderServer()
+{
+    http_server.stop();
+    if (http_thread.joinable()) http_thread.join();
+}
+
+http::Response RenderServer::handle(const http::Request &request)
+{
+    http::Response response;
+
+    if (request.path == "/view")
+    {
+        response.body = default_view;
+        return response;
+    }
+
+    if (request.path != "/render")
+    {
+        response.status = 404;
+        return response;
+    }
+
+    auto defaults = http::decodeQuery(default_view);
+    auto param = [&](const std::string &name)
+    {
+        auto it = request.query.find(name);
+        return std::stof(it != request.query.end() ? it->second : defaults.at(name));
+    };
+
+    auto job = std::make_shared<Job>();
+    std::string format;
+    try
+    {
+        if (request.query.count("animation"))
+        {
+            auto animation = renderer->animationView(param("animation"));
+            defaults["x"] = std::to_string(animation.eye.x);
+            defaults["y"] = std::to_string(animation.eye.y);
+            defaults["z"] = std::to_string(animation.eye.z);
+            defaults["tx"] = std::to_string(animation.target.x);
+            defaults["ty"] = std::to_string(animation.target.y);
+            defaults["tz"] = std::to_string(animation.target.z);
+        }
+
+        job->view.eye = glm::vec3(param("x"), param("y"), param("z"));
+        job->view.target = glm::vec3(param("tx"), param("ty"), param("tz"));
+
+        // Clamped to the ranges of the light field
+        Config::Property focus = cfg->focus_distance, f_stop = cfg->f_stop;
+        focus = param("focus");
+        f_stop = param("fstop");
+        job->view.focus_distance = focus;
+        job->view.f_stop = f_stop;
+
+        job->size = glm::ivec2(param("width"), param("height"));
+
+        if (request.query.count("frame_width") || request.query.count("frame_height"))
+        {
+            defaults["tile_x"] = defaults["tile_y"] = "0";
+            job->view.frame_size = glm::ivec2(param("frame_width"), param("frame_height"));
+            job->view.offset = glm::ivec2(param("tile_x"), param("tile_y"));
+        }
+
+        auto it = request.query.find("format");
+        format = "." + (it != request.query.end() ? it->second : std::string("png"));
+    }
+    catch (const std::exception &)
+    {
+        response.status = 400;
+        response.body = "Invalid parameters";
+        return response;
+    }
+
+    if (job->size.x < 1 || job->size.y < 1 || (size_t)job->size.x * job->size.y > MAX_BATCH_PIXELS ||
+        glm::distance(job->view.eye, job->view.target) <= 0.0f || !LinearImageWriter::supported(format) ||
+        glm::any(glm::lessThan(job->view.offset, glm::ivec2(0))) || 
+        (job->view.frame_size != glm::ivec2(0) && glm::any(glm::greaterThan(job->view.offset + job->size, job->view.frame_size))))
+    {
+        response.status = 400;
+        response.body = "Invalid view, size or format";
+        return response;
+    }
+
+    auto result = job->result.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(job);
+    }
+    condition.notify_one();
+
+    auto image = result.get();
+
+    std::ostringstream encoded;
+    auto writer = LinearImageWriter::create(encoded, format, job->size);
+    std::vector<glm::vec3> row(job->size.x);
+    for (int i = 0; i < job->size.y; i++)
+    {
+        int y = writer->bottomUp() ? i : job->size.y - 1 - i;
+        std::copy_n(image->begin() + (size_t)y * job->size.x, job->size.x, row.begin());
+        writer->writeRow(row);
+    }
+    writer->finish();
+
+    response.content_type = format == ".png" ? "image/png" : format == ".pfm" ? "image/x-portable-floatmap" : "image/x-portable-pixmap";
+    response.body = encoded.str();
+    return response;
+}
+
+void RenderServer::run()
+{
+    using clock = std::chrono::steady_clock;
+
+    size_t served = 0, batches = 0;
+    double render_ms = 0.0;
+    auto last_report = clock::now();
+
+    while (true)
+    {
+        std::vector<std::shared_ptr<Job>> jobs;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return !queue.empty(); });
+
+            // Give concurrent clients a moment to join the batch
+            lock.unlock();
+            std::this_thread::sleep_for(std::chrono::milliseconds(BATCH_WINDOW_MS));
+            lock.lock();
+
+            jobs.assign(queue.begin(), queue.end());
+            queue.clear();
+        }
+
+        auto start = clock::now();
+
+        // Compatible views share the image size
+        std::stable_sort(jobs.begin(), jobs.end(), [](const auto &a, const auto &b)
+        {
+            return std::make_pair(a->size.x, a->size.y) < std::make_pair(b->size.x, b->size.y);
+        });
+
+        for (size_t begin = 0; begin < jobs.size();)
+        {
+            size_t end = begin + 1;
+            size_t pixels_per_view = (size_t)jobs[begin]->size.x * jobs[begin]->size.y;
+            while (end < jobs.size() && jobs[end]->size == jobs[begin]->size && (end - begin + 1) * pixels_per_view <= MAX_BATCH_PIXELS)
+            {
+                end++;
+            }
+
+            std::vector<std::shared_ptr<Job>> batch(jobs.begin() + begin, jobs.begin() + end);
+            renderJobs(batch);
+
+            served += batch.size();
+            batches++;
+            begin = end;
+        }
+
+        render_ms += std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+        if (clock::now() - last_report > std::chrono::seconds(5))
+        {
+            std::cout << std::fixed << std::setprecision(2)
+                      << "Served " << served << " requests in " << batches << " batches, "
+                      << (double)served / batches << " requests per batch, "
+                      << render_ms / batches << " ms per batch" << std::endl;
+
+            served = batches = 0;
+            render_ms = 0.0;
+            last_report = clock::now();
+        }
+    }
+}
+
+void RenderServer::renderJobs(std::vector<std::shared_ptr<Job>> &jobs)
+{
+    // Identical views are only rendered once
+    std::vector<LightFieldRenderer::View> views;
+    std::vector<size_t> view_index(jobs.size());
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        const auto &v = jobs[i]->view;
+        auto it = std::find_if(views.begin(), views.end(), [&](const LightFieldRenderer::View &u)
+        {
+            return std::memcmp(&u, &v, sizeof(LightFieldRenderer::View)) == 0;
+        });
+        view_index[i] = it - views.begin();
+        if (it == views.end()) views.push_back(v);
+    }
+
+    try
+    {
+        auto images = renderer->renderBatch(views, jobs[0]->size);
+
+        std::vector<std::shared_ptr<const std::vector<glm::vec3>>> shared(images.size());
+        for (size_t v = 0; v < images.size(); v++)
+        {
+            shared[v] = std::make_shared<const std::vector<glm::vec3>>(std::move(images[v]));
+        }
+
+        for (size_t i = 0; i < jobs.size(); i++)
+        {
+            jobs[i]->result.set_value(shared[view_index[i]]);
+        }
+    }
+    catch (...)
+    {
+        for (auto &job : jobs)
+        {
+            job->result.set_exception(std::current_exception());
+        }
+    }
+}
+
+int benchClient(const std::string &host, uint16_t port, int clients, int requests, const glm::ivec2 &size)
+{
+    using clock = std::chrono::steady_clock;
+
+    auto view = http::decodeQuery(http::get(host, port, "/view").body);
+    glm::vec3 eye(std::stof(view["x"]), std::stof(view["y"]), std::stof(view["z"]));
+    glm::vec3 target(std::stof(view["tx"]), std::stof(view["ty"]), std::stof(view["tz"]));
+
+    view["width"] = std::to_string(size.x);
+    view["height"] = std::to_string(size.y);
+
+    // A small set of distinct views so that some concurrent requests are identical
+    constexpr int DISTINCT_VIEWS = 16;
+    float spread = 0.05f * glm::distance(eye, target);
+
+    std::vector<std::vector<double>> latencies(clients);
+    std::vector<size_t> bytes(clients, 0), failures(clients, 0);
+
+    auto start = clock::now();
+
+    std::vector<std::thread> threads;
+    for (int c = 0; c < clients; c++)
+    {
+        threads.emplace_back([&, c]
+        {
+            std::mt19937 rng(c);
+            auto query = view;
+            for (int r = c; r < requests; r += clients)
+            {
+                int v = rng() % DISTINCT_VIEWS;
+                float angle = v * 6.2831853f / DISTINCT_VIEWS;
+                query["x"] = std::to_string(eye.x + spread * std::cos(angle));
+                query["y"] = std::to_string(eye.y + spread * std::sin(angle));
+
+                auto request_start = clock::now();
+                try
+                {
+                    auto response = http::get(host, port, "/render?" + http::encodeQuery(query));
+                    if (response.status != 200) failures[c]++;
+                    bytes[c] += response.body.size();
+                }
+                catch (const std::exception &)
+                {
+                    failures[c]++;
+                }
+                latencies[c].push_back(std::chrono::duration<double, std::milli>(clock::now() - request_start).count());
+            }
+        });
+    }
+
+    for (auto &t : threads) t.join();
+
+    double seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+    std::vector<double> all;
+    size_t total_bytes = 0, total_failures = 0;
+    for (int c = 0; c < clients; c++)
+    {
+        all.insert(all.end(), latencies[c].begin(), latencies[c].end());
+        total_bytes += bytes[c];
+        total_failures += failures[c];
+    }
+
+    if (all.empty()) return 1;
+
+    std::sort(all.begin(), all.end());
+    auto percentile = [&](double p) { return all[std::min(all.size() - 1, (size_t)(p * all.size()))]; };
+
+    double mean = 0.0;
+    for (double l : all) mean += l;
+    mean /= all.size();
+
+    std::cout << std::fixed << std::setprecision(2)
+              << all.size() << " requests of " << size.x << "x" << size.y << " from " << clients << " clients in " << seconds << " s, "
+              << total_failures << " failed\n"
+              << "Throughput: " << all.size() / seconds << " requests/s, " << total_bytes / seconds / (1 << 20) << " MiB/s\n"
+              << "Latency (ms): mean " << mean << ", p50 " << percentile(0.5) << ", p90 " << percentile(0.9) 
+              << ", p99 " << percentile(0.99) << ", max " << all.back() << std::endl;
+
+    return total_failures ? 1 : 0;
+}
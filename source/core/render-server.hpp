@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <thread>
+
+#include <nanogui/nanogui.h>
+
+#include "light-field-renderer.hpp"
+#include "http.hpp"
+
+class Config;
+
+/*************************************************************************
+Serves rendered views over HTTP from a hidden window. Requests are queued
+by the connection threads and rendered on the OpenGL thread, where views
+of the same size are batched into shared passes and identical views are 
+rendered once. Images are encoded on the connection threads.
+
+  GET /render?x=&y=&z=&tx=&ty=&tz=&focus=&fstop=&width=&height=&format=
+      Eye (x, y, z), target (tx, ty, tz), focus distance, f-stop, image 
+      size and format (png, ppm or pfm). Omitted parameters are taken 
+      from the configuration of the light field.
+
+      animation=       Position along the animation path of the light 
+                       field, one cycle per unit, replaces the default 
+                       eye and target.
+      frame_width=&frame_height=&tile_x=&tile_y=
+                       Renders only the width x height pixels at 
+                       (tile_x, tile_y) from the bottom left of a larger 
+                       frame, for distributed rendering.
+
+  GET /view
+      The default view of the light field as a /render query.
+*************************************************************************/
+class RenderServer
+{
+public:
+    // Only local clients can connect unless all interfaces are requested
+    RenderServer(const std::string &light_field, uint16_t port, bool all_interfaces = false);
+    ~RenderServer();
+
+    // Renders queued requests until the process is terminated
+    void run();
+
+private:
+    struct Job
+    {
+        LightFieldRenderer::View view;
+        glm::ivec2 size;
+        std::promise<std::shared_ptr<const std::vector<glm::vec3>>> result;
+    };
+
+    http::Response handle(const http::Request &request);
+    void renderJobs(std::vector<std::shared_ptr<Job>> &jobs);
+
+    std::shared_ptr<Config> cfg;
+    nanogui::ref<nanogui::Screen> screen;
+    LightFieldRenderer* renderer;
+
+    std::string default_view;
+
+    std::deque<std::shared_ptr<Job>> queue;
+    std::mutex mutex;
+    std::condition_variable condition;
+
+    // Time to wait for more requests after the first one to form larger batches
+    static constexpr int BATCH_WINDOW_MS = 2;
+    static constexpr size_t MAX_BATCH_PIXELS = 8u << 20;
+
+    http::Server http_server;
+    std::thread http_thread;
+};
+
+// Issues requests from concurrent clients to a running server and prints throughput and latency
+int benchClient(const std::string &host, uint16_t port, int clients, int requests, const glm::ivec2 &size);
@@ -0,0 +1,194 @@
+#include "light-field-renderer.hpp"
+
+#include <iostream>
+#include <functional>
+#include <limits>
+
+#include <nanogui/opengl.h>
+
+#include <glm/gtx/transform.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include "config.hpp"
+#include "camera-array.hpp"
+#include "focal-stack.hpp"
+#include "image-writer.hpp"
+#include "../gl-util/fbo.hpp"
+#include "util.hpp"
+
+bool LightFieldRenderer::apertureInView(const glm::vec2 &data_eye, const ViewBlock &view) const
+{
+    // Octagon circumscribing the aperture, its projection contains the projected aperture filter
+    constexpr int N = 8;
+    const float radius = 0.5f * view.aperture_diameter / std::cos(glm::pi<float>() / N);
+
+    glm::vec2 min(std::numeric_limits<float>::max()), max(std::numeric_limits<float>::lowest());
+
+    for (int i = 0; i < N; i++)
+    {
+        float theta = i * glm::two_pi<float>() / N;
+        glm::vec3 aperture = view.eye - (std::cos(theta) * view.right + std::sin(theta) * view.up) * radius;
+
+        // Same projection as light-field-renderer.vert
+        glm::vec3 a2d = glm::vec3(data_eye, 0.0f) - aperture;
+        float a2d_forward = glm::dot(a2d, view.forward);
+        if (std::abs(a2d_forward) < 1e-6f) return true;
+
+        glm::vec3 focal_point = aperture + a2d * (view.focus_distance / a2d_forward);
+        glm::vec3 e2p = glm::normalize(focal_point - view.eye);
+        if (e2p.z >= 0.0f) return true;
+
+        glm::vec4 clip = view.VP * glm::vec4(glm::vec2(view.eye) + glm::vec2(e2p) * (-1.0f / e2p.z), view.eye.z - 1.0f, 1.0f);
+        if (clip.w <= 0.0f) return true;
+
+        glm::vec2 ndc = glm::vec2(clip) / clip.w;
+        min = glm::min(min, ndc);
+        max = glm::max(max, ndc);
+    }
+
+    return max.x >= -1.0f && min.x <= 1.0f && max.y >= -1.0f && min.y <= 1.0f;
+}
+
+void LightFieldRenderer::renderTiled(const std::string &filename, const glm::ivec2 &output_size)
+{
+    if (!camera_array || !shaders[0]) return;
+
+    // Tiles use all cameras of a progressive open, and the aperture is no longer widened to cover the coarse levels
+    if (camera_array->finishLoading())
+    {
+        history_valid = false;
+        if (focal_stack) focal_stack->restart();
+    }
+    uploadView();
+
+    // Tiles replace the view, the screen view is restored even if rendering fails
+    struct RestoreView
+    {
+        LightFieldRenderer &renderer;
+        const glm::mat4 VP;
+        ~RestoreView()
+        {
+            renderer.VP = VP;
+            renderer.uploadView();
+        }
+    } restore_view{ *this, VP };
+
+    try
+    {
+        TGAWriter writer(filename, output_size);
+
+        FBO accumulation{ glm::ivec2(TILE_SIZE) };
+        FBO output{ glm::ivec2(TILE_SIZE) };
+
+        const glm::mat4 view = glm::lookAt(eye, eye + forward, Y_AXIS);
+        const glm::mat4 projection = perspectiveProjection(image_distance, cfg->sensor_width, output_size);
+
+        const glm::ivec2 num_tiles = (output_size + TILE_SIZE - 1) / TILE_SIZE;
+
+        Shader* shader = shaders[std::abs(cfg->aperture_falloff - 1.0f) < 1e-3f];
+        int data_eye_loc = shader->getLocation("data_eye");
+        int data_VP_loc = shader->getLocation("data_VP");
+        int st_size_loc = shader->getLocation("st_size");
+        int st_distance_loc = shader->getLocation("st_distance");
+
+        size_t cameras_drawn = 0;
+
+        // Accumulates the cameras that reach the tile into the accumulation FBO, which is left bound
+        auto accumulateTile = [&](const glm::ivec2 &offset, const glm::ivec2 &region)
+        {
+            VP = tileProjection(projection, output_size, offset, region) * view;
+            uploadView();
+
+            accumulation.bind(region);
+            aperture.bind();
+
+            glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            glEnable(GL_BLEND);
+            glBlendEquation(GL_FUNC_ADD);
+            glBlendFunc(GL_ONE, GL_ONE);
+
+            shader->use();
+            glUniform1f(shader->getLocation("aperture_falloff"), cfg->aperture_falloff);
+
+            for (size_t i = 0; i < camera_array->cameras.size(); i++)
+            {
+                if (!apertureInView(camera_array->cameras[i].xy, view_block)) continue;
+
+                camera_array->bind(i, data_eye_loc, data_VP_loc, st_size_loc, st_distance_loc, cfg->st_width, cfg->st_distance);
+                aperture.draw();
+                cameras_drawn++;
+            }
+        };
+
+        auto forEachTile = [&](const std::function<void(const glm::ivec2&, const glm::ivec2&)> &f)
+        {
+            for (int y = 0; y < num_tiles.y; y++)
+            {
+                for (int x = 0; x < num_tiles.x; x++)
+                {
+                    glm::ivec2 offset = glm::ivec2(x, y) * TILE_SIZE;
+                    f(offset, glm::min(output_size - offset, glm::ivec2(TILE_SIZE)));
+                }
+            }
+        };
+
+        // Without per-pixel normalization all tiles have to share the maximum weight sum of the whole image
+        float max_weight_sum = 0.0f;
+        if (!normalize_aperture)
+        {
+            forEachTile([&](const glm::ivec2 &offset, const glm::ivec2 &region)
+            {
+                accumulateTile(offset, region);
+                max_weight_sum = std::max(max_weight_sum, accumulation.getMaxAlpha());
+                accumulation.unBind();
+            });
+        }
+
+        std::vector<glm::u8vec3> bgr((size_t)TILE_SIZE * TILE_SIZE);
+
+        cameras_drawn = 0;
+        int tile = 0;
+        forEachTile([&](const glm::ivec2 &offset, const glm::ivec2 &region)
+        {
+            accumulateTile(offset, region);
+            accumulation.unBind();
+
+            output.bind(region);
+            accumulation.bindTexture();
+
+            Shader* draw_shader = draw_shaders[normalize_aperture];
+            draw_shader->use();
+
+            quad.bind();
+
+            glm::vec2 texcoord_scale = glm::vec2(region) / glm::vec2(accumulation.size);
+            glUniform2fv(draw_shader->getLocation("texcoord_scale"), 1, &texcoord_scale[0]);
+            glUniform1f(draw_shader->getLocation("max_weight_sum"), max_weight_sum);
+            glUniform1f(draw_shader->getLocation("exposure"), std::pow(2, cfg->exposure));
+
+            glDisable(GL_BLEND);
+            quad.draw();
+
+            output.read();
+            output.unBind();
+
+            for (size_t i = 0; i < (size_t)region.x * region.y; i++)
+            {
+                glm::vec3 c = glm::clamp(glm::vec3(output.data[i]), 0.0f, 1.0f) * 255.0f + 0.5f;
+                bgr[i] = glm::u8vec3(c.b, c.g, c.r);
+            }
+            writer.write(offset, region, bgr);
+
+            std::cout << "\rTile " << ++tile << "/" << num_tiles.x * num_tiles.y << std::flush;
+        });
+
+        std::cout << "\nRendered " << filename << ", " << cameras_drawn << " camera draws" << std::endl;
+    }
+    catch (const std::exception &ex)
+    {
+        std::cout << ex.what() << std::endl;
+    }
+}
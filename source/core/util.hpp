@@ -1,5 +1,12 @@
 #pragma once
 
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include <algorithm>
+
 #include <glm/glm.hpp>
 
 inline std::ostream& operator<<(std::ostream& out, const glm::dvec3& v)
@@ -17,8 +24,72 @@ inline glm::mat4 perspectiveProjection(float image_distance, float sensor_width,
     return  P;
 }
 
+// Projection of the sub-rectangle [offset, offset + region) of an image with the given size
+inline glm::mat4 tileProjection(const glm::mat4 &P, const glm::ivec2 &size, const glm::ivec2 &offset, const glm::ivec2 &region)
+{
+    glm::vec2 scale = glm::vec2(size) / glm::vec2(region);
+    glm::vec2 center = (glm::vec2(offset) + glm::vec2(region) * 0.5f) / glm::vec2(size) * 2.0f - 1.0f;
+
+    glm::mat4 T(1.0f);
+    T[0][0] = scale.x;
+    T[1][1] = scale.y;
+    T[3][0] = -center.x * scale.x;
+    T[3][1] = -center.y * scale.y;
+    return T * P;
+}
+
 // From thin-lens equation
 inline float imageDistance(float focal_length, float focus_distance)
 {
     return (focus_distance * focal_length) / (focus_distance - focal_length);
 }
+
+inline float srgbGammaExpand(float c)
+{
+    return c < 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+inline float srgbGammaCompress(float c)
+{
+    return c < 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+}
+
+// Calls f(i) for i in [0, count) on one thread per core, or at most max_threads, the first exception is rethrown
+// once all threads have stopped. A single thread runs f on the calling thread.
+template<typename F>
+void parallelFor(size_t count, const F &f, unsigned max_threads = 0)
+{
+    if (max_threads == 0) max_threads = std::max(1u, std::thread::hardware_concurrency());
+    const size_t threads = std::min((size_t)max_threads, count);
+
+    if (threads <= 1)
+    {
+        for (size_t i = 0; i < count; i++) f(i);
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    std::vector<std::thread> pool;
+    for (size_t t = 0; t < threads; t++)
+    {
+        pool.emplace_back([&]
+        {
+            try
+            {
+                for (size_t i; (i = next++) < count;) f(i);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) error = std::current_exception();
+                next = count;
+            }
+        });
+    }
+    for (auto &t : pool) t.join();
+
+    if (error) std::rethrow_exception(error);
+}
@@ -5,7 +5,7 @@
 
 #include <nanogui/opengl.h>
 
-FBO::FBO(const glm::ivec2 &size) : size(size), data(size.x * size.y, glm::vec4(0.0f))
+FBO::FBO(const glm::ivec2 &size) : size(size), viewport_size(size), data(size.x * size.y, glm::vec4(0.0f))
 {
     glGenFramebuffers(1, &handle);
     glBindFramebuffer(GL_FRAMEBUFFER, handle);
@@ -35,11 +35,18 @@ FBO::~FBO()
 
 void FBO::bind()
 {
+    bind(size);
+}
+
+void FBO::bind(const glm::ivec2 &region)
+{
+    viewport_size = glm::clamp(region, glm::ivec2(1), size);
+
     glGetIntegerv(GL_VIEWPORT, prev_viewport);
-    glViewport(0, 0, size.x, size.y);
+    glViewport(0, 0, viewport_size.x, viewport_size.y);
 
     glGetIntegerv(GL_SCISSOR_BOX, prev_scissor);
-    glScissor(0, 0, size.x, size.y);
+    glScissor(0, 0, viewport_size.x, viewport_size.y);
 
     glDisable(GL_DEPTH_TEST);
     glDisable(GL_STENCIL_TEST);
@@ -63,16 +70,27 @@ void FBO::bindTexture()
     glBindTexture(GL_TEXTURE_2D, texture);
 }
 
+void FBO::read()
+{
+    read(data);
+}
+
+void FBO::read(std::vector<glm::vec4> &target) const
+{
+    target.resize((size_t)viewport_size.x * viewport_size.y);
+    glReadPixels(0, 0, viewport_size.x, viewport_size.y, GL_RGBA, GL_FLOAT, target.data());
+}
+
 float FBO::getMaxAlpha()
 {
-    glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_FLOAT, data.data());
+    read();
 
     float max_alpha = 0.0f;
-    for (int y = 0; y < size.y; y++)
+    for (int y = 0; y < viewport_size.y; y++)
     {
-        for (int x = 0; x < size.x; x++)
+        for (int x = 0; x < viewport_size.x; x++)
         {
-            float alpha = data[y * size.y + x].a;
+            float alpha = data[y * viewport_size.x + x].a;
             if (alpha > max_alpha)
             {
                 max_alpha = alpha;
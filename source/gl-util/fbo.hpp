@@ -11,15 +11,25 @@ public:
 
     void bind();
 
+    // Restricts rendering to the lower left viewport_size pixels
+    void bind(const glm::ivec2 &region);
+
     void unBind();
 
     float getMaxAlpha();
 
+    // Reads the used region of the framebuffer into data, must be bound
+    void read();
+    void read(std::vector<glm::vec4> &target) const;
+
     void bindTexture();
 
     unsigned int handle, texture;
     const glm::ivec2 size;
 
+    // Region used since the last bind
+    glm::ivec2 viewport_size;
+
     int prev_viewport[4] = { 0 };
     int prev_scissor[4] = { 0 };
 
@@ -0,0 +1,100 @@
+#include "layered-fbo.hpp"
+
+#include <exception>
+#include <stdexcept>
+
+#include <nanogui/opengl.h>
+
+#include "pixel-readback.hpp"
+
+LayeredFBO::LayeredFBO(const glm::ivec2 &size, int layers) : size(size), layers(layers), viewport_size(size)
+{
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA32F, size.x, size.y, layers, 0, GL_RGBA, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    glGenFramebuffers(1, &handle);
+    glBindFramebuffer(GL_FRAMEBUFFER, handle);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture, 0);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        throw std::runtime_error("Layered framebuffer not complete.");
+    }
+
+    // glReadPixels only sees the first layer of a layered attachment, single layers are attached here instead
+    glGenFramebuffers(1, &read_handle);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+LayeredFBO::~LayeredFBO()
+{
+    glDeleteTextures(1, &texture);
+    glDeleteFramebuffers(1, &handle);
+    glDeleteFramebuffers(1, &read_handle);
+}
+
+void LayeredFBO::bind(const glm::ivec2 &region)
+{
+    viewport_size = glm::clamp(region, glm::ivec2(1), size);
+
+    glGetIntegerv(GL_VIEWPORT, prev_viewport);
+    glViewport(0, 0, viewport_size.x, viewport_size.y);
+
+    glGetIntegerv(GL_SCISSOR_BOX, prev_scissor);
+    glScissor(0, 0, viewport_size.x, viewport_size.y);
+
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_STENCIL_TEST);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, handle);
+}
+
+void LayeredFBO::unBind()
+{
+    glViewport(prev_viewport[0], prev_viewport[1], prev_viewport[2], prev_viewport[3]);
+    glScissor(prev_scissor[0], prev_scissor[1], prev_scissor[2], prev_scissor[3]);
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_STENCIL_TEST);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void LayeredFBO::bindTexture()
+{
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+}
+
+void LayeredFBO::read(int layer, std::vector<glm::vec4> &target) const
+{
+    int prev_read;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &prev_read);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, read_handle);
+    glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture, 0, layer);
+
+    target.resize((size_t)viewport_size.x * viewport_size.y);
+    glReadPixels(0, 0, viewport_size.x, viewport_size.y, GL_RGBA, GL_FLOAT, target.data());
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, prev_read);
+}
+
+void LayeredFBO::read(int layer, PixelReadback &readback) const
+{
+    int prev_read;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &prev_read);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, read_handle);
+    glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture, 0, layer);
+
+    readback.read(0, 0, viewport_size.x, viewport_size.y, true);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, prev_read);
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+class PixelReadback;
+
+/*************************************************************************
+Framebuffer with an RGBA32F texture array attached as a layered color 
+attachment, so that a geometry shader can select the layer per primitive 
+through gl_Layer.
+*************************************************************************/
+class LayeredFBO
+{
+public:
+    LayeredFBO(const glm::ivec2 &size, int layers);
+    ~LayeredFBO();
+
+    // Restricts rendering to the lower left viewport_size pixels of every layer
+    void bind(const glm::ivec2 &region);
+
+    void unBind();
+
+    // Binds the texture array to GL_TEXTURE_2D_ARRAY
+    void bindTexture();
+
+    // Reads the used region of a layer
+    void read(int layer, std::vector<glm::vec4> &target) const;
+
+    // Starts reading the used region of a layer as RGBA floats without waiting
+    void read(int layer, PixelReadback &readback) const;
+
+    unsigned int handle, read_handle, texture;
+    const glm::ivec2 size;
+    const int layers;
+
+    // Region used since the last bind
+    glm::ivec2 viewport_size;
+
+    int prev_viewport[4] = { 0 };
+    int prev_scissor[4] = { 0 };
+};
@@ -59,4 +59,9 @@ void NSidedPolygon::bind()
 void NSidedPolygon::draw()
 {
     glDrawElements(GL_TRIANGLES, num_indices, GL_UNSIGNED_INT, 0);
+}
+
+void NSidedPolygon::drawInstanced(int count)
+{
+    glDrawElementsInstanced(GL_TRIANGLES, num_indices, GL_UNSIGNED_INT, 0, count);
 }
\ No newline at end of file
@@ -11,6 +11,9 @@ public:
 
     void draw();
 
+    // Draws count instances, identified by gl_InstanceID
+    void drawInstanced(int count);
+
     unsigned int VBO, VAO, EBO;
 
     int num_indices;
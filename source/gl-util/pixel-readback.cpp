@@ -0,0 +1,55 @@
+#include "pixel-readback.hpp"
+
+#include <algorithm>
+
+#include <nanogui/opengl.h>
+
+PixelReadback::PixelReadback()
+{
+    glGenBuffers(1, &handle);
+}
+
+PixelReadback::~PixelReadback()
+{
+    if (fence) glDeleteSync((GLsync)fence);
+    glDeleteBuffers(1, &handle);
+}
+
+void PixelReadback::read(int x, int y, int width, int height, bool rgba)
+{
+    count = (size_t)width * height * (rgba ? 4 : 1);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, handle);
+    glBufferData(GL_PIXEL_PACK_BUFFER, count * sizeof(float), NULL, GL_STREAM_READ);
+    glReadPixels(x, y, width, height, rgba ? GL_RGBA : GL_RED, GL_FLOAT, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (fence) glDeleteSync((GLsync)fence);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    // Makes sure the fence reaches the GPU so that it can signal without a later wait
+    glFlush();
+
+    pending = true;
+}
+
+bool PixelReadback::available()
+{
+    if (!pending) return false;
+    return glClientWaitSync((GLsync)fence, 0, 0) != GL_TIMEOUT_EXPIRED;
+}
+
+void PixelReadback::get(std::vector<float> &data)
+{
+    data.resize(count);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, handle);
+    const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, count * sizeof(float), GL_MAP_READ_BIT);
+    if (mapped) std::copy((const float*)mapped, (const float*)mapped + count, data.begin());
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    glDeleteSync((GLsync)fence);
+    fence = nullptr;
+    pending = false;
+}
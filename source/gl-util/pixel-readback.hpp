@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+// Copies a region of the bound framebuffer into a pixel buffer object without waiting
+// for the GPU, the result is fetched once a fence placed after the copy has signaled
+class PixelReadback
+{
+public:
+    PixelReadback();
+
+    ~PixelReadback();
+
+    // Starts reading the red channel, or all four channels, of a region as floats
+    void read(int x, int y, int width, int height, bool rgba = false);
+
+    // Whether the copy has finished, never blocks
+    bool available();
+
+    // Copies the finished result into data, only valid after available() returned true
+    void get(std::vector<float> &data);
+
+    unsigned int handle;
+
+    // Set between read() and get()
+    bool pending = false;
+
+private:
+    void* fence = nullptr;
+    size_t count = 0;
+};
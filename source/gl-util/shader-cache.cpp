@@ -0,0 +1,134 @@
+#include "shader-cache.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+
+#include <nanogui/opengl.h>
+
+// 64-bit FNV-1a
+uint64_t hashString(const std::string &s, uint64_t hash = 14695981039346656037ULL)
+{
+    for (unsigned char c : s)
+    {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+ShaderCache::ShaderCache(const std::filesystem::path &directory) : directory(directory)
+{
+    int num_formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+
+    // Clear the error raised by drivers that don't know the enum
+    while (glGetError() != GL_NO_ERROR);
+
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+
+    binaries_supported = num_formats > 0 && !ec;
+
+    for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+    {
+        const char* str = reinterpret_cast<const char*>(glGetString(name));
+        if (str) driver += std::string(str) + '\n';
+    }
+}
+
+Shader* ShaderCache::get(const std::string &vert_source, const std::string &frag_source, const std::vector<std::string> &defines)
+{
+    return get(vert_source, "", frag_source, defines);
+}
+
+Shader* ShaderCache::get(const std::string &vert_source, const std::string &geom_source, const std::string &frag_source, 
+                         const std::vector<std::string> &defines)
+{
+    uint64_t key = hashString(vert_source);
+    if (!geom_source.empty()) key = hashString(geom_source, key);
+    key = hashString(frag_source, key);
+    for (const auto &d : defines)
+    {
+        key = hashString(d + '\n', key);
+    }
+
+    auto it = programs.find(key);
+    if (it != programs.end()) return it->second.get();
+
+    key = hashString(driver, key);
+
+    std::stringstream filename;
+    filename << std::hex << std::setw(16) << std::setfill('0') << key << ".bin";
+    std::filesystem::path path = directory / filename.str();
+
+    std::unique_ptr<Shader> program;
+
+    if (binaries_supported)
+    {
+        program = load(path);
+    }
+
+    if (!program)
+    {
+        const char* geom = geom_source.empty() ? nullptr : geom_source.c_str();
+        program = std::make_unique<Shader>(vert_source.c_str(), geom, frag_source.c_str(), defines, binaries_supported);
+        if (binaries_supported) store(path, *program);
+    }
+
+    for (const auto &[name, binding] : uniform_blocks)
+    {
+        program->bindUniformBlock(name.c_str(), binding);
+    }
+
+    Shader* ptr = program.get();
+    programs.emplace(key, std::move(program));
+    return ptr;
+}
+
+void ShaderCache::bindUniformBlock(const std::string &name, unsigned int binding)
+{
+    uniform_blocks.emplace_back(name, binding);
+
+    for (auto &p : programs)
+    {
+        p.second->bindUniformBlock(name.c_str(), binding);
+    }
+}
+
+std::unique_ptr<Shader> ShaderCache::load(const std::filesystem::path &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return nullptr;
+
+    uint32_t format;
+    file.read(reinterpret_cast<char*>(&format), sizeof(format));
+    if (!file) return nullptr;
+
+    std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (binary.empty()) return nullptr;
+
+    try
+    {
+        return std::make_unique<Shader>(format, binary);
+    }
+    catch (const std::exception &ex)
+    {
+        // Stale binary, e.g. after a driver update. It is replaced once recompiled.
+        std::cout << ex.what() << std::endl;
+        return nullptr;
+    }
+}
+
+void ShaderCache::store(const std::filesystem::path &path, const Shader &program)
+{
+    unsigned int format;
+    std::vector<char> binary = program.getBinary(format);
+    if (binary.empty()) return;
+
+    uint32_t format32 = format;
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<char*>(&format32), sizeof(format32));
+    file.write(binary.data(), binary.size());
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "shader.hpp"
+
+/*****************************************************************************
+Owns specialized permutations of shader programs, compiled with different sets 
+of defines. Linked programs are also written to disk with glGetProgramBinary 
+when the driver supports it, so that later startups can skip GLSL compilation.
+*****************************************************************************/
+class ShaderCache
+{
+public:
+    ShaderCache(const std::filesystem::path &directory);
+
+    // Returns the program for this combination of sources and defines, compiling it if needed
+    Shader* get(const std::string &vert_source, const std::string &frag_source, const std::vector<std::string> &defines = {});
+
+    // Same as above for programs with a geometry shader stage
+    Shader* get(const std::string &vert_source, const std::string &geom_source, const std::string &frag_source, 
+                const std::vector<std::string> &defines);
+
+    // Uniform block bindings applied to every program created by the cache
+    void bindUniformBlock(const std::string &name, unsigned int binding);
+
+private:
+    std::unique_ptr<Shader> load(const std::filesystem::path &path);
+    void store(const std::filesystem::path &path, const Shader &program);
+
+    std::filesystem::path directory;
+    bool binaries_supported = false;
+
+    // Binaries are only valid for the driver that produced them
+    std::string driver;
+
+    std::unordered_map<uint64_t, std::unique_ptr<Shader>> programs;
+    std::vector<std::pair<std::string, unsigned int>> uniform_blocks;
+};
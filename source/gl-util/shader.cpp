@@ -2,40 +2,81 @@
 
 #include <exception>
 #include <stdexcept>
+#include <vector>
 
 #include <nanogui/opengl.h>
 
-Shader::Shader(const char* vert_source, const char* frag_source)
+std::string specialize(const char* source, const std::vector<std::string> &defines)
 {
-    int vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex_shader, 1, &vert_source, NULL);
-    glCompileShader(vertex_shader);
+    std::string specialized(source);
+    if (defines.empty()) return specialized;
 
-    int success;
-    char infoLog[512];
-    glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &success);
-    if (!success)
+    std::string definitions;
+    for (const auto &d : defines)
+    {
+        definitions += "#define " + d + "\n";
+    }
+
+    size_t version = specialized.find("#version");
+    size_t line_end = version == std::string::npos ? std::string::npos : specialized.find('\n', version);
+    if (line_end == std::string::npos)
     {
-        glGetShaderInfoLog(vertex_shader, 512, NULL, infoLog);
-        throw std::runtime_error("Vertex shader error: " + std::string(infoLog));
+        throw std::runtime_error("Shader source is missing a #version directive.");
     }
+    return specialized.insert(line_end + 1, definitions);
+}
+
+int compileStage(GLenum type, const char* source, const std::vector<std::string> &defines, const std::string &name)
+{
+    std::string specialized = specialize(source, defines);
+    const char* ptr = specialized.c_str();
 
-    int fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment_shader, 1, &frag_source, NULL);
-    glCompileShader(fragment_shader);
+    int shader = glCreateShader(type);
+    glShaderSource(shader, 1, &ptr, NULL);
+    glCompileShader(shader);
 
-    glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
+    int success;
+    char infoLog[512];
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
     if (!success)
     {
-        glGetShaderInfoLog(fragment_shader, 512, NULL, infoLog);
-        throw std::runtime_error("Fragment shader error: " + std::string(infoLog));
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        glDeleteShader(shader);
+        throw std::runtime_error(name + " shader error: " + std::string(infoLog));
     }
+    return shader;
+}
+
+Shader::Shader(const char* vert_source, const char* frag_source, const std::vector<std::string> &defines, bool retrievable_binary)
+{
+    build(vert_source, nullptr, frag_source, defines, retrievable_binary);
+}
+
+Shader::Shader(const char* vert_source, const char* geom_source, const char* frag_source, const std::vector<std::string> &defines, bool retrievable_binary)
+{
+    build(vert_source, geom_source, frag_source, defines, retrievable_binary);
+}
+
+void Shader::build(const char* vert_source, const char* geom_source, const char* frag_source, const std::vector<std::string> &defines, bool retrievable_binary)
+{
+    int vertex_shader = compileStage(GL_VERTEX_SHADER, vert_source, defines, "Vertex");
+    int geometry_shader = geom_source ? compileStage(GL_GEOMETRY_SHADER, geom_source, defines, "Geometry") : 0;
+    int fragment_shader = compileStage(GL_FRAGMENT_SHADER, frag_source, defines, "Fragment");
 
     handle = glCreateProgram();
     glAttachShader(handle, vertex_shader);
+    if (geometry_shader) glAttachShader(handle, geometry_shader);
     glAttachShader(handle, fragment_shader);
+
+    if (retrievable_binary)
+    {
+        glProgramParameteri(handle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
     glLinkProgram(handle);
 
+    int success;
+    char infoLog[512];
     glGetProgramiv(handle, GL_LINK_STATUS, &success);
     if (!success)
     {
@@ -43,8 +84,30 @@ Shader::Shader(const char* vert_source, const char* frag_source)
         throw std::runtime_error("Shader program error: " + std::string(infoLog));
     }
     glDeleteShader(vertex_shader);
+    if (geometry_shader) glDeleteShader(geometry_shader);
     glDeleteShader(fragment_shader);
 
+    reflect();
+
+    use();
+}
+
+Shader::Shader(unsigned int binary_format, const std::vector<char> &binary)
+{
+    handle = glCreateProgram();
+    glProgramBinary(handle, binary_format, binary.data(), (GLsizei)binary.size());
+
+    // Fails if the binary was produced by a different driver or GPU
+    int success;
+    glGetProgramiv(handle, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        glDeleteProgram(handle);
+        throw std::runtime_error("Shader program binary rejected by driver.");
+    }
+
+    reflect();
+
     use();
 }
 
@@ -53,16 +116,68 @@ Shader::~Shader()
     glDeleteProgram(handle);
 }
 
-int Shader::getLocation(const char* name)
+void Shader::reflect()
+{
+    int num_uniforms, max_name_length;
+    glGetProgramiv(handle, GL_ACTIVE_UNIFORMS, &num_uniforms);
+    glGetProgramiv(handle, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+
+    std::vector<char> name(max_name_length);
+    for (int i = 0; i < num_uniforms; i++)
+    {
+        GLsizei length;
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(handle, i, max_name_length, &length, &size, &type, name.data());
+
+        std::string uniform(name.data(), length);
+
+        // Arrays are reported as name[0] but are looked up by name
+        if (uniform.size() > 3 && uniform.compare(uniform.size() - 3, 3, "[0]") == 0)
+        {
+            uniform.resize(uniform.size() - 3);
+        }
+
+        // Uniform block members have no location
+        GLint loc = glGetUniformLocation(handle, uniform.c_str());
+        if (loc >= 0) locations[uniform] = loc;
+    }
+}
+
+int Shader::getLocation(const std::string &name) const
 {
-    GLint loc = glGetUniformLocation(handle, name);
+    auto it = locations.find(name);
+
+    //if (it == locations.end()) std::cout << name << " uniform location not found.\n";
 
-    //if (loc < 0) std::cout << name << " uniform location not found.\n";
+    return it != locations.end() ? it->second : -1;
+}
 
-    return loc;
+void Shader::bindUniformBlock(const char* name, unsigned int binding)
+{
+    GLuint index = glGetUniformBlockIndex(handle, name);
+    if (index != GL_INVALID_INDEX)
+    {
+        glUniformBlockBinding(handle, index, binding);
+    }
+}
+
+std::vector<char> Shader::getBinary(unsigned int &binary_format) const
+{
+    int length = 0;
+    glGetProgramiv(handle, GL_PROGRAM_BINARY_LENGTH, &length);
+
+    std::vector<char> binary(length);
+    if (length > 0)
+    {
+        GLenum format;
+        glGetProgramBinary(handle, length, NULL, &format, binary.data());
+        binary_format = format;
+    }
+    return binary;
 }
 
 void Shader::use()
 {
     glUseProgram(handle);
-}
\ No newline at end of file
+}
@@ -1,15 +1,40 @@
 #pragma once
 
+#include <string>
+#include <vector>
+#include <unordered_map>
+
 class Shader
 {
 public:
-    Shader(const char* vert_source, const char* frag_source);
+    // Each define is inserted as "#define <define>" directly after the #version directive
+    Shader(const char* vert_source, const char* frag_source, 
+           const std::vector<std::string> &defines = {}, bool retrievable_binary = false);
+
+    // Program with a geometry shader stage between the vertex and fragment shaders
+    Shader(const char* vert_source, const char* geom_source, const char* frag_source, 
+           const std::vector<std::string> &defines = {}, bool retrievable_binary = false);
+
+    // Creates the program from a binary previously retrieved with getBinary()
+    Shader(unsigned int binary_format, const std::vector<char> &binary);
 
     ~Shader();
 
-    int getLocation(const char* name);
+    int getLocation(const std::string &name) const;
+
+    void bindUniformBlock(const char* name, unsigned int binding);
+
+    std::vector<char> getBinary(unsigned int &binary_format) const;
 
     void use();
 
     int handle;
-};
\ No newline at end of file
+
+private:
+    void reflect();
+    void build(const char* vert_source, const char* geom_source, const char* frag_source, 
+               const std::vector<std::string> &defines, bool retrievable_binary);
+
+    // Locations of all active uniforms, queried once after linking
+    std::unordered_map<std::string, int> locations;
+};
@@ -0,0 +1,37 @@
+#include "timer-query.hpp"
+
+#include <nanogui/opengl.h>
+
+TimerQuery::TimerQuery()
+{
+    glGenQueries(1, &handle);
+}
+
+TimerQuery::~TimerQuery()
+{
+    glDeleteQueries(1, &handle);
+}
+
+void TimerQuery::begin()
+{
+    glBeginQuery(GL_TIME_ELAPSED, handle);
+}
+
+void TimerQuery::end()
+{
+    glEndQuery(GL_TIME_ELAPSED);
+}
+
+bool TimerQuery::available()
+{
+    GLint available = GL_FALSE;
+    glGetQueryObjectiv(handle, GL_QUERY_RESULT_AVAILABLE, &available);
+    return available == GL_TRUE;
+}
+
+double TimerQuery::elapsed()
+{
+    GLuint64 ns = 0;
+    glGetQueryObjectui64v(handle, GL_QUERY_RESULT, &ns);
+    return ns * 1e-6;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+// Measures elapsed GPU time between begin() and end()
+class TimerQuery
+{
+public:
+    TimerQuery();
+
+    ~TimerQuery();
+
+    void begin();
+
+    void end();
+
+    // Whether the result can be read without stalling
+    bool available();
+
+    // Elapsed time in milliseconds, waits for the GPU if the result isn't available yet
+    double elapsed();
+
+    unsigned int handle;
+};
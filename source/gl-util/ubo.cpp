@@ -0,0 +1,45 @@
+#include "ubo.hpp"
+
+#include <nanogui/opengl.h>
+
+UBO::UBO(size_t size, unsigned int binding) : binding(binding), size(size)
+{
+    glGenBuffers(1, &handle);
+    glBindBuffer(GL_UNIFORM_BUFFER, handle);
+    glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, handle);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+UBO::~UBO()
+{
+    glDeleteBuffers(1, &handle);
+}
+
+void UBO::update(const void* data)
+{
+    glBindBuffer(GL_UNIFORM_BUFFER, handle);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+
+    // Rebind in case the binding point has been used by someone else
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, handle);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+
+void UBO::update(const void* data, size_t offset, size_t size)
+{
+    glBindBuffer(GL_UNIFORM_BUFFER, handle);
+    glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UBO::bind()
+{
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, handle);
+}
+
+void UBO::bindRange(size_t offset, size_t size)
+{
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, handle, offset, size);
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+
+class UBO
+{
+public:
+    UBO(size_t size, unsigned int binding);
+
+    ~UBO();
+
+    void update(const void* data);
+
+    // Updates size bytes at offset without rebinding
+    void update(const void* data, size_t offset, size_t size);
+
+    // Binds the whole buffer or a range of it to the binding point
+    void bind();
+    void bindRange(size_t offset, size_t size);
+
+    unsigned int handle, binding;
+    const size_t size;
+};
@@ -2,14 +2,102 @@
 
 #include <iostream>
 #include <exception>
+#include <stdexcept>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <algorithm>
 
 #include "core/application.hpp"
+#include "core/render-server.hpp"
+#include "core/coordinator.hpp"
+#include "core/light-field-codec.hpp"
+#include "core/camera-array.hpp"
 
-int main() 
+/*********************************************************************************
+Usage:
+  light-field-renderer
+  light-field-renderer --server <light field file> [--port 8080] [--listen-all]
+  light-field-renderer --bench-client [--host localhost] [--port 8080] 
+                       [--clients 8] [--requests 256] [--width 512] [--height 512]
+  light-field-renderer --coordinator <job file> [--workers 8081,8082,host:8083]
+  light-field-renderer --encode <light field folder> --output <file.lfc> [--quality 1]
+  light-field-renderer --decode <file.lfc> --output <folder>
+  light-field-renderer --pack-textures <light field folder> [--format bc7]
+
+Servers only accept local connections unless --listen-all is given, which
+remote coordinator workers need. There is no authentication.
+*********************************************************************************/
+int main(int argc, char* argv[])
 {
+    std::vector<std::string> args(argv + 1, argv + argc);
+
+    auto option = [&args](const std::string &name, const std::string &default_value)
+    {
+        auto it = std::find(args.begin(), args.end(), name);
+        return it != args.end() && it + 1 != args.end() ? *(it + 1) : default_value;
+    };
+
+    auto flag = [&args](const std::string &name)
+    {
+        return std::find(args.begin(), args.end(), name) != args.end();
+    };
+
     try 
     {
+        uint16_t port = (uint16_t)std::stoi(option("--port", "8080"));
+
+        if (flag("--bench-client"))
+        {
+            return benchClient(
+                option("--host", "localhost"), port, 
+                std::stoi(option("--clients", "8")), std::stoi(option("--requests", "256")), 
+                { std::stoi(option("--width", "512")), std::stoi(option("--height", "512")) }
+            );
+        }
+
+        if (flag("--coordinator"))
+        {
+            // Ports without a host are local workers
+            std::vector<WorkerAddress> workers;
+            std::istringstream list(option("--workers", "8080"));
+            std::string worker;
+            while (std::getline(list, worker, ','))
+            {
+                size_t colon = worker.rfind(':');
+                std::string host = colon == std::string::npos ? "localhost" : worker.substr(0, colon);
+                workers.push_back({ host, (uint16_t)std::stoi(worker.substr(colon + 1)) });
+            }
+            return coordinate(option("--coordinator", ""), workers);
+        }
+
+        if (flag("--encode"))
+        {
+            return encodeLightField(option("--encode", ""), option("--output", "light-field.lfc"), std::stoi(option("--quality", "1")));
+        }
+
+        if (flag("--decode"))
+        {
+            return decodeLightField(option("--decode", ""), option("--output", "decoded"));
+        }
+
+        if (flag("--pack-textures"))
+        {
+            std::string format = option("--format", "bc7");
+            if (format != "bc1" && format != "bc7") throw std::runtime_error("Texture format must be bc1 or bc7");
+
+            auto storage = format == "bc1" ? CameraArray::Storage::BC1 : CameraArray::Storage::BC7;
+            CameraArray::packTextures(option("--pack-textures", ""), storage);
+            return 0;
+        }
+
         nanogui::init();
+        if (flag("--server"))
+        {
+            RenderServer server(option("--server", ""), port, flag("--listen-all"));
+            server.run();
+        }
+        else
         {
             nanogui::ref<Application> app = new Application();
             app->dec_ref();
@@ -4,6 +4,7 @@ inline constexpr char disparity_frag[] = R"(
 #version 330 core
 #line 5
 
+// Linear luminance of the camera
 uniform sampler2D image;
 
 uniform int channel;
@@ -12,15 +13,6 @@ out vec4 color;
 
 in vec2 st;
 
-vec3 srgbGammaExpand(vec3 c)
-{
-    return mix(
-        pow((c + 0.055) / 1.055, vec3(2.4)), 
-        c / 12.92,
-        lessThan(c, vec3(0.04045))
-    );
-}
-
 void main() 
 {
     if(st.x < 0 || st.x > 1 || st.y < 0 || st.y > 1)
@@ -28,10 +20,6 @@ void main()
         discard;
     }
 
-    vec3 linear = srgbGammaExpand(texture(image, st).xyz);
-
-    float luminance = 0.2126 * linear.r + 0.7152 * linear.g + 0.0722 * linear.b;
-
     color = vec4(0.0, 0.0, 0.0, 1.0);
-    color[channel] = luminance;
-})";
\ No newline at end of file
+    color[channel] = texture(image, st).r;
+})";
@@ -4,19 +4,26 @@ inline constexpr char disparity_vert[] = R"(
 #version 330 core
 #line 5
 
-// Properties of desired camera
-uniform float focus_distance;
-uniform vec3 eye;
-uniform vec3 forward;
-uniform vec3 up;
-uniform vec3 right;
-uniform mat4 VP;
+// Properties of desired camera, shared with other programs through a std140 uniform buffer
+layout (std140) uniform View
+{
+    mat4 VP;
+    vec3 eye;
+    float focus_distance;
+    vec3 forward;
+    float aperture_diameter;
+    vec3 right;
+    vec3 up;
+};
 
 // Properties of current data camera
 uniform vec2 data_eye;
 
 uniform vec2 size;
 
+// Maps the autofocus region of the screen to the whole render target
+uniform mat4 roi;
+
 layout (location = 0) in vec2 position;
 
 out vec2 st;
@@ -35,5 +42,5 @@ void main()
     st = projectToDataCamera(focal_point);
 
     vec3 e2p = normalize(focal_point - eye);
-    gl_Position = VP * vec4(vec3(eye.xy + e2p.xy * (-1 / e2p.z), eye.z - 1), 1.0);
+    gl_Position = roi * VP * vec4(vec3(eye.xy + e2p.xy * (-1 / e2p.z), eye.z - 1), 1.0);
 })";
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+
+/************************************************************************
+Linear luminance of a camera image, rendered once per camera into a single 
+channel texture that the disparity pass samples instead of the image.
+*************************************************************************/
+inline constexpr char luminance_frag[] = R"glsl(
+#version 330 core
+#line 9
+
+uniform sampler2D image;
+
+#ifdef YCBCR_TEXTURES
+uniform sampler2D chroma;
+#endif
+
+in vec2 interpolated_texcoord;
+
+out vec4 color;
+
+vec3 srgbGammaExpand(vec3 c)
+{
+    return mix(
+        pow((c + 0.055) / 1.055, vec3(2.4)), 
+        c / 12.92,
+        lessThan(c, vec3(0.04045))
+    );
+}
+
+// Full range BT.601 as in JPEG files
+vec3 ycbcrToRgb(float y, vec2 cbcr)
+{
+    cbcr -= 0.5;
+    return clamp(vec3(y + 1.402 * cbcr.y, y - 0.344136 * cbcr.x - 0.714136 * cbcr.y, y + 1.772 * cbcr.x), 0.0, 1.0);
+}
+
+void main()
+{
+    vec3 texel = texture(image, interpolated_texcoord).xyz;
+#ifdef YCBCR_TEXTURES
+    texel = ycbcrToRgb(texel.x, texture(chroma, interpolated_texcoord).xy);
+#endif
+
+#ifdef SRGB_TEXTURES
+    vec3 linear = srgbGammaExpand(texel);
+#else
+    vec3 linear = texel;
+#endif
+
+    color = vec4(0.2126 * linear.r + 0.7152 * linear.g + 0.0722 * linear.b, 0.0, 0.0, 1.0);
+})glsl";
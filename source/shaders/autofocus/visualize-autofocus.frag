@@ -1,11 +1,18 @@
 #pragma once
 
+/************************************************************************
+Overlay of the autofocus state on the rendered image. The disparity images
+of the search region are shown in the lower left corner, the search image
+next to the template, and the search and template regions are outlined.
+*************************************************************************/
 inline constexpr char visualize_autofocus_frag[] = R"glsl(
 #version 330 core
-#line 5
+#line 10
 
+// Disparity images of the search region
 uniform sampler2D disparity_image;
 
+// Screen size and regions in screen pixels
 uniform ivec2 size;
 uniform ivec2 template_min;
 uniform ivec2 template_max;
@@ -25,29 +32,29 @@ vec2 srgbGammaCompress(vec2 c)
     );
 }
 
+bool onBorder(ivec2 px, ivec2 rect_min, ivec2 rect_max, int w)
+{
+    bool inside = all(greaterThanEqual(px, rect_min - w)) && all(lessThan(px, rect_max + w));
+    bool interior = all(greaterThanEqual(px, rect_min)) && all(lessThan(px, rect_max));
+    return inside && !interior;
+}
+
 void main()
 {
     ivec2 px = ivec2(interpolated_texcoord * size);
     ivec2 search_size = search_max - search_min;
     ivec2 template_size = template_max - template_min;
+    ivec2 template_offset = template_min - search_min;
     const int w = 2;
-    
+
     if(px.x < search_size.x && px.y < search_size.y)
     {
-        vec2 c = srgbGammaCompress(texture(disparity_image, (search_min + px) / vec2(size)).xy);
+        vec2 c = srgbGammaCompress(texelFetch(disparity_image, px, 0).xy);
         color = vec4(vec3(c.r), 1.0);
 
-        ivec2 offset = (search_size - template_size) / 2;
-        if(px.x < template_size.x + offset.x + w && px.y < template_size.y + offset.y + w && px.x > offset.x - w && px.y > offset.y - w)
+        if(onBorder(px, template_offset, template_offset + template_size, w))
         {
-            if(px.x > template_size.x + offset.x || px.y > template_size.y + offset.y || px.x < offset.x || px.y < offset.y)
-            {
-                color *= 0.1;
-            }
-        }
-        else
-        {
-            color *= 0.75;
+            color.rgb *= 0.1;
         }
         return;
     }
@@ -55,36 +62,21 @@ void main()
     if(px.x < search_size.x * 2 && px.y < search_size.y)
     {
         ivec2 offset = ivec2(search_size.x, 0) + (search_size - template_size) / 2;
-        if(px.x < template_size.x + offset.x && px.y < template_size.y + offset.y && px.x > offset.x && px.y > offset.y)
+        if(all(greaterThanEqual(px, offset)) && all(lessThan(px, offset + template_size)))
         {
-            vec2 c = srgbGammaCompress(texture(disparity_image, (template_min + px - offset) / vec2(size)).xy);
+            vec2 c = srgbGammaCompress(texelFetch(disparity_image, template_offset + px - offset, 0).xy);
             color = vec4(vec3(c.g), 1.0);
             return;
         }
-        color = vec4(0.25);
+        color = vec4(vec3(0.25), 1.0);
         return;
     }
 
-    vec2 c = srgbGammaCompress(texture(disparity_image, interpolated_texcoord).xy);
-
-    color = vec4(c.r, 0.5 * (c.r + c.g), c.g, 1.0);
-
-    if(px.x > search_min.x && px.x < search_max.x && px.y > search_min.y && px.y < search_max.y)
+    if(onBorder(px, search_min, search_max, w) || onBorder(px, template_min, template_max, w))
     {
-        if(px.x < search_min.x + w || px.x > search_max.x - w || px.y < search_min.y + w || px.y > search_max.y - w)
-        {
-            color *= 0.1;
-        }
-        if(px.x > template_min.x && px.x < template_max.x && px.y > template_min.y && px.y < template_max.y)
-        {
-            if(px.x < template_min.x + w || px.x > template_max.x - w || px.y < template_min.y + w || px.y > template_max.y - w)
-            {
-                color *= 0.1;
-            }
-        }
-    }
-    else
-    {
-        color *= 0.75;
+        color = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
     }
-})glsl";
\ No newline at end of file
+
+    discard;
+})glsl";
@@ -0,0 +1,41 @@
+#pragma once
+
+/************************************************************************
+Refocusing by interpolating between the two slices of a focal stack 
+closest to the focus distance.
+*************************************************************************/
+inline constexpr char focal_stack_frag[] = R"glsl(
+#version 330 core
+#line 9
+
+uniform sampler2DArray focal_stack;
+
+// Fractional slice of the focus distance
+uniform float slice;
+
+uniform float exposure;
+
+in vec2 interpolated_texcoord;
+
+out vec4 color;
+
+vec3 srgbGammaCompress(vec3 c)
+{
+    return mix(
+        1.055 * pow(c, vec3(1.0/2.4)) - 0.055,
+        c * 12.92,
+        lessThan(c, vec3(0.0031308))
+    );
+}
+
+void main()
+{
+    float last = float(textureSize(focal_stack, 0).z - 1);
+    float s0 = floor(slice);
+    float s1 = min(s0 + 1.0, last);
+
+    vec3 c0 = texture(focal_stack, vec3(interpolated_texcoord, s0)).rgb;
+    vec3 c1 = texture(focal_stack, vec3(interpolated_texcoord, s1)).rgb;
+
+    color.xyz = srgbGammaCompress(exposure * mix(c0, c1, slice - s0));
+})glsl";
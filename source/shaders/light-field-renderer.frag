@@ -6,6 +6,11 @@ inline constexpr char light_field_renderer_frag[] = R"(
 
 uniform sampler2D data_image;
 
+#ifdef YCBCR_TEXTURES
+// CbCr at half the resolution of the Y plane in data_image
+uniform sampler2D data_chroma;
+#endif
+
 uniform float aperture_falloff;
 
 out vec4 color;
@@ -22,6 +27,13 @@ vec3 srgbGammaExpand(vec3 c)
     );
 }
 
+// Full range BT.601 as in JPEG files
+vec3 ycbcrToRgb(float y, vec2 cbcr)
+{
+    cbcr -= 0.5;
+    return clamp(vec3(y + 1.402 * cbcr.y, y - 0.344136 * cbcr.x - 0.714136 * cbcr.y, y + 1.772 * cbcr.x), 0.0, 1.0);
+}
+
 void main() 
 {
     if(data_image_coord.x < 0.0 || data_image_coord.x > 1.0 || data_image_coord.y < 0.0 || data_image_coord.y > 1.0)
@@ -29,7 +41,31 @@ void main()
         discard;
     }
 
-    float aperture_filter = pow(clamp(1.0 - length((aperture_texcoord - 0.5) * 2.0), 0, 1), aperture_falloff);
+    float aperture_filter = clamp(1.0 - length((aperture_texcoord - 0.5) * 2.0), 0, 1);
+#ifndef LINEAR_FALLOFF
+    aperture_filter = pow(aperture_filter, aperture_falloff);
+#endif
+
+#ifdef MIPMAPS
+    // Footprint of the output pixel in data image texels, which selects the mip level
+    vec2 texels = data_image_coord * textureSize(data_image, 0);
+    float footprint = max(length(dFdx(texels)), length(dFdy(texels)));
+    float lod = log2(max(footprint, 1.0));
+#else
+    float lod = 0.0;
+#endif
+
+    vec3 texel = textureLod(data_image, data_image_coord, lod).xyz;
+#ifdef YCBCR_TEXTURES
+    // The same footprint covers half as many chroma texels
+    texel = ycbcrToRgb(texel.x, textureLod(data_chroma, data_image_coord, max(lod - 1.0, 0.0)).xy);
+#endif
+
+#ifdef SRGB_TEXTURES
+    vec3 radiance = srgbGammaExpand(texel);
+#else
+    vec3 radiance = texel;
+#endif
 
-    color = vec4(srgbGammaExpand(texture(data_image, data_image_coord).xyz) * aperture_filter, aperture_filter);
+    color = vec4(radiance * aperture_filter, aperture_filter);
 })";
\ No newline at end of file
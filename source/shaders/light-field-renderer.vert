@@ -4,14 +4,46 @@ inline constexpr char light_field_renderer_vert[] = R"(
 #version 330 core
 #line 5
 
-// Properties of desired camera
-uniform mat4 VP;
-uniform float focus_distance;
-uniform vec3 eye;
-uniform vec3 forward;
-uniform vec3 right;
-uniform vec3 up;
-uniform float aperture_diameter;
+#ifdef MULTI_VIEW
+/******************************************************************
+Properties of all desired cameras, one per instance. The outputs are
+renamed and passed through multi-view.geom, which selects the layer.
+******************************************************************/
+#define MAX_VIEWS 16
+
+struct ViewData
+{
+    mat4 VP;
+    vec3 eye;
+    float focus_distance;
+    vec3 forward;
+    float aperture_diameter;
+    vec3 right;
+    vec3 up;
+};
+
+layout (std140) uniform Views
+{
+    ViewData views[MAX_VIEWS];
+};
+
+flat out int view_layer;
+
+#define aperture_texcoord vertex_aperture_texcoord
+#define data_image_coord vertex_data_image_coord
+#else
+// Properties of desired camera, shared with other programs through a std140 uniform buffer
+layout (std140) uniform View
+{
+    mat4 VP;
+    vec3 eye;
+    float focus_distance;
+    vec3 forward;
+    float aperture_diameter;
+    vec3 right;
+    vec3 up;
+};
+#endif
 
 // Properties of current data camera
 uniform vec2 data_eye;
@@ -30,6 +62,17 @@ vec2 projectToDataCamera(vec3 point);
 
 void main() 
 {
+#ifdef MULTI_VIEW
+    view_layer = gl_InstanceID;
+    mat4 VP = views[gl_InstanceID].VP;
+    vec3 eye = views[gl_InstanceID].eye;
+    float focus_distance = views[gl_InstanceID].focus_distance;
+    vec3 forward = views[gl_InstanceID].forward;
+    float aperture_diameter = views[gl_InstanceID].aperture_diameter;
+    vec3 right = views[gl_InstanceID].right;
+    vec3 up = views[gl_InstanceID].up;
+#endif
+
     // Subtract because the vertex will be located on the opposite side of the data eye
     vec3 aperture = eye - (position.x * right + position.y * up) * aperture_diameter;
 
@@ -4,18 +4,27 @@ inline constexpr char normalize_aperture_filters_frag[] = R"glsl(
 #version 330 core
 #line 5
 
+#ifdef LAYERED
+uniform sampler2DArray accumulation_texture;
+uniform int layer;
+#else
 uniform sampler2D accumulation_texture;
+#endif
 
 /****************************************************************************************
 This is set to actual maximum filter weight sum (max alpha value of accumulation_texture) 
 if the aperture filter weights shouldn't be normalized per pixel. Otherwise this can be 
 set to 1 or 0 depending on if the aperture filter weight should be normalized at the
-edges (where filter weight sum is < 1) or not.
+edges (where filter weight sum is < 1) or not. Unused if NORMALIZE is defined, in which
+case the weights are always normalized per pixel.
 ****************************************************************************************/
 uniform float max_weight_sum;
 
 uniform float exposure;
 
+// Part of accumulation_texture that was rendered to, which is upsampled to the output
+uniform vec2 texcoord_scale;
+
 in vec2 interpolated_texcoord;
 
 out vec4 color;
@@ -31,6 +40,23 @@ vec3 srgbGammaCompress(vec3 c)
 
 void main()
 {
-    vec4 c = texture(accumulation_texture, interpolated_texcoord);
-    color.xyz = srgbGammaCompress(exposure * c.xyz / max(max_weight_sum, c.w));
+    // Keep the bilinear footprint inside the rendered region
+    vec2 texcoord_max = texcoord_scale - 0.5 / vec2(textureSize(accumulation_texture, 0).xy);
+    vec2 texcoord = min(interpolated_texcoord * texcoord_scale, texcoord_max);
+#ifdef LAYERED
+    vec4 c = texture(accumulation_texture, vec3(texcoord, layer));
+#else
+    vec4 c = texture(accumulation_texture, texcoord);
+#endif
+#ifdef NORMALIZE
+    vec3 linear = c.xyz / c.w;
+#else
+    vec3 linear = c.xyz / max(max_weight_sum, c.w);
+#endif
+#ifdef LINEAR_OUTPUT
+    // Stored for later display, e.g. in the slices of a focal stack
+    color = vec4(linear, 1.0);
+#else
+    color.xyz = srgbGammaCompress(exposure * linear);
+#endif
 })glsl";
\ No newline at end of file
@@ -0,0 +1,123 @@
+#pragma once
+
+/******************************************************************************
+Fast path for apertures smaller than the camera spacing of regular light slab 
+grids. The ray of each pixel is intersected with the camera plane and the four 
+surrounding grid cameras are interpolated bilinearly (uv), while each camera 
+image is interpolated bilinearly by the sampler (st). Outputs the same weighted 
+radiance and weight sum as the accumulation pass.
+******************************************************************************/
+inline constexpr char pinhole_frag[] = R"(
+#version 330 core
+#line 12
+
+// Properties of desired camera, shared with other programs through a std140 uniform buffer
+layout (std140) uniform View
+{
+    mat4 VP;
+    vec3 eye;
+    float focus_distance;
+    vec3 forward;
+    float aperture_diameter;
+    vec3 right;
+    vec3 up;
+};
+
+uniform vec2 sensor_size;
+uniform float image_distance;
+
+// Camera (i, j) is located at grid_origin + grid_step * (i, j) and stored in layer i + j * grid_size.x
+uniform sampler2DArray data_images;
+
+#ifdef YCBCR_TEXTURES
+// CbCr at half the resolution of the Y planes in data_images
+uniform sampler2DArray data_chroma_images;
+#endif
+uniform ivec2 grid_size;
+uniform vec2 grid_origin;
+uniform mat2 grid_step;
+uniform mat2 grid_inverse;
+
+uniform vec2 st_size;
+uniform float st_distance; // uv |<--st_distance-->| st
+
+in vec2 interpolated_texcoord;
+
+out vec4 color;
+
+vec3 srgbGammaExpand(vec3 c)
+{
+    return mix(
+        pow((c + 0.055) / 1.055, vec3(2.4)), 
+        c / 12.92,
+        lessThan(c, vec3(0.04045))
+    );
+}
+
+// Full range BT.601 as in JPEG files
+vec3 ycbcrToRgb(float y, vec2 cbcr)
+{
+    cbcr -= 0.5;
+    return clamp(vec3(y + 1.402 * cbcr.y, y - 0.344136 * cbcr.x - 0.714136 * cbcr.y, y + 1.772 * cbcr.x), 0.0, 1.0);
+}
+
+vec2 projectToDataCamera(vec3 point, vec2 data_eye)
+{
+    vec3 direction = normalize(point - vec3(data_eye, 0.0));
+    return 0.5 + (data_eye + direction.xy * (-st_distance / direction.z)) / st_size;
+}
+
+void main()
+{
+    vec2 sensor_point = (interpolated_texcoord - 0.5) * sensor_size;
+    vec3 direction = normalize(sensor_point.x * right + sensor_point.y * up + image_distance * forward);
+
+    vec3 focal_point = eye + direction * (focus_distance / dot(direction, forward));
+
+    // Intersection with the camera plane in continuous grid coordinates
+    vec2 uv = eye.xy + direction.xy * (-eye.z / direction.z);
+    vec2 ij = grid_inverse * (uv - grid_origin);
+
+#ifdef MIPMAPS
+    // Footprint of the output pixel in texels of a camera at the intersection
+    vec2 texels = projectToDataCamera(focal_point, uv) * vec2(textureSize(data_images, 0).xy);
+    float lod = log2(max(max(length(dFdx(texels)), length(dFdy(texels))), 1.0));
+#else
+    float lod = 0.0;
+#endif
+
+    ivec2 ij0 = ivec2(floor(ij));
+    vec2 f = ij - vec2(ij0);
+
+    color = vec4(0.0);
+    for(int k = 0; k < 4; k++)
+    {
+        ivec2 corner = ivec2(k & 1, k >> 1);
+        ivec2 c = ij0 + corner;
+
+        if(any(lessThan(c, ivec2(0))) || any(greaterThanEqual(c, grid_size)))
+        {
+            continue;
+        }
+
+        vec2 st = projectToDataCamera(focal_point, grid_origin + grid_step * vec2(c));
+
+        if(st.x < 0.0 || st.x > 1.0 || st.y < 0.0 || st.y > 1.0)
+        {
+            continue;
+        }
+
+        vec2 w = mix(1.0 - f, f, vec2(corner));
+        float weight = w.x * w.y;
+
+        vec3 layer = vec3(st, c.x + c.y * grid_size.x);
+        vec3 texel = textureLod(data_images, layer, lod).xyz;
+#ifdef YCBCR_TEXTURES
+        texel = ycbcrToRgb(texel.x, textureLod(data_chroma_images, layer, max(lod - 1.0, 0.0)).xy);
+#endif
+#ifdef SRGB_TEXTURES
+        texel = srgbGammaExpand(texel);
+#endif
+        color += vec4(texel * weight, weight);
+    }
+})";
@@ -0,0 +1,58 @@
+#pragma once
+
+/******************************************************************************
+Reprojects the accumulated radiance and weight of the previous frame into the 
+current view through the focal plane. Regions that were not visible in the 
+previous frame get zero weight and are filled in by the current camera subset.
+******************************************************************************/
+inline constexpr char temporal_reprojection_frag[] = R"(
+#version 330 core
+#line 10
+
+// Properties of desired camera, shared with other programs through a std140 uniform buffer
+layout (std140) uniform View
+{
+    mat4 VP;
+    vec3 eye;
+    float focus_distance;
+    vec3 forward;
+    float aperture_diameter;
+    vec3 right;
+    vec3 up;
+};
+
+uniform vec2 sensor_size;
+uniform float image_distance;
+
+uniform sampler2D history;
+uniform mat4 history_VP;
+uniform vec2 history_texcoord_scale;
+uniform float history_decay;
+
+in vec2 interpolated_texcoord;
+
+out vec4 color;
+
+void main()
+{
+    vec2 sensor_point = (interpolated_texcoord - 0.5) * sensor_size;
+    vec3 direction = normalize(sensor_point.x * right + sensor_point.y * up + image_distance * forward);
+
+    vec3 focal_point = eye + direction * (focus_distance / dot(direction, forward));
+
+    vec4 clip_space = history_VP * vec4(focal_point, 1.0);
+    vec2 texcoord = (clip_space.xy / clip_space.w + 1.0) * 0.5;
+
+    // Disoccluded, not seen by the previous view
+    if(clip_space.w <= 0.0 || any(lessThan(texcoord, vec2(0.0))) || any(greaterThan(texcoord, vec2(1.0))))
+    {
+        color = vec4(0.0);
+        return;
+    }
+
+    // Clamp to the used region of the history to never filter in stale texels
+    vec2 half_texel = 0.5 / vec2(textureSize(history, 0));
+    texcoord = clamp(texcoord * history_texcoord_scale, half_texel, history_texcoord_scale - half_texel);
+
+    color = history_decay * texture(history, texcoord);
+})";
@@ -0,0 +1,95 @@
+#include <iostream>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+
+#include "scene.hpp"
+#include "../../source/core/light-field-codec.hpp"
+
+/*********************************************************************************
+Usage:
+  light-field-generator --output <folder> [--grid 17x17] [--size 512x512]
+                        [--spacing 10] [--perspective] [--supersampling 2]
+                        [--near 1] [--focus 1.5] [--far 4]
+                        [--st-width 1] [--st-distance 1]
+                        [--focal-length 50] [--sensor-width 36]
+                        [--packed <file.lfc>] [--quality 1]
+
+Sizes are given as <width>x<height> or a single number for both. Spacing, focal
+length and sensor width are in mm, depths and the st plane in meters. With
+--packed, the folder is encoded into an .lfc file and only its config.cfg and
+ground-truth.txt are kept, --decode of the renderer restores the images.
+*********************************************************************************/
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> args(argv + 1, argv + argc);
+
+    auto option = [&args](const std::string &name, const std::string &default_value)
+    {
+        auto it = std::find(args.begin(), args.end(), name);
+        return it != args.end() && it + 1 != args.end() ? *(it + 1) : default_value;
+    };
+
+    auto flag = [&args](const std::string &name)
+    {
+        return std::find(args.begin(), args.end(), name) != args.end();
+    };
+
+    auto size = [&](const std::string &name, const std::string &default_value)
+    {
+        std::string value = option(name, default_value);
+        size_t x = value.find('x');
+        if (x == std::string::npos) return glm::ivec2(std::stoi(value));
+        return glm::ivec2(std::stoi(value.substr(0, x)), std::stoi(value.substr(x + 1)));
+    };
+
+    try
+    {
+        if (!flag("--output")) throw std::runtime_error("Missing --output <folder>");
+
+        SceneSettings settings;
+        settings.grid_size = size("--grid", "17x17");
+        settings.image_size = size("--size", "512x512");
+        settings.spacing = std::stof(option("--spacing", "10"));
+        settings.light_slab = !flag("--perspective");
+        settings.supersampling = std::max(1, std::stoi(option("--supersampling", "2")));
+        settings.near_depth = std::stof(option("--near", "1"));
+        settings.focus_depth = std::stof(option("--focus", "1.5"));
+        settings.far_depth = std::stof(option("--far", "4"));
+        settings.st_width = std::stof(option("--st-width", "1"));
+        settings.st_distance = std::stof(option("--st-distance", "1"));
+        settings.focal_length = std::stof(option("--focal-length", "50"));
+        settings.sensor_width = std::stof(option("--sensor-width", "36"));
+
+        Scene scene(settings);
+
+        std::filesystem::path folder = option("--output", "");
+        std::cout << "Generating " << settings.grid_size.x << "x" << settings.grid_size.y << " "
+                  << (settings.light_slab ? "light slab" : "perspective") << " views of "
+                  << settings.image_size.x << "x" << settings.image_size.y << " px in " << folder << std::endl;
+
+        scene.write(folder);
+
+        if (flag("--packed"))
+        {
+            std::string packed = option("--packed", "");
+            int result = encodeLightField(folder.string(), packed, std::stoi(option("--quality", "1")));
+            if (result != 0) return result;
+
+            for (const auto &entry : std::filesystem::directory_iterator(folder))
+            {
+                if (entry.path().extension() == ".tga") std::filesystem::remove(entry.path());
+            }
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << e.what() << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
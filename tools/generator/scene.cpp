@@ -0,0 +1,215 @@
+#include "scene.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include <mutex>
+#include <cmath>
+
+#include "../../source/core/image-writer.hpp"
+#include "../../source/core/util.hpp"
+
+namespace
+{
+    // Smooth value noise in [0, 1], gives the cards texture at all scales for the disparity search
+    float hash(int x, int y)
+    {
+        uint32_t h = (uint32_t)x * 374761393u + (uint32_t)y * 668265263u;
+        h = (h ^ (h >> 13)) * 1274126177u;
+        return (float)(h ^ (h >> 16)) / 4294967295.0f;
+    }
+
+    float valueNoise(const glm::vec2 &p)
+    {
+        glm::vec2 i = glm::floor(p);
+        glm::vec2 f = p - i;
+        f = f * f * (3.0f - 2.0f * f);
+
+        int x = (int)i.x, y = (int)i.y;
+        float bottom = glm::mix(hash(x, y), hash(x + 1, y), f.x);
+        float top = glm::mix(hash(x, y + 1), hash(x + 1, y + 1), f.x);
+        return glm::mix(bottom, top, f.y);
+    }
+
+    glm::vec3 texture(const Plane &plane, const glm::vec2 &p)
+    {
+        glm::vec2 q = p / plane.period;
+        bool checker = ((int)std::floor(q.x) + (int)std::floor(q.y)) & 1;
+
+        float noise = 0.5f * valueNoise(q * 4.0f) + 0.25f * valueNoise(q * 8.0f) + 0.25f * valueNoise(q * 16.0f);
+        return plane.colors[checker] * (0.5f + noise);
+    }
+}
+
+Scene::Scene(const SceneSettings &settings) : settings(settings)
+{
+    if (settings.grid_size.x < 1 || settings.grid_size.y < 1 || settings.image_size.x < 1 || settings.image_size.y < 1)
+    {
+        throw std::runtime_error("Invalid grid or image size");
+    }
+    if (!(settings.near_depth > 0.0f && settings.near_depth < settings.focus_depth && settings.focus_depth < settings.far_depth))
+    {
+        throw std::runtime_error("Depths must satisfy 0 < near < focus < far");
+    }
+
+    // Half the width and height of the view per meter of depth, so that cards cover the same part of the image at any depth
+    glm::vec2 field = settings.light_slab ? glm::vec2(0.5f * settings.st_width / settings.st_distance)
+                                          : glm::vec2(0.5f * settings.sensor_width / settings.focal_length);
+    field.y *= settings.image_size.y / (float)settings.image_size.x;
+
+    auto card = [&](float depth, const glm::vec2 &min, const glm::vec2 &max, const glm::vec3 &a, const glm::vec3 &b)
+    {
+        float scale = depth * field.x;
+        planes.push_back({ depth, min * field * depth, max * field * depth, true, { a, b }, 0.08f * scale });
+    };
+
+    card(settings.near_depth, { -0.9f, -0.6f }, { -0.4f, 0.3f }, { 0.9f, 0.35f, 0.2f }, { 0.35f, 0.1f, 0.05f });
+    card(settings.focus_depth, { -0.2f, -0.2f }, { 0.2f, 0.2f }, { 0.95f, 0.9f, 0.8f }, { 0.15f, 0.15f, 0.2f });
+    card(0.5f * (settings.focus_depth + settings.far_depth), { 0.35f, -0.2f }, { 0.9f, 0.7f }, { 0.3f, 0.8f, 0.4f }, { 0.05f, 0.25f, 0.1f });
+
+    planes.push_back({ settings.far_depth, glm::vec2(0.0f), glm::vec2(0.0f), false,
+                       { glm::vec3(0.35f, 0.5f, 0.8f), glm::vec3(0.1f, 0.15f, 0.3f) }, 0.1f * settings.far_depth * field.x });
+
+    std::sort(planes.begin(), planes.end(), [](const Plane &a, const Plane &b) { return a.depth < b.depth; });
+}
+
+glm::vec3 Scene::trace(const glm::vec3 &origin, const glm::vec3 &direction) const
+{
+    for (const auto &plane : planes)
+    {
+        glm::vec3 p = origin + direction * ((plane.depth + origin.z) / -direction.z);
+        glm::vec2 xy(p.x, p.y);
+        if (!plane.bounded || (glm::all(glm::greaterThanEqual(xy, plane.min)) && glm::all(glm::lessThanEqual(xy, plane.max))))
+        {
+            return texture(plane, xy);
+        }
+    }
+    return glm::vec3(0.0f);
+}
+
+std::string Scene::filename(int i, int j) const
+{
+    // name_i_j_-y_x in mm, perspective cameras add _focal-length_sensor-width
+    glm::dvec2 xy = glm::dvec2(gridOffset(i, j)) * (double)settings.spacing;
+
+    std::stringstream name;
+    name << std::fixed << std::setprecision(6) << "Generated_"
+         << std::setw(3) << std::setfill('0') << i << "_" << std::setw(3) << j << "_"
+         << 0.0 - xy.y << "_" << xy.x + 0.0;
+    if (!settings.light_slab) name << "_" << settings.focal_length << "_" << settings.sensor_width;
+    name << ".tga";
+    return name.str();
+}
+
+glm::ivec2 Scene::gridOffset(int i, int j) const
+{
+    // The renderer puts the origin at this camera for light slabs
+    glm::ivec2 mid = (settings.grid_size - 1) / 2;
+    return glm::ivec2(i - mid.x, mid.y - j);
+}
+
+glm::vec2 Scene::cameraPosition(int i, int j) const
+{
+    return glm::vec2(gridOffset(i, j)) * settings.spacing * 1e-3f;
+}
+
+glm::vec3 Scene::rayDirection(const glm::vec2 &camera, const glm::vec2 &texture_coordinates) const
+{
+    const glm::vec2 aspect(1.0f, settings.image_size.y / (float)settings.image_size.x);
+    glm::vec2 centered = texture_coordinates - 0.5f;
+
+    if (settings.light_slab)
+    {
+        // All views cover the same st window, centered on the middle camera
+        glm::vec2 st = centered * aspect * settings.st_width;
+        return glm::vec3(st - camera, -settings.st_distance);
+    }
+
+    glm::vec2 sensor = centered * aspect * settings.sensor_width;
+    return glm::vec3(sensor, -settings.focal_length);
+}
+
+std::vector<glm::u8vec3> Scene::render(int i, int j) const
+{
+    const glm::ivec2 size = settings.image_size;
+    const int n = settings.supersampling;
+    const glm::vec2 camera = cameraPosition(i, j);
+
+    std::vector<glm::u8vec3> bgr((size_t)size.x * size.y);
+    for (int y = 0; y < size.y; y++)
+    {
+        for (int x = 0; x < size.x; x++)
+        {
+            glm::vec3 sum(0.0f);
+            for (int sy = 0; sy < n; sy++)
+            {
+                for (int sx = 0; sx < n; sx++)
+                {
+                    glm::vec2 p = (glm::vec2(x, y) + (glm::vec2(sx, sy) + 0.5f) / (float)n) / glm::vec2(size);
+                    sum += trace(glm::vec3(camera, 0.0f), rayDirection(camera, p));
+                }
+            }
+            glm::vec3 c = glm::clamp(sum / (float)(n * n), 0.0f, 1.0f) * 255.0f + 0.5f;
+            bgr[(size_t)y * size.x + x] = glm::u8vec3(c.b, c.g, c.r);
+        }
+    }
+    return bgr;
+}
+
+void Scene::write(const std::filesystem::path &folder) const
+{
+    std::filesystem::create_directories(folder);
+
+    const glm::ivec2 grid = settings.grid_size;
+    size_t written = 0;
+    std::mutex mutex;
+
+    parallelFor((size_t)grid.x * grid.y, [&](size_t cell)
+    {
+        int i = (int)(cell % grid.x), j = (int)(cell / grid.x);
+        auto bgr = render(i, j);
+
+        TGAWriter writer((folder / filename(i, j)).string(), settings.image_size);
+        writer.write(glm::ivec2(0), settings.image_size, bgr);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        std::cout << "\r" << ++written << "/" << grid.x * grid.y << " views" << std::flush;
+    });
+    std::cout << std::endl;
+
+    // Start, min and max of the properties that depend on the scene
+    std::ofstream config(folder / "config.cfg");
+    auto property = [&](const std::string &name, float value, float min, float max)
+    {
+        config << name << " " << value << " " << std::min(value, min) << " " << std::max(value, max) << "\n";
+    };
+    property("focus-distance", settings.focus_depth, 0.5f * settings.near_depth, 1.5f * settings.far_depth);
+
+    // Focus distance is measured from the eye, which starts on the camera plane so that it equals the plane depths
+    property("z", 0.0f, -3.0f, 3.0f);
+    if (settings.light_slab)
+    {
+        property("st-width", settings.st_width, 0.1f, 2.0f);
+        property("st-distance", settings.st_distance, 0.1f, 2.0f);
+    }
+    else
+    {
+        property("focal-length", settings.focal_length, 10.0f, 100.0f);
+        property("sensor-width", settings.sensor_width, 10.0f, 100.0f);
+    }
+
+    std::ofstream truth(folder / "ground-truth.txt");
+    truth << "# Planes facing the cameras, depth in meters from the camera plane along -z\n"
+          << "# plane <depth> [<min x> <min y> <max x> <max y>]\n";
+    for (const auto &plane : planes)
+    {
+        truth << "plane " << plane.depth;
+        if (plane.bounded) truth << " " << plane.min.x << " " << plane.min.y << " " << plane.max.x << " " << plane.max.y;
+        truth << "\n";
+    }
+    truth << "# Depth seen at the center of the view of the middle camera\n"
+          << "center-depth " << settings.focus_depth << "\n";
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#include <glm/glm.hpp>
+
+/*************************************************************************
+Procedural scene of textured planes facing a camera grid, for scaling
+tests with arrays and views larger than the captured light fields. A card
+at focus_depth covers the center of the view, two more cards at other
+depths sit to its sides and a background plane covers everything else.
+Depths are in meters from the camera plane along -z, so the depth of the
+center card is the exact result autofocus should find there.
+
+Camera images are written in the file name format of CameraArray, as
+light slab views of a common st plane or as perspective cameras.
+*************************************************************************/
+struct SceneSettings
+{
+    glm::ivec2 grid_size = glm::ivec2(17);
+    glm::ivec2 image_size = glm::ivec2(512);
+
+    // Distance between neighbouring cameras in mm
+    float spacing = 10.0f;
+
+    bool light_slab = true;
+
+    // Light slab st plane, meters
+    float st_width = 1.0f;
+    float st_distance = 1.0f;
+
+    // Perspective cameras, mm
+    float focal_length = 50.0f;
+    float sensor_width = 36.0f;
+
+    float near_depth = 1.0f;
+    float focus_depth = 1.5f;
+    float far_depth = 4.0f;
+
+    // Samples per pixel along each axis
+    int supersampling = 2;
+};
+
+struct Plane
+{
+    float depth;
+
+    // Extent on the plane in meters, the background is unbounded
+    glm::vec2 min, max;
+    bool bounded;
+
+    glm::vec3 colors[2];
+
+    // Texture period in meters
+    float period;
+};
+
+class Scene
+{
+public:
+    Scene(const SceneSettings &settings);
+
+    // Writes all camera images, config.cfg with matching ranges and ground-truth.txt into the folder
+    void write(const std::filesystem::path &folder) const;
+
+    // sRGB color of the first plane hit by a ray from origin in direction
+    glm::vec3 trace(const glm::vec3 &origin, const glm::vec3 &direction) const;
+
+    const SceneSettings settings;
+
+    // Sorted from near to far
+    std::vector<Plane> planes;
+
+private:
+    std::string filename(int i, int j) const;
+
+    // Camera ij in steps from the middle camera, j increases downwards
+    glm::ivec2 gridOffset(int i, int j) const;
+
+    // Position of camera ij relative to the middle camera of the grid, meters
+    glm::vec2 cameraPosition(int i, int j) const;
+
+    // Ray direction through the sensor point at texture coordinates in [0, 1]
+    glm::vec3 rayDirection(const glm::vec2 &camera, const glm::vec2 &texture_coordinates) const;
+
+    std::vector<glm::u8vec3> render(int i, int j) const;
+};